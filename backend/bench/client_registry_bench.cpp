@@ -0,0 +1,62 @@
+// Contended register/lookup/unregister on the joker_service client
+// registry, against a single mutex around std::unordered_map.
+#include <benchmark/benchmark.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "client_registry.h"
+
+using namespace std;
+
+static const int PLAYERS = 10000;
+
+static vector<string> make_ids() {
+    vector<string> ids;
+    for (int i = 0; i < PLAYERS; i++) {
+        ids.push_back("ws_" + to_string(i) + "_AAAAAAAAAAAA");
+    }
+    return ids;
+}
+
+static const vector<string> ids = make_ids();
+
+// Each iteration: one player registers, uses two lifelines, then leaves
+static void BM_ClientRegistry(benchmark::State& state) {
+    static ClientRegistry registry(PLAYERS);
+    size_t i = state.thread_index() * 7919;
+    int socket;
+    for (auto _ : state) {
+        const string& id = ids[i++ % PLAYERS];
+        registry.insert(id, 4);
+        for (int k = 0; k < 2; k++) {
+            registry.insert(id, 4);
+            benchmark::DoNotOptimize(registry.find(id, socket));
+        }
+        registry.erase(id);
+    }
+}
+BENCHMARK(BM_ClientRegistry)->ThreadRange(1, 16)->UseRealTime();
+
+static void BM_GlobalMutexMap(benchmark::State& state) {
+    static mutex lock;
+    static unordered_map<string, int> clients;
+    size_t i = state.thread_index() * 7919;
+    for (auto _ : state) {
+        const string& id = ids[i++ % PLAYERS];
+        {
+            lock_guard<mutex> guard(lock);
+            clients[id] = 4;
+        }
+        for (int k = 0; k < 2; k++) {
+            lock_guard<mutex> guard(lock);
+            clients[id] = 4;
+            benchmark::DoNotOptimize(clients.find(id));
+        }
+        lock_guard<mutex> guard(lock);
+        clients.erase(id);
+    }
+}
+BENCHMARK(BM_GlobalMutexMap)->ThreadRange(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
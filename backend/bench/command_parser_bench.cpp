@@ -0,0 +1,233 @@
+// Per-command parsing and response formatting on the game_host and
+// joker_service hot paths. Every benchmark reports heap allocations per
+// iteration ("allocs") next to its time, counted by the operator new below;
+// the string_view tokenizers are compared with the std::string splitters
+// they replaced, and the text joker_service protocol with the binary one
+// ("bytes" is the message size on the wire).
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "command.h"
+#include "joker.h"
+#include "joker_wire.h"
+
+using namespace std;
+
+static thread_local uint64_t allocations = 0;
+
+// GCC flags free() in a replaced operator delete as mismatched with new
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* p = malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// Measures allocations over the timed loop
+class AllocationCounter {
+    benchmark::State& state;
+    uint64_t start = allocations;
+public:
+    explicit AllocationCounter(benchmark::State& state) : state(state) {}
+    ~AllocationCounter() {
+        state.counters["allocs"] = benchmark::Counter(static_cast<double>(allocations - start),
+                                                      benchmark::Counter::kAvgIterations);
+    }
+};
+
+static const string commands[] = {
+    "START:ws_1718000000_k3j2h1g4f",
+    "ANSWER:ws_1718000000_k3j2h1g4f:B",
+    "JOKER:ws_1718000000_k3j2h1g4f:audience",
+    "REQUEST:ws_1718000000_k3j2h1g4f",
+};
+
+static const string joker_requests[] = {
+    "AUDIENCE-ws_1718000000_k3j2h1g4f:3",
+    "FIFTY_FIFTY-ws_1718000000_k3j2h1g4f:3,B",
+    "GET_JOKERS-0",
+};
+
+// The game_host splitter before the tokenizer, kept as the baseline
+static pair<string, string> legacy_parse_command(string_view cmd) {
+    size_t colonPos = cmd.find(':');
+    if (colonPos == string::npos) {
+        return make_pair("UNKNOWN", "");
+    }
+    string action(cmd.substr(0, colonPos));
+    string data(cmd.substr(colonPos + 1));
+    size_t secondColonPos = data.find(':');
+    string clientId = data;
+    string payload = "";
+    if (secondColonPos != string::npos) {
+        clientId = data.substr(0, secondColonPos);
+        payload = data.substr(secondColonPos + 1);
+    }
+    return make_pair(action, clientId);
+}
+
+// The joker_service splitter and number parsing before the tokenizer
+static int legacy_parse_joker_request(const string& request) {
+    size_t delimiter_pos = request.find('-');
+    string action = request.substr(0, delimiter_pos);
+    string data = request.substr(delimiter_pos + 1);
+    size_t client_id_pos = data.find(':');
+    string client_id = "";
+    if (client_id_pos != string::npos) {
+        client_id = data.substr(0, client_id_pos);
+        data = data.substr(client_id_pos + 1);
+    }
+    return action == "GET_JOKERS" ? 0 : stoi(data);
+}
+
+static void BM_ParseCommand(benchmark::State& state) {
+    const string& line = commands[state.range(0)];
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        Command command;
+        benchmark::DoNotOptimize(parse_command(line, command));
+        benchmark::DoNotOptimize(command);
+    }
+    state.SetLabel(line.substr(0, line.find(':')));
+}
+BENCHMARK(BM_ParseCommand)->DenseRange(0, 3);
+
+static void BM_LegacyParseCommand(benchmark::State& state) {
+    const string& line = commands[state.range(0)];
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(legacy_parse_command(line));
+    }
+    state.SetLabel(line.substr(0, line.find(':')));
+}
+BENCHMARK(BM_LegacyParseCommand)->DenseRange(0, 3);
+
+static void BM_ParseJokerRequest(benchmark::State& state) {
+    const string& line = joker_requests[state.range(0)];
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        JokerRequest request;
+        parse_joker_request(line, request);
+        int question_id = 0;
+        if (request.action != JokerAction::GET_JOKERS) {
+            parse_number(request.data.substr(0, request.data.find(',')), question_id);
+        }
+        benchmark::DoNotOptimize(question_id);
+        benchmark::DoNotOptimize(request);
+    }
+    state.SetLabel(line.substr(0, line.find('-')));
+}
+BENCHMARK(BM_ParseJokerRequest)->DenseRange(0, 2);
+
+static void BM_LegacyParseJokerRequest(benchmark::State& state) {
+    const string& line = joker_requests[state.range(0)];
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(legacy_parse_joker_request(line));
+    }
+    state.SetLabel(line.substr(0, line.find('-')));
+}
+BENCHMARK(BM_LegacyParseJokerRequest)->DenseRange(0, 2);
+
+static void BM_AudienceRequest(benchmark::State& state) {
+    string clientId = "ws_1718000000_k3j2h1g4f";
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Joker::audience_request(3, clientId));
+    }
+}
+BENCHMARK(BM_AudienceRequest);
+
+static void BM_FormatAudienceResult(benchmark::State& state) {
+    string response = "AUDIENCE_RESULT-ws_1718000000_k3j2h1g4f:A:40%,B:25%,C:30%,D:5%";
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Joker::format_audience_result(response));
+    }
+}
+BENCHMARK(BM_FormatAudienceResult);
+
+static void BM_FormatFiftyFiftyResult(benchmark::State& state) {
+    string response = "FIFTY_FIFTY_RESULT-ws_1718000000_k3j2h1g4f:A,C";
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Joker::format_fifty_fifty_result(response));
+    }
+}
+BENCHMARK(BM_FormatFiftyFiftyResult);
+
+static void BM_EncodeAudienceMessage(benchmark::State& state) {
+    Joker::Request request;
+    request.action = JokerAction::AUDIENCE;
+    request.client_id = "ws_1718000000_k3j2h1g4f";
+    request.question_id = 3;
+    string message;
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        message.clear();
+        Joker::encode_request(message, 42, request);
+        benchmark::DoNotOptimize(message.data());
+    }
+    state.counters["bytes"] = static_cast<double>(message.size());
+}
+BENCHMARK(BM_EncodeAudienceMessage);
+
+static void BM_TextAudienceRoundTrip(benchmark::State& state) {
+    // Request line out, result line back to display text
+    string response = "AUDIENCE_RESULT-ws_1718000000_k3j2h1g4f:A:40%,B:25%,C:30%,D:5%";
+    string clientId = "ws_1718000000_k3j2h1g4f";
+    string request;
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        request = "42|" + Joker::audience_request(3, clientId) + "\n";
+        benchmark::DoNotOptimize(Joker::format_audience_result(response));
+    }
+    state.counters["bytes"] = static_cast<double>(request.size() + response.size() + 4);
+}
+BENCHMARK(BM_TextAudienceRoundTrip);
+
+static void BM_BinaryAudienceRoundTrip(benchmark::State& state) {
+    Joker::Request request;
+    request.action = JokerAction::AUDIENCE;
+    request.client_id = "ws_1718000000_k3j2h1g4f";
+    request.question_id = 3;
+
+    JokerWire::Header header;
+    header.type = JokerWire::Type::AUDIENCE_RESULT;
+    header.request_id = 42;
+    header.question = 3;
+    header.client = JokerWire::client_handle(request.client_id);
+    const uint8_t percentages[4] = {40, 25, 30, 5};
+    string response;
+    JokerWire::encode(response, header, string_view(reinterpret_cast<const char*>(percentages), 4));
+
+    string message;
+    message.reserve(64);
+    AllocationCounter counter(state);
+    for (auto _ : state) {
+        message.clear();
+        Joker::encode_request(message, 42, request);
+        JokerWire::Header decoded;
+        string_view payload;
+        JokerWire::decode(response, decoded, payload);
+        benchmark::DoNotOptimize(Joker::format_audience_percentages(reinterpret_cast<const uint8_t*>(payload.data())));
+    }
+    state.counters["bytes"] = static_cast<double>(message.size() + response.size());
+}
+BENCHMARK(BM_BinaryAudienceRoundTrip);
+
+BENCHMARK_MAIN();
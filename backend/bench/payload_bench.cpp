@@ -0,0 +1,82 @@
+// Cost of the START reply: gathering pre-rendered fragments (what game_host
+// sends) against formatting the same text per game, plus the one-off cost
+// of rendering the cache when a bank is loaded.
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <sys/uio.h>
+#include "payload_cache.h"
+#include "question_bank.h"
+
+using namespace std;
+
+static shared_ptr<const QuestionBank> load_bank() {
+    string error;
+    shared_ptr<const QuestionBank> bank = QuestionBank::load(QUESTIONS_FILE, error);
+    if (bank == nullptr) {
+        fprintf(stderr, "%s\n", error.c_str());
+        exit(1);
+    }
+    return bank;
+}
+
+static const shared_ptr<const QuestionBank> bank = load_bank();
+
+static void BM_PayloadCacheBuild(benchmark::State& state) {
+    for (auto _ : state) {
+        PayloadCache cache(bank);
+        benchmark::DoNotOptimize(cache.question(0).data());
+    }
+    state.SetItemsProcessed(state.iterations() * bank->size());
+}
+BENCHMARK(BM_PayloadCacheBuild);
+
+static void BM_StartGather(benchmark::State& state) {
+    PayloadCache cache(bank);
+    static const string header = "ALL_QUESTIONS_DATA\n";
+    static const string jokers = "JOKERS:Ask the Audience (S), 50:50 (Y)\n";
+    uint32_t ladder[QuestionBank::TIERS];
+    for (int t = 0; t < QuestionBank::TIERS; t++) {
+        ladder[t] = bank->tier_questions(t)[0];
+    }
+
+    for (auto _ : state) {
+        struct iovec buffers[QuestionBank::TIERS + 2];
+        int count = 0;
+        buffers[count++] = {const_cast<char*>(header.data()), header.size()};
+        for (int t = 0; t < QuestionBank::TIERS; t++) {
+            string_view question = cache.question(ladder[t]);
+            buffers[count++] = {const_cast<char*>(question.data()), question.size()};
+        }
+        buffers[count++] = {const_cast<char*>(jokers.data()), jokers.size()};
+        benchmark::DoNotOptimize(buffers);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_StartGather);
+
+static void BM_StartFormat(benchmark::State& state) {
+    uint32_t ladder[QuestionBank::TIERS];
+    for (int t = 0; t < QuestionBank::TIERS; t++) {
+        ladder[t] = bank->tier_questions(t)[0];
+    }
+
+    for (auto _ : state) {
+        string message = "ALL_QUESTIONS_DATA\n";
+        for (int t = 0; t < QuestionBank::TIERS; t++) {
+            uint32_t id = ladder[t];
+            message += "QUESTION:" + to_string(t) + ":" + to_string(t + 1) + ". " + string(bank->text(id)) + "\n";
+            message += "OPTIONS:" + to_string(t) + ":";
+            for (int o = 0; o < QuestionBank::OPTIONS; o++) {
+                message += string(1, 'A' + o) + ") " + string(bank->option(id, o)) + (o < 3 ? "|" : "\n");
+            }
+        }
+        message += "JOKERS:Ask the Audience (S), 50:50 (Y)\n";
+        benchmark::DoNotOptimize(message.data());
+    }
+}
+BENCHMARK(BM_StartFormat);
+
+BENCHMARK_MAIN();
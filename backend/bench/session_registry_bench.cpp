@@ -0,0 +1,63 @@
+// Contended lookup/insert/erase on the game_host session registry, against
+// the single-mutex std::map it replaced.
+#include <benchmark/benchmark.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "session_registry.h"
+
+using namespace std;
+
+static const int PLAYERS = 10000;
+
+static vector<string> make_ids() {
+    vector<string> ids;
+    for (int i = 0; i < PLAYERS; i++) {
+        ids.push_back("ws_" + to_string(i) + "_AAAAAAAAAAAA");
+    }
+    return ids;
+}
+
+static const vector<string> ids = make_ids();
+
+// Each iteration: one player connects, is looked up a few times, then leaves
+static void BM_SessionRegistry(benchmark::State& state) {
+    static SessionRegistry registry;
+    size_t i = state.thread_index() * 7919;
+    for (auto _ : state) {
+        const string& id = ids[i++ % PLAYERS];
+        auto session = make_shared<Session>();
+        registry.insert(id, session);
+        for (int k = 0; k < 4; k++) {
+            benchmark::DoNotOptimize(registry.find(id));
+        }
+        registry.erase(id, session.get());
+    }
+}
+BENCHMARK(BM_SessionRegistry)->ThreadRange(1, 16)->UseRealTime();
+
+static void BM_GlobalMutexMap(benchmark::State& state) {
+    static mutex lock;
+    static map<string, shared_ptr<Session>> sessions;
+    size_t i = state.thread_index() * 7919;
+    for (auto _ : state) {
+        const string& id = ids[i++ % PLAYERS];
+        auto session = make_shared<Session>();
+        {
+            lock_guard<mutex> guard(lock);
+            sessions[id] = session;
+        }
+        for (int k = 0; k < 4; k++) {
+            lock_guard<mutex> guard(lock);
+            auto it = sessions.find(id);
+            benchmark::DoNotOptimize(it == sessions.end() ? nullptr : it->second);
+        }
+        lock_guard<mutex> guard(lock);
+        sessions.erase(id);
+    }
+}
+BENCHMARK(BM_GlobalMutexMap)->ThreadRange(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
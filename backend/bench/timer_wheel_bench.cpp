@@ -0,0 +1,49 @@
+// Session timeouts on the game_host timer wheel: re-arming an idle timer on
+// every command and sweeping expired ones, with many sessions' timers armed.
+#include <benchmark/benchmark.h>
+#include <memory>
+#include "timer_wheel.h"
+
+using namespace std;
+
+// One command from a player: its idle timer moves out again. Cost should
+// not depend on how many other timers are armed.
+static void BM_TimerWheelRearm(benchmark::State& state) {
+    size_t armed = state.range(0);
+    TimerWheel wheel;
+    unique_ptr<Timer[]> timers(new Timer[armed]);
+    for (size_t i = 0; i < armed; i++) {
+        wheel.arm(timers[i], nullptr, 1000 + i % 300000);
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        wheel.arm(timers[i++ % armed], nullptr, 300000);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimerWheelRearm)->RangeMultiplier(8)->Range(1 << 10, 1 << 18);
+
+// Timers spread over five minutes expire while the clock runs through them,
+// cascading down the levels on the way
+static void BM_TimerWheelExpire(benchmark::State& state) {
+    size_t armed = state.range(0);
+    unique_ptr<Timer[]> timers(new Timer[armed]);
+    size_t fired = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        TimerWheel wheel;
+        for (size_t i = 0; i < armed; i++) {
+            wheel.arm(timers[i], nullptr, 10 + (i * 7919) % 300000);
+        }
+        uint64_t now = TimerWheel::now();
+        state.ResumeTiming();
+
+        fired += wheel.advance(now + 301000, [](Timer&) {});
+    }
+    state.SetItemsProcessed(fired);
+}
+BENCHMARK(BM_TimerWheelExpire)->RangeMultiplier(8)->Range(1 << 10, 1 << 18)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
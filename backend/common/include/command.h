@@ -0,0 +1,56 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+
+// Allocation-free tokenizers for the two text protocols. Fields are views
+// into the frame being parsed, so they are only valid while that frame is,
+// and the action name is mapped to an enum once so handlers can switch on it.
+
+// Adapter -> game_host: "ACTION:clientId[:payload]"
+enum class Action : uint8_t {
+    UNKNOWN, CLIENT_ID, START, ANSWER, JOKER, REQUEST, DISCONNECT,
+    MUX,            // "MUX:<name>" as the first line multiplexes the connection
+    COUNT
+};
+
+struct Command {
+    Action action = Action::UNKNOWN;
+    std::string_view name;          // action as sent
+    std::string_view client_id;
+    std::string_view payload;       // everything after the second ':'
+};
+
+// Returns false (action UNKNOWN, empty fields) if the line has no ':'
+bool parse_command(std::string_view line, Command& command);
+const char* action_name(Action action);
+
+// game_host -> joker_service: "ACTION-[clientId:]DATA"
+enum class JokerAction : uint8_t {
+    UNKNOWN, REGISTER, AUDIENCE, FIFTY_FIFTY, GET_JOKERS, DISCONNECT,
+    HELLO,          // "HELLO-<version>" offers the binary protocol (joker_wire.h)
+    ANSWER_STATS,   // "ANSWER_STATS-questionId,a,b,c,d" answer counts, no reply
+    COUNT
+};
+
+struct JokerRequest {
+    JokerAction action = JokerAction::UNKNOWN;
+    std::string_view name;
+    std::string_view client_id;     // empty when DATA carries no ':'
+    std::string_view data;
+};
+
+// Returns false (action UNKNOWN, empty fields) if the line has no '-'
+bool parse_joker_request(std::string_view line, JokerRequest& request);
+const char* joker_action_name(JokerAction action);
+
+// Whole-field decimal number; rejects empty input, signs and trailing bytes
+template <typename T>
+bool parse_number(std::string_view text, T& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef FRAME_BUFFER_H
+#define FRAME_BUFFER_H
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+// Per-connection receive buffer that splits a TCP byte stream into
+// newline-terminated frames. Bytes are read straight into the buffer and
+// frames are handed out as views into it, so nothing is copied per command.
+//
+//   recv(fd, buf.write_ptr(), buf.writable(), 0) -> buf.commit(n)
+//   while (buf.next_frame(frame)) { ... }
+//
+// A view returned by next_frame stays valid until the next write_ptr() call.
+// The storage is allocated by the first write_ptr(), so a buffer that is
+// never read into (a multiplexed player's) costs nothing.
+class FrameBuffer {
+private:
+    std::unique_ptr<char[]> data;
+    size_t capacity;
+    size_t head = 0;     // first unconsumed byte
+    size_t tail = 0;     // one past the last received byte
+    size_t scanned = 0;  // bytes after head already searched for '\n'
+
+public:
+    explicit FrameBuffer(size_t capacity = 2048);
+
+    // Space available for the next read. Compacts consumed bytes first.
+    char* write_ptr();
+    size_t writable();
+    void commit(size_t n);
+
+    // Extracts the next complete frame without its "\n" or "\r\n".
+    bool next_frame(std::string_view& frame);
+
+    // Raw access for length-prefixed messages (joker_wire.h): the unconsumed
+    // bytes, and dropping the first n of them once a message is handled.
+    std::string_view peek() const;
+    void consume(size_t n);
+    // The same bytes as peek(), writable for decoders that rewrite a
+    // message in place (WebSocket unmasking); null while nothing was read
+    char* front() { return data ? data.get() + head : nullptr; }
+
+    // True when a single frame is larger than the whole buffer; the peer is
+    // either broken or hostile and the connection should be dropped.
+    bool overflowed() const;
+    size_t pending() const { return tail - head; }
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef JOKER_WIRE_H
+#define JOKER_WIRE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Binary framing for the game_host <-> joker_service hop. It is negotiated
+// per connection: game_host sends the text line "HELLO-<version>" and a
+// joker_service that speaks that version answers "HELLO-<version>", after
+// which both directions carry only binary messages. Anything else (an
+// older service answers "ERROR-Unknown action: HELLO") keeps the connection
+// on the "<id>|ACTION-[clientId:]DATA\n" text protocol.
+//
+// A message is a fixed little-endian header followed by `length` payload
+// bytes:
+//
+//   type:u8 arg:u8 length:u16 request_id:u32 question:u32 client:u64
+//
+// Lifeline results travel as numbers (four audience percentages, two 50:50
+// letters) and are only turned into text once, for the player. Requests
+// queued together can be sent as one BATCH whose payload is the messages
+// back to back; the replies come back the same way in a BATCH_RESULT.
+namespace JokerWire {
+
+constexpr uint8_t VERSION = 1;
+constexpr size_t HEADER_SIZE = 20;
+constexpr size_t MAX_PAYLOAD = 1024;
+
+enum class Type : uint8_t {
+    INVALID = 0,
+
+    // game_host -> joker_service
+    REGISTER = 1,
+    AUDIENCE = 2,               // question = question bank ID
+    FIFTY_FIFTY = 3,            // question = question bank ID, arg = correct letter
+    GET_JOKERS = 4,
+    DISCONNECT = 5,             // no reply
+    BATCH = 6,                  // payload: requests, no nested batches
+    ANSWER_STATS = 7,           // question = ID, payload: A-D answer counts (4 x u32); no reply
+
+    // joker_service -> game_host, echoing request_id and client
+    REGISTERED = 0x81,
+    AUDIENCE_RESULT = 0x82,     // payload: A, B, C, D percentages, one byte each
+    FIFTY_FIFTY_RESULT = 0x83,  // payload: the two remaining letters
+    AVAILABLE_JOKERS = 0x84,    // payload: joker list text
+    BATCH_RESULT = 0x86,        // payload: the replies of one BATCH
+    ERROR = 0xff,               // payload: reason text
+};
+
+struct Header {
+    Type type = Type::INVALID;
+    uint8_t arg = 0;
+    uint16_t length = 0;        // payload bytes after the header
+    uint32_t request_id = 0;
+    uint32_t question = 0;
+    uint64_t client = 0;        // client_handle() of the player, 0 for none
+};
+
+// Appends one message; header.length is taken from payload.
+void encode(std::string& out, Header header, std::string_view payload = {});
+
+// Decodes the message at the front of buffer. Returns the bytes it spans,
+// 0 if it is not complete yet, or -1 if the stream is corrupt (payload
+// larger than MAX_PAYLOAD).
+int decode(std::string_view buffer, Header& header, std::string_view& payload);
+
+// Appends messages (complete messages back to back) wrapped in as many
+// `type` batches as MAX_PAYLOAD requires.
+void encode_batches(std::string& out, Type type, std::string_view messages);
+
+// Stable 64-bit handle for a WebSocket client ID (FNV-1a); 0 for no client.
+uint64_t client_handle(std::string_view client_id);
+
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Asynchronous logger. A log call checks the level with one relaxed load,
+// formats into a slot of the calling thread's own ring buffer and returns;
+// a background thread drains all rings, orders the records by time and
+// writes them to stdout in one call. When a ring is full the record is
+// dropped and counted instead of blocking the caller.
+//
+// The level comes from the LOG_LEVEL environment variable (trace, debug,
+// info, warn, error, off) and defaults to info, which keeps per-command
+// tracing (debug/trace) out of production output.
+//
+//   LOG_INFO("Client %s disconnected", id.c_str());
+//   LOG_DEBUG("Received command: %.*s", (int)cmd.size(), cmd.data());
+//   LOG_SAMPLED(LogLevel::DEBUG, 100, "...");   // every 100th call per thread
+enum class LogLevel : int { TRACE = 0, DEBUG, INFO, WARN, ERROR, OFF };
+
+namespace Logger {
+    extern std::atomic<int> threshold;
+
+    inline bool enabled(LogLevel level) {
+        return static_cast<int>(level) >= threshold.load(std::memory_order_relaxed);
+    }
+
+    void set_level(LogLevel level);
+    LogLevel level();
+
+    // "trace".."error" or "off", case-insensitive
+    bool parse_level(const char* name, LogLevel& level);
+
+    void write(LogLevel level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    // Writes out everything logged so far; called at exit as well
+    void flush();
+
+    // Records dropped because a thread's ring was full
+    uint64_t dropped();
+}
+
+#define LOG_AT(level, ...) \
+    do { if (Logger::enabled(level)) Logger::write(level, __VA_ARGS__); } while (0)
+
+#define LOG_TRACE(...) LOG_AT(LogLevel::TRACE, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LogLevel::DEBUG, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LogLevel::INFO, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LogLevel::WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::ERROR, __VA_ARGS__)
+
+// Logs one in every_n calls from this call site on each thread
+#define LOG_SAMPLED(level, every_n, ...) \
+    do { \
+        if (Logger::enabled(level)) { \
+            static thread_local uint32_t log_sample_counter = 0; \
+            if (log_sample_counter++ % (every_n) == 0) Logger::write(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process-wide counters and latency histograms, exported in Prometheus text
+// format by a small admin HTTP listener. Updates are lock-free: a thread
+// adds to the cache-line aligned slot of the CPU it runs on with a relaxed
+// atomic, so threads on different CPUs do not contend on a shared line; a
+// scrape sums the slots.
+//
+// Metrics are created once at startup and live for the whole process:
+//
+//   static Counter* drops = metrics().counter("game_host_drops_total", "...");
+//   drops->add();
+//
+//   static Histogram* rtt = metrics().histogram("game_host_rtt_seconds", "...", "action=\"AUDIENCE\"");
+//   Histogram::Timer timer(rtt);    // records the scope's duration
+namespace MetricShards {
+    static const int SHARDS = 16;
+
+    // Slot of the CPU this thread is running on (sched_getcpu(), a vDSO
+    // call); where that is unavailable, one assigned round robin per thread
+    int current();
+}
+
+class Counter {
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> value{0};
+    };
+    Slot slots[MetricShards::SHARDS];
+
+public:
+    void add(uint64_t n = 1) {
+        slots[MetricShards::current()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t value() const;
+};
+
+// HDR-style log-linear histogram of nanosecond durations: values below 16 get
+// a bucket each, above that every power of two is split into 16 sub-buckets,
+// so a bucket is at most 1/16 of its lower bound wide, from 1ns up to ~18
+// minutes (larger values land in the last bucket).
+class Histogram {
+public:
+    static constexpr int SUB_BUCKETS = 16;
+    static constexpr int MAX_EXPONENT = 40;
+    static constexpr int BUCKETS = (MAX_EXPONENT - 2) * SUB_BUCKETS;
+
+    static int bucket_of(uint64_t ns);
+    static uint64_t bucket_upper(int bucket);    // exclusive bound in ns
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[BUCKETS] = {};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum_ns{0};
+    };
+    std::unique_ptr<Shard[]> shards;
+
+public:
+    Histogram() : shards(new Shard[MetricShards::SHARDS]) {}
+
+    void record(uint64_t ns) {
+        Shard& shard = shards[MetricShards::current()];
+        shard.buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    // Summed over all shards
+    void snapshot(std::vector<uint64_t>& buckets, uint64_t& count, uint64_t& sum_ns) const;
+
+    // Upper bound in ns below which the given fraction of samples fall
+    uint64_t percentile(double fraction) const;
+
+    // Records the time from construction to destruction; a null target or
+    // cancel() records nothing
+    class Timer {
+        Histogram* target;
+        std::chrono::steady_clock::time_point start;
+    public:
+        explicit Timer(Histogram* histogram)
+            : target(histogram), start(std::chrono::steady_clock::now()) {}
+        ~Timer() {
+            if (target != nullptr) {
+                target->record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+            }
+        }
+        void cancel() { target = nullptr; }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+    };
+};
+
+class MetricsRegistry {
+    enum Kind { COUNTER, GAUGE, HISTOGRAM };
+
+    struct Entry {
+        Kind kind;
+        std::string name;
+        std::string help;
+        std::string labels;                 // `key="value",...` without braces
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> read;       // callback counters and gauges
+    };
+
+    mutable std::mutex lock;                // registration and scrapes only
+    std::vector<std::unique_ptr<Entry>> entries;
+
+    Entry& add(Kind kind, const std::string& name, const std::string& help, const std::string& labels);
+
+public:
+    Counter* counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Histogram* histogram(const std::string& name, const std::string& help, const std::string& labels = "");
+
+    // Values read from the callback at scrape time, for state the program
+    // already tracks (registry sizes, queue lengths, existing counters)
+    void gauge(const std::string& name, const std::string& help, std::function<double()> read,
+               const std::string& labels = "");
+    void counter_callback(const std::string& name, const std::string& help, std::function<double()> read,
+                          const std::string& labels = "");
+
+    // Prometheus text exposition format 0.0.4
+    std::string render() const;
+};
+
+MetricsRegistry& metrics();
+
+// Serves the registry over HTTP/1.0 on 127.0.0.1:port from a background
+// thread, at /metrics and any path without a page of its own. Returns false
+// if the port cannot be bound.
+bool start_metrics_server(int port);
+
+// Adds a page to the admin listener, rendered on every request for path
+void add_admin_page(const std::string& path, const std::string& content_type, std::function<std::string()> render);
+
+#endif
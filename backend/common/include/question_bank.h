@@ -0,0 +1,120 @@
+#ifndef QUESTION_BANK_H
+#define QUESTION_BANK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only question store shared by every session. The bank is a view over
+// one binary image (layout below): fixed-size question records, a table of
+// question IDs grouped by difficulty tier, category names and an interned
+// string pool. A compiled .qbk file is mmap'ed as is, so services start
+// without parsing and share the page cache; a text bank is compiled into the
+// same image in memory. Sessions keep a shared_ptr to the bank and question
+// IDs, so starting a game allocates nothing.
+//
+// Image layout (little endian, every section 8-byte aligned):
+//   Header | Record[question_count] | uint32 id[question_count] (by tier)
+//   | StringRef category[category_count] | string pool
+class QuestionBank {
+public:
+    static constexpr int TIERS = 5;        // one tier per rung of the ladder
+    static constexpr int OPTIONS = 4;
+    static constexpr uint32_t VERSION = 1;
+
+    struct StringRef {
+        uint32_t offset;               // into the string pool
+        uint32_t length;
+    };
+
+    struct Record {
+        StringRef text;
+        StringRef options[OPTIONS];
+        uint8_t tier;
+        char correct;                  // 'A'..'D'
+        uint16_t category;
+    };
+
+    struct Header {
+        char magic[8];                 // "MQBANK\0\0"
+        uint32_t version;
+        uint32_t question_count;
+        uint32_t category_count;
+        uint32_t tier_count;
+        uint32_t tier_start[TIERS];    // slice of the ID table per tier
+        uint32_t tier_length[TIERS];
+        uint64_t records_offset;
+        uint64_t tier_table_offset;
+        uint64_t categories_offset;
+        uint64_t pool_offset;
+        uint64_t pool_size;
+        uint64_t file_size;
+    };
+
+    // One question as read from a text, CSV or JSON source
+    struct Source {
+        int tier = 0;
+        std::string category;
+        std::string text;
+        std::string options[OPTIONS];
+        char correct = 'A';
+    };
+
+    // IDs of the questions in one tier
+    struct IdRange {
+        const uint32_t* ids;
+        size_t count;
+        uint32_t operator[](size_t i) const { return ids[i]; }
+        size_t size() const { return count; }
+    };
+
+private:
+    std::string owned;                 // image built from text
+    const char* mapped = nullptr;      // image mmap'ed from a .qbk file
+    size_t mapped_size = 0;
+
+    const Header* header = nullptr;
+    const Record* records = nullptr;
+    const uint32_t* tier_table = nullptr;
+    const StringRef* categories = nullptr;
+    const char* pool = nullptr;
+
+    bool attach(const char* image, size_t size, std::string& error);
+    std::string_view view(StringRef ref) const {
+        return std::string_view(pool + ref.offset, ref.length);
+    }
+
+public:
+    QuestionBank() = default;
+    QuestionBank(const QuestionBank&) = delete;
+    QuestionBank& operator=(const QuestionBank&) = delete;
+    ~QuestionBank();
+
+    // Loads a compiled .qbk image (mmap) or a text bank, detected by the
+    // magic bytes. Returns nullptr and sets error if the file is unusable.
+    static std::shared_ptr<const QuestionBank> load(const std::string& path, std::string& error);
+
+    // Text bank: "tier|question|A|B|C|D|correct[|category]" per line, '#'
+    // starts a comment line.
+    static bool parse_text(const std::string& text, const std::string& name, std::vector<Source>& out, std::string& error);
+
+    // Serializes questions into the binary image format
+    static bool compile(const std::vector<Source>& questions, std::string& image, std::string& error);
+
+    size_t size() const { return header->question_count; }
+    std::string_view text(uint32_t id) const { return view(records[id].text); }
+    std::string_view option(uint32_t id, int choice) const { return view(records[id].options[choice]); }
+    char correct_answer(uint32_t id) const { return records[id].correct; }
+    int tier(uint32_t id) const { return records[id].tier; }
+    std::string_view category(uint32_t id) const { return view(categories[records[id].category]); }
+    bool is_mapped() const { return mapped != nullptr; }
+
+    IdRange tier_questions(int tier) const {
+        return IdRange{tier_table + header->tier_start[tier], header->tier_length[tier]};
+    }
+};
+
+#endif
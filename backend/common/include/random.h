@@ -0,0 +1,29 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+// xoshiro256** generator: a few cycles per number and no shared state, so
+// every thread (and every session that needs replayable draws) owns one.
+class FastRandom {
+private:
+    uint64_t s[4];
+
+public:
+    explicit FastRandom(uint64_t seed);
+
+    uint64_t next();
+
+    // Uniform value in [0, bound) without modulo bias
+    uint32_t below(uint32_t bound);
+};
+
+// Sets the process-wide base seed. Threads that draw their first number
+// afterwards derive their generator from it, so a run started with a fixed
+// seed repeats its draws. Defaults to a random seed.
+void seed_thread_random(uint64_t seed);
+
+// The calling thread's generator, created on first use
+FastRandom& thread_random();
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef SHUTDOWN_H
+#define SHUTDOWN_H
+
+#include <functional>
+
+// Runs on_stop for SIGINT and SIGTERM and on_reload (if set) for SIGHUP, on
+// a dedicated signal thread, so a service can drain and return from main()
+// normally: atexit work still runs (the logger's final flush and, in PGO
+// training builds, writing the profiles). A second SIGINT or SIGTERM while
+// the first is being handled exits at once. Must be called first thing in
+// main(), before any other thread starts, because the signals are blocked
+// in the caller and every thread it creates later.
+void handle_signals(std::function<void()> on_stop, std::function<void()> on_reload = nullptr);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef SNAPSHOT_PTR_H
+#define SNAPSHOT_PTR_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// A shared_ptr that many threads read and one occasionally replaces, RCU
+// style: a reader keeps the snapshot it loaded for as long as it holds it,
+// and a replaced value is freed when its last reader lets go.
+//
+// std::atomic_load on a shared_ptr takes a lock, so load() keeps a copy per
+// thread and only checks an atomic version on the fast path; the copy is
+// refreshed when the version moves. A thread's copy keeps the old value
+// alive until that thread loads again.
+template <typename T>
+class SnapshotPtr {
+private:
+    struct Cache {
+        const SnapshotPtr* owner = nullptr;
+        uint64_t version = 0;
+        std::shared_ptr<T> value;
+    };
+
+    std::shared_ptr<T> value;
+    std::atomic<uint64_t> version;
+
+    // Versions are unique across instances, so a thread's copy can never be
+    // mistaken for another instance's
+    static uint64_t next_version() {
+        static std::atomic<uint64_t> versions{1};
+        return versions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+public:
+    explicit SnapshotPtr(std::shared_ptr<T> initial = nullptr) : value(std::move(initial)), version(next_version()) {}
+    SnapshotPtr(const SnapshotPtr&) = delete;
+    SnapshotPtr& operator=(const SnapshotPtr&) = delete;
+
+    void store(std::shared_ptr<T> next) {
+        std::atomic_store(&value, std::move(next));
+        version.store(next_version(), std::memory_order_release);
+    }
+
+    // The current value; the reference stays valid until this thread's next
+    // load() of any SnapshotPtr<T>
+    const std::shared_ptr<T>& load() const {
+        thread_local Cache cache;
+        uint64_t current = version.load(std::memory_order_acquire);
+        if (cache.owner != this || cache.version != current) {
+            cache.value = std::atomic_load(&value);
+            cache.owner = this;
+            cache.version = current;
+        }
+        return cache.value;
+    }
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <exception>
+
+// Return type of a coroutine that runs detached: it starts at once, runs
+// until its first co_await suspends it and frees its frame when it
+// returns. While it is suspended, whoever is to resume it owns the handle.
+//
+//   DetachedTask lookup(std::shared_ptr<Session> owner) {
+//       std::string reply = co_await SomeAwaiter{...};
+//       ...
+//   }
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+#endif
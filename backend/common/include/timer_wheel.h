@@ -0,0 +1,86 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+class TimerWheel;
+
+struct TimerLink {
+    TimerLink* prev = this;
+    TimerLink* next = this;
+};
+
+// A timeout embedded in the object it times (a Session), so arming one
+// allocates nothing. owner is handed back on expiry. A timer cancels itself
+// when destroyed; it must not outlive its wheel while armed.
+struct Timer : TimerLink {
+    void* owner = nullptr;
+    uint64_t expires = 0;           // tick it is due at
+    TimerWheel* wheel = nullptr;    // set while armed
+
+    Timer() = default;
+    ~Timer() { cancel(); }
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+    bool armed() const { return wheel != nullptr; }
+    void cancel();
+};
+
+// Hierarchical timing wheel (Varghese and Lauck): LEVELS wheels of SLOTS
+// lists, level n covering SLOTS^(n+1) ticks. Arming and cancelling are
+// O(1) list operations; a timer moves down one level each time the wheel
+// below it wraps, so it is touched at most LEVELS times however many are
+// armed. A wheel is not thread safe: it belongs to the thread that drives
+// the sessions it times.
+//
+//   wheel.arm(session.idle_timer, &session, 30000);
+//   poll(fds, n, wheel.timeout());
+//   wheel.advance(TimerWheel::now(), [](Timer& timer) { ... });
+class TimerWheel {
+public:
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr int LEVELS = 4;
+    // With 10 ms ticks the top level reaches about 46 hours; longer delays
+    // are cut to that
+    static constexpr uint64_t MAX_TICKS = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+
+    explicit TimerWheel(uint32_t tick_ms = 10);
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Milliseconds on the steady clock
+    static uint64_t now();
+
+    // (Re)arms timer to expire delay_ms from the last advance() (from now on
+    // an empty wheel), rounded up to whole ticks
+    void arm(Timer& timer, void* owner, uint64_t delay_ms);
+
+    // Runs expired on every timer due by now_ms, each unlinked first, so it
+    // may re-arm or cancel any timer or destroy the owner. Returns how many
+    // expired.
+    size_t advance(uint64_t now_ms, const std::function<void(Timer&)>& expired);
+
+    // Milliseconds until advance() has work (a timer due or a higher level
+    // to cascade), for poll() or epoll_wait(); -1 while none is armed
+    int timeout() const;
+
+    size_t size() const { return count; }
+
+private:
+    friend struct Timer;
+
+    uint32_t tick_ms;
+    uint64_t current;               // next tick advance() runs
+    size_t count = 0;
+    TimerLink slots[LEVELS][SLOTS];
+
+    void insert(Timer& timer);
+    void cascade(int level);
+    void unlink(Timer& timer);
+};
+
+#endif
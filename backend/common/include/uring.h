@@ -0,0 +1,109 @@
+#ifndef URING_H
+#define URING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <linux/io_uring.h>
+
+// Minimal io_uring driver on the raw system calls (no liburing). One ring
+// belongs to one thread: SQEs are queued with the prep_* helpers and go to
+// the kernel together in the next submit_and_wait(), which also reaps
+// completions, so a whole batch of sends and re-armed receives costs one
+// system call.
+//
+//   ring.prep_send(fd, data, size, tag);
+//   ring.submit_and_wait(1);
+//   while (io_uring_cqe* cqe = ring.peek()) { ...; ring.advance(); }
+class IoUring {
+private:
+    int ring_fd = -1;
+    void* sq_map = nullptr;
+    size_t sq_map_size = 0;
+    void* cq_map = nullptr;
+    size_t cq_map_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+
+    std::atomic<uint32_t>* sq_head = nullptr;
+    std::atomic<uint32_t>* sq_tail = nullptr;
+    uint32_t sq_mask = 0;
+    uint32_t sq_entries = 0;
+    uint32_t* sq_array = nullptr;
+    uint32_t sq_local_tail = 0;     // one past the last SQE queued
+
+    std::atomic<uint32_t>* cq_head = nullptr;
+    std::atomic<uint32_t>* cq_tail = nullptr;
+    uint32_t cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    io_uring_sqe* next_sqe();
+
+public:
+    IoUring() = default;
+    ~IoUring();
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Sets up a ring with room for entries SQEs, owned by the calling
+    // thread (single issuer, completions run on enter). Returns false with a
+    // reason if the kernel refuses: io_uring disabled, or older than 6.1.
+    bool init(unsigned entries, std::string& error);
+    int fd() const { return ring_fd; }
+
+    // Publishes queued SQEs and waits for at least wait_nr completions.
+    // Returns the SQEs submitted or -errno; EINTR is not an error.
+    int submit_and_wait(unsigned wait_nr);
+    uint64_t enters = 0;            // io_uring_enter calls so far
+
+    // Next completion, or null if none is ready
+    io_uring_cqe* peek();
+    void advance();
+
+    void prep_accept_multishot(int listen_fd, uint64_t tag);
+    // Multishot recv into buffers picked from a provided buffer group
+    void prep_recv_multishot(int fd, uint16_t group, uint64_t tag);
+    void prep_send(int fd, const void* data, size_t size, uint64_t tag);
+    void prep_poll(int fd, uint32_t events, uint64_t tag);
+    void prep_cancel(uint64_t target, uint64_t tag);
+    // Completes with -ETIME after timeout; ts must stay valid until submitted
+    void prep_timeout(const __kernel_timespec* ts, uint64_t tag);
+
+    // user_data for a request on fd: op in the upper half, fd in the lower
+    static uint64_t tag(uint32_t op, int fd) { return static_cast<uint64_t>(op) << 32 | static_cast<uint32_t>(fd); }
+    static uint32_t tag_op(uint64_t tag) { return static_cast<uint32_t>(tag >> 32); }
+    static int tag_fd(uint64_t tag) { return static_cast<int>(static_cast<uint32_t>(tag)); }
+
+    // io_uring_register(2); returns 0 or -errno
+    int register_op(unsigned opcode, void* arg, unsigned count);
+};
+
+// A provided buffer ring (IORING_REGISTER_PBUF_RING): fixed-size receive
+// buffers the kernel picks from as data arrives, so idle connections hold
+// no buffer at all. A buffer reported in a completion is handed back with
+// recycle() once its bytes are consumed.
+class BufferRing {
+private:
+    io_uring_buf_ring* ring = nullptr;
+    size_t ring_size = 0;
+    std::unique_ptr<char[]> buffers;
+    uint32_t count = 0;
+    uint32_t buffer_size = 0;
+    uint16_t group = 0;
+
+public:
+    BufferRing() = default;
+    ~BufferRing();
+    BufferRing(const BufferRing&) = delete;
+    BufferRing& operator=(const BufferRing&) = delete;
+
+    // count must be a power of two
+    bool init(IoUring& uring, uint16_t group, uint32_t count, uint32_t buffer_size, std::string& error);
+    uint16_t id() const { return group; }
+    char* buffer(uint16_t bid) const { return buffers.get() + static_cast<size_t>(bid) * buffer_size; }
+    void recycle(uint16_t bid);
+};
+
+#endif
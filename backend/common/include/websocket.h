@@ -0,0 +1,76 @@
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// RFC 6455 WebSocket codec, just enough for game_host to serve browsers
+// without the Socket.IO adapter in between: the HTTP upgrade, framing and
+// masking. Text messages carry the adapter's line protocol unchanged
+// ("ACTION:clientId[:payload]" in, reply text out), so a WebSocket player
+// runs through the same session logic as one behind the adapter.
+namespace WebSocket {
+
+constexpr size_t MAX_HANDSHAKE = 8192;      // upgrade request, headers included
+constexpr size_t MAX_PAYLOAD = 4096;        // one message, fragments joined
+constexpr size_t MAX_HEADER = 14;           // 64-bit length plus mask key
+
+enum class Opcode : uint8_t {
+    CONTINUATION = 0x0,
+    TEXT = 0x1,
+    BINARY = 0x2,
+    CLOSE = 0x8,
+    PING = 0x9,
+    PONG = 0xa,
+};
+
+// Close status codes
+constexpr uint16_t CLOSE_NORMAL = 1000;
+constexpr uint16_t CLOSE_PROTOCOL_ERROR = 1002;
+constexpr uint16_t CLOSE_UNSUPPORTED = 1003;
+constexpr uint16_t CLOSE_TOO_BIG = 1009;
+
+// Sent instead of the upgrade when the request is not a WebSocket handshake
+extern const char BAD_REQUEST[];
+
+struct Frame {
+    bool fin = false;
+    Opcode opcode = Opcode::CONTINUATION;
+    bool masked = false;
+    std::string_view payload;       // unmasked, inside the decoded buffer
+};
+
+// Parses the HTTP upgrade request at the front of buffer. Returns the bytes
+// it spans with key set to its Sec-WebSocket-Key, 0 if the headers are not
+// complete yet, or -1 if it is not a version 13 WebSocket upgrade.
+int parse_upgrade(std::string_view buffer, std::string_view& key);
+
+// The "101 Switching Protocols" reply to a request with this key
+std::string upgrade_response(std::string_view key);
+
+// Sec-WebSocket-Accept for a key: base64(SHA-1(key + RFC 6455 GUID))
+std::string accept_key(std::string_view key);
+
+// Decodes the frame at the front of data, unmasking its payload in place.
+// Returns the bytes it spans, 0 if it is not complete yet, or -1 if it
+// breaks the protocol (reserved bits or opcodes, a fragmented or oversized
+// control frame, a payload larger than MAX_PAYLOAD).
+int decode(char* data, size_t size, Frame& frame);
+
+// Writes the header of an unmasked, final frame of length bytes into out
+// (MAX_HEADER bytes) and returns its size; the payload follows separately
+size_t encode_header(uint8_t* out, Opcode opcode, uint64_t length);
+
+// Appends a whole final frame: unmasked as a server sends it, or masked
+// with mask_key as a client must
+void encode(std::string& out, Opcode opcode, std::string_view payload);
+void encode_masked(std::string& out, Opcode opcode, std::string_view payload, uint32_t mask_key);
+
+// Appends a CLOSE frame carrying a status code
+void encode_close(std::string& out, uint16_t code);
+
+}
+
+#endif
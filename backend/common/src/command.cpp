@@ -0,0 +1,102 @@
+#include "command.h"
+
+using namespace std;
+
+namespace {
+
+template <typename Enum>
+struct NamedAction {
+    string_view name;
+    Enum action;
+};
+
+const NamedAction<Action> actions[] = {
+    {"CLIENT_ID", Action::CLIENT_ID},
+    {"START", Action::START},
+    {"ANSWER", Action::ANSWER},
+    {"JOKER", Action::JOKER},
+    {"REQUEST", Action::REQUEST},
+    {"DISCONNECT", Action::DISCONNECT},
+    {"MUX", Action::MUX},
+};
+
+const NamedAction<JokerAction> joker_actions[] = {
+    {"REGISTER", JokerAction::REGISTER},
+    {"AUDIENCE", JokerAction::AUDIENCE},
+    {"FIFTY_FIFTY", JokerAction::FIFTY_FIFTY},
+    {"GET_JOKERS", JokerAction::GET_JOKERS},
+    {"DISCONNECT", JokerAction::DISCONNECT},
+    {"HELLO", JokerAction::HELLO},
+    {"ANSWER_STATS", JokerAction::ANSWER_STATS},
+};
+
+// The tables are tiny; comparing the length first rejects most entries
+// without touching their text
+template <typename Enum, size_t N>
+Enum lookup(const NamedAction<Enum> (&table)[N], string_view name) {
+    for (const NamedAction<Enum>& entry : table) {
+        if (entry.name.size() == name.size() && entry.name == name) {
+            return entry.action;
+        }
+    }
+    return Enum::UNKNOWN;
+}
+
+template <typename Enum, size_t N>
+const char* name_of(const NamedAction<Enum> (&table)[N], Enum action) {
+    for (const NamedAction<Enum>& entry : table) {
+        if (entry.action == action) {
+            return entry.name.data();
+        }
+    }
+    return "UNKNOWN";
+}
+
+}
+
+bool parse_command(string_view line, Command& command) {
+    command = Command();
+    size_t colon = line.find(':');
+    if (colon == string_view::npos) {
+        return false;
+    }
+
+    command.name = line.substr(0, colon);
+    command.action = lookup(actions, command.name);
+
+    string_view rest = line.substr(colon + 1);
+    size_t second = rest.find(':');
+    command.client_id = rest.substr(0, second);
+    if (second != string_view::npos) {
+        command.payload = rest.substr(second + 1);
+    }
+    return true;
+}
+
+const char* action_name(Action action) {
+    return name_of(actions, action);
+}
+
+bool parse_joker_request(string_view line, JokerRequest& request) {
+    request = JokerRequest();
+    size_t dash = line.find('-');
+    if (dash == string_view::npos) {
+        return false;
+    }
+
+    request.name = line.substr(0, dash);
+    request.action = lookup(joker_actions, request.name);
+
+    string_view data = line.substr(dash + 1);
+    size_t colon = data.find(':');
+    if (colon != string_view::npos) {
+        request.client_id = data.substr(0, colon);
+        data.remove_prefix(colon + 1);
+    }
+    request.data = data;
+    return true;
+}
+
+const char* joker_action_name(JokerAction action) {
+    return name_of(joker_actions, action);
+}
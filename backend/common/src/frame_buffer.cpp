@@ -0,0 +1,70 @@
+#include <cstring>
+#include "frame_buffer.h"
+
+using namespace std;
+
+FrameBuffer::FrameBuffer(size_t capacity) {
+    this->capacity = capacity;
+}
+
+char* FrameBuffer::write_ptr() {
+    if (data == nullptr) {
+        data.reset(new char[capacity]);
+    }
+    if (head == tail) {
+        head = tail = scanned = 0;
+    } else if (tail == capacity && head > 0) {
+        // Slide the partial frame to the front so the read can continue
+        memmove(data.get(), data.get() + head, tail - head);
+        tail -= head;
+        head = 0;
+    }
+    return data.get() + tail;
+}
+
+size_t FrameBuffer::writable() {
+    write_ptr();
+    return capacity - tail;
+}
+
+void FrameBuffer::commit(size_t n) {
+    tail += n;
+}
+
+bool FrameBuffer::next_frame(string_view& frame) {
+    if (head == tail) {
+        return false;
+    }
+    const char* start = data.get() + head;
+    const char* newline = static_cast<const char*>(memchr(start + scanned, '\n', tail - head - scanned));
+    if (newline == nullptr) {
+        scanned = tail - head;
+        return false;
+    }
+
+    size_t length = newline - start;
+    head += length + 1;
+    scanned = 0;
+
+    if (length > 0 && start[length - 1] == '\r') {
+        length--;
+    }
+    frame = string_view(start, length);
+    return true;
+}
+
+string_view FrameBuffer::peek() const {
+    if (data == nullptr) {
+        return string_view();
+    }
+    return string_view(data.get() + head, tail - head);
+}
+
+void FrameBuffer::consume(size_t n) {
+    head += n;
+    scanned = 0;
+}
+
+bool FrameBuffer::overflowed() const {
+    return head == 0 && tail == capacity && scanned == tail;
+}
@@ -0,0 +1,95 @@
+#include "joker_wire.h"
+
+using namespace std;
+
+namespace {
+
+void put(string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out += static_cast<char>(value >> (8 * i));
+    }
+}
+
+uint64_t get(const char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+}
+
+namespace JokerWire {
+
+void encode(string& out, Header header, string_view payload) {
+    header.length = static_cast<uint16_t>(payload.size());
+    put(out, static_cast<uint8_t>(header.type), 1);
+    put(out, header.arg, 1);
+    put(out, header.length, 2);
+    put(out, header.request_id, 4);
+    put(out, header.question, 4);
+    put(out, header.client, 8);
+    out.append(payload);
+}
+
+int decode(string_view buffer, Header& header, string_view& payload) {
+    if (buffer.size() < HEADER_SIZE) {
+        return 0;
+    }
+
+    const char* in = buffer.data();
+    header.type = static_cast<Type>(get(in, 1));
+    header.arg = static_cast<uint8_t>(get(in + 1, 1));
+    header.length = static_cast<uint16_t>(get(in + 2, 2));
+    header.request_id = static_cast<uint32_t>(get(in + 4, 4));
+    header.question = static_cast<uint32_t>(get(in + 8, 4));
+    header.client = get(in + 12, 8);
+
+    if (header.length > MAX_PAYLOAD) {
+        return -1;
+    }
+    if (buffer.size() < HEADER_SIZE + header.length) {
+        return 0;
+    }
+    payload = buffer.substr(HEADER_SIZE, header.length);
+    return static_cast<int>(HEADER_SIZE + header.length);
+}
+
+void encode_batches(string& out, Type type, string_view messages) {
+    Header header;
+    string_view payload;
+    while (!messages.empty()) {
+        // Cut at the last message boundary that fits
+        size_t size = 0;
+        int consumed;
+        while (size < messages.size() && (consumed = decode(messages.substr(size), header, payload)) > 0 &&
+               size + consumed <= MAX_PAYLOAD) {
+            size += consumed;
+        }
+        if (size == 0) {
+            // Not a sequence of messages; pass it through unchanged
+            out.append(messages);
+            return;
+        }
+
+        Header batch;
+        batch.type = type;
+        encode(out, batch, messages.substr(0, size));
+        messages.remove_prefix(size);
+    }
+}
+
+uint64_t client_handle(string_view client_id) {
+    if (client_id.empty()) {
+        return 0;
+    }
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : client_id) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+}
@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <strings.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "logger.h"
+
+using namespace std;
+
+#define RING_SLOTS 64          // per thread; a power of two
+#define RECORD_TEXT 232
+#define FLUSH_INTERVAL chrono::milliseconds(50)
+
+namespace {
+
+struct Record {
+    uint64_t timestamp_ns;
+    uint32_t thread;
+    uint16_t level;
+    uint16_t length;
+    char text[RECORD_TEXT];
+};
+
+// Single producer (the owning thread), single consumer (the flusher)
+struct Ring {
+    alignas(64) atomic<uint64_t> head{0};    // next slot to write
+    alignas(64) atomic<uint64_t> tail{0};    // next slot to read
+    atomic<bool> retired{false};             // owner exited; free once drained
+    uint32_t thread = 0;
+    Record slots[RING_SLOTS];
+};
+
+struct State {
+    mutex lock;                // guards rings and the flusher's startup
+    condition_variable wake;
+    vector<Ring*> rings;
+    thread flusher;
+    bool running = false;
+    uint32_t next_thread = 1;
+    atomic<uint64_t> dropped{0};
+    mutex write_lock;          // one drain at a time (flusher or flush())
+};
+
+State& state() {
+    static State* s = new State();    // never destroyed: threads may log during exit
+    return *s;
+}
+
+const char* level_name(int level) {
+    static const char* const names[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR"};
+    return level >= 0 && level < 5 ? names[level] : "?";
+}
+
+int level_from_env() {
+    const char* value = getenv("LOG_LEVEL");
+    LogLevel level = LogLevel::INFO;
+    if (value != nullptr) {
+        Logger::parse_level(value, level);
+    }
+    return static_cast<int>(level);
+}
+
+void drain() {
+    State& s = state();
+    lock_guard<mutex> write_guard(s.write_lock);
+
+    vector<Record> batch;
+    {
+        lock_guard<mutex> guard(s.lock);
+        for (size_t i = 0; i < s.rings.size();) {
+            Ring* ring = s.rings[i];
+            // Read retired before head so a final record is never missed
+            bool retired = ring->retired.load(memory_order_acquire);
+            uint64_t head = ring->head.load(memory_order_acquire);
+            uint64_t tail = ring->tail.load(memory_order_relaxed);
+            for (; tail < head; tail++) {
+                batch.push_back(ring->slots[tail % RING_SLOTS]);
+            }
+            ring->tail.store(tail, memory_order_release);
+
+            if (retired) {
+                delete ring;
+                s.rings[i] = s.rings.back();
+                s.rings.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+    if (batch.empty()) {
+        return;
+    }
+    stable_sort(batch.begin(), batch.end(), [](const Record& a, const Record& b) {
+        return a.timestamp_ns < b.timestamp_ns;
+    });
+
+    string out;
+    out.reserve(batch.size() * 96);
+    for (const Record& r : batch) {
+        time_t seconds = static_cast<time_t>(r.timestamp_ns / 1000000000);
+        struct tm local;
+        localtime_r(&seconds, &local);
+        char prefix[64];
+        int n = snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%06u %-5s [%u] ",
+                         local.tm_hour, local.tm_min, local.tm_sec,
+                         static_cast<unsigned>((r.timestamp_ns / 1000) % 1000000),
+                         level_name(r.level), r.thread);
+        out.append(prefix, n);
+        out.append(r.text, r.length);
+        out += '\n';
+    }
+
+    uint64_t lost = s.dropped.exchange(0);
+    if (lost > 0) {
+        out += "WARN  logger dropped " + to_string(lost) + " records\n";
+    }
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+}
+
+void run_flusher() {
+    State& s = state();
+    while (true) {
+        {
+            unique_lock<mutex> guard(s.lock);
+            s.wake.wait_for(guard, FLUSH_INTERVAL);
+        }
+        drain();
+    }
+}
+
+// Owns the calling thread's ring; retires it when the thread exits
+struct ThreadRing {
+    Ring* ring = nullptr;
+
+    Ring* get() {
+        if (ring == nullptr) {
+            ring = new Ring();
+            State& s = state();
+            lock_guard<mutex> guard(s.lock);
+            ring->thread = s.next_thread++;
+            s.rings.push_back(ring);
+            if (!s.running) {
+                s.running = true;
+                s.flusher = thread(run_flusher);
+                s.flusher.detach();
+                atexit(Logger::flush);
+            }
+        }
+        return ring;
+    }
+
+    ~ThreadRing() {
+        if (ring != nullptr) {
+            ring->retired.store(true, memory_order_release);
+        }
+    }
+};
+
+}
+
+namespace Logger {
+
+atomic<int> threshold{level_from_env()};
+
+void set_level(LogLevel level) {
+    threshold.store(static_cast<int>(level), memory_order_relaxed);
+}
+
+LogLevel level() {
+    return static_cast<LogLevel>(threshold.load(memory_order_relaxed));
+}
+
+bool parse_level(const char* name, LogLevel& level) {
+    static const char* const names[] = {"trace", "debug", "info", "warn", "error", "off"};
+    for (int i = 0; i < 6; i++) {
+        if (strcasecmp(name, names[i]) == 0) {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void write(LogLevel level, const char* format, ...) {
+    thread_local ThreadRing local;
+    Ring* ring = local.get();
+
+    uint64_t head = ring->head.load(memory_order_relaxed);
+    if (head - ring->tail.load(memory_order_acquire) >= RING_SLOTS) {
+        state().dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    Record& r = ring->slots[head % RING_SLOTS];
+    r.timestamp_ns = chrono::duration_cast<chrono::nanoseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    r.thread = ring->thread;
+    r.level = static_cast<uint16_t>(level);
+
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(r.text, sizeof(r.text), format, args);
+    va_end(args);
+    r.length = static_cast<uint16_t>(n < 0 ? 0 : min<int>(n, sizeof(r.text) - 1));
+
+    ring->head.store(head + 1, memory_order_release);
+
+    // Errors are written promptly; everything else waits for the next tick
+    if (level >= LogLevel::ERROR) {
+        state().wake.notify_one();
+    }
+}
+
+void flush() {
+    drain();
+}
+
+uint64_t dropped() {
+    return state().dropped.load(memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string_view>
+#include <thread>
+#include <netinet/in.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "logger.h"
+#include "metrics.h"
+
+using namespace std;
+
+#define LOWEST_BOUND_EXPONENT 10    // exported buckets: 2^10ns (~1us) ..
+#define HIGHEST_BOUND_EXPONENT 36   // .. 2^36ns (~69s), then +Inf
+#define ADMIN_IO_TIMEOUT_MS 2000    // per admin request read and write
+#define ADMIN_ACCEPT_BACKOFF_MS 100 // pause after a failed accept
+
+namespace MetricShards {
+
+int current() {
+    int cpu = sched_getcpu();
+    if (cpu >= 0) {
+        return cpu % SHARDS;
+    }
+    static atomic<int> next{0};
+    thread_local int slot = next.fetch_add(1, memory_order_relaxed) % SHARDS;
+    return slot;
+}
+
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const Slot& slot : slots) {
+        total += slot.value.load(memory_order_relaxed);
+    }
+    return total;
+}
+
+int Histogram::bucket_of(uint64_t ns) {
+    if (ns < SUB_BUCKETS) {
+        return static_cast<int>(ns);
+    }
+    int exponent = 63 - __builtin_clzll(ns);
+    if (exponent > MAX_EXPONENT) {
+        return BUCKETS - 1;
+    }
+    // The four bits below the leading one pick the sub-bucket
+    int sub = static_cast<int>((ns >> (exponent - 4)) & (SUB_BUCKETS - 1));
+    return (exponent - 3) * SUB_BUCKETS + sub;
+}
+
+uint64_t Histogram::bucket_upper(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket + 1;
+    }
+    int exponent = bucket / SUB_BUCKETS + 3;
+    uint64_t sub = bucket % SUB_BUCKETS;
+    return (SUB_BUCKETS + sub + 1) << (exponent - 4);
+}
+
+void Histogram::snapshot(vector<uint64_t>& buckets, uint64_t& count, uint64_t& sum_ns) const {
+    buckets.assign(BUCKETS, 0);
+    count = 0;
+    sum_ns = 0;
+    for (int s = 0; s < MetricShards::SHARDS; s++) {
+        const Shard& shard = shards[s];
+        for (int i = 0; i < BUCKETS; i++) {
+            buckets[i] += shard.buckets[i].load(memory_order_relaxed);
+        }
+        count += shard.count.load(memory_order_relaxed);
+        sum_ns += shard.sum_ns.load(memory_order_relaxed);
+    }
+}
+
+uint64_t Histogram::percentile(double fraction) const {
+    vector<uint64_t> buckets;
+    uint64_t count, sum_ns;
+    snapshot(buckets, count, sum_ns);
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = min(static_cast<uint64_t>(fraction * count), count - 1);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen > rank) {
+            return bucket_upper(i);
+        }
+    }
+    return bucket_upper(BUCKETS - 1);
+}
+
+MetricsRegistry::Entry& MetricsRegistry::add(Kind kind, const string& name, const string& help, const string& labels) {
+    auto entry = make_unique<Entry>();
+    entry->kind = kind;
+    entry->name = name;
+    entry->help = help;
+    entry->labels = labels;
+
+    lock_guard<mutex> guard(lock);
+    entries.push_back(move(entry));
+    return *entries.back();
+}
+
+Counter* MetricsRegistry::counter(const string& name, const string& help, const string& labels) {
+    Entry& entry = add(COUNTER, name, help, labels);
+    entry.counter = make_unique<Counter>();
+    return entry.counter.get();
+}
+
+Histogram* MetricsRegistry::histogram(const string& name, const string& help, const string& labels) {
+    Entry& entry = add(HISTOGRAM, name, help, labels);
+    entry.histogram = make_unique<Histogram>();
+    return entry.histogram.get();
+}
+
+void MetricsRegistry::gauge(const string& name, const string& help, function<double()> read, const string& labels) {
+    add(GAUGE, name, help, labels).read = move(read);
+}
+
+void MetricsRegistry::counter_callback(const string& name, const string& help, function<double()> read, const string& labels) {
+    add(COUNTER, name, help, labels).read = move(read);
+}
+
+// "name{labels,extra}" with the braces left out when there are no labels
+static string series(const string& name, const string& labels, const string& extra = "") {
+    string joined = labels;
+    if (!extra.empty()) {
+        joined += joined.empty() ? extra : "," + extra;
+    }
+    return joined.empty() ? name : name + "{" + joined + "}";
+}
+
+static string number(double value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.12g", value);
+    return text;
+}
+
+string MetricsRegistry::render() const {
+    static const char* const types[] = {"counter", "gauge", "histogram"};
+
+    lock_guard<mutex> guard(lock);
+    string out;
+    vector<bool> written(entries.size(), false);
+    vector<uint64_t> buckets;
+
+    // Series of one family are grouped under a single HELP/TYPE header
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (written[i]) {
+            continue;
+        }
+        const Entry& head = *entries[i];
+        out += "# HELP " + head.name + " " + head.help + "\n";
+        out += "# TYPE " + head.name + " " + types[head.kind] + "\n";
+
+        for (size_t j = i; j < entries.size(); j++) {
+            const Entry& e = *entries[j];
+            if (written[j] || e.name != head.name) {
+                continue;
+            }
+            written[j] = true;
+
+            if (e.kind != HISTOGRAM) {
+                double value = e.read ? e.read() : static_cast<double>(e.counter->value());
+                out += series(e.name, e.labels) + " " + number(value) + "\n";
+                continue;
+            }
+
+            uint64_t count, sum_ns;
+            e.histogram->snapshot(buckets, count, sum_ns);
+
+            // Powers of two line up with sub-bucket edges, so the exported
+            // cumulative counts are exact
+            uint64_t cumulative = 0;
+            int bucket = 0;
+            for (int exponent = LOWEST_BOUND_EXPONENT; exponent <= HIGHEST_BOUND_EXPONENT; exponent++) {
+                uint64_t bound = uint64_t(1) << exponent;
+                while (bucket < Histogram::BUCKETS && Histogram::bucket_upper(bucket) <= bound) {
+                    cumulative += buckets[bucket++];
+                }
+                out += series(e.name + "_bucket", e.labels, "le=\"" + number(bound / 1e9) + "\"") +
+                       " " + to_string(cumulative) + "\n";
+            }
+            out += series(e.name + "_bucket", e.labels, "le=\"+Inf\"") + " " + to_string(count) + "\n";
+            out += series(e.name + "_sum", e.labels) + " " + number(sum_ns / 1e9) + "\n";
+            out += series(e.name + "_count", e.labels) + " " + to_string(count) + "\n";
+        }
+    }
+    return out;
+}
+
+MetricsRegistry& metrics() {
+    static MetricsRegistry* registry = new MetricsRegistry();    // outlives every thread
+    return *registry;
+}
+
+struct AdminPage {
+    string content_type;
+    function<string()> render;
+};
+
+static mutex admin_pages_mutex;
+static map<string, AdminPage>& admin_pages() {
+    static map<string, AdminPage>* pages = new map<string, AdminPage>();    // outlives every thread
+    return *pages;
+}
+
+void add_admin_page(const string& path, const string& content_type, function<string()> render) {
+    lock_guard<mutex> lock(admin_pages_mutex);
+    admin_pages()[path] = AdminPage{content_type, move(render)};
+}
+
+// Path of "GET /path HTTP/1.x"
+static string request_path(const char* request, size_t length) {
+    string_view line(request, length);
+    size_t start = line.find(' ');
+    if (start == string_view::npos) {
+        return "";
+    }
+    size_t end = line.find_first_of(" ?\r\n", start + 1);
+    return string(line.substr(start + 1, end == string_view::npos ? string_view::npos : end - start - 1));
+}
+
+// One request at a time: a client that stalls holds up the next scrape
+// for at most ADMIN_IO_TIMEOUT_MS, and running out of descriptors backs
+// off instead of spinning on accept
+static void serve_metrics(int listen_fd) {
+    char request[1024];
+    bool accept_failing = false;
+    struct timeval io_timeout = {ADMIN_IO_TIMEOUT_MS / 1000, (ADMIN_IO_TIMEOUT_MS % 1000) * 1000};
+    while (true) {
+        int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (!accept_failing) {
+                LOG_WARN("Metrics accept failed: %s", strerror(errno));
+                accept_failing = true;
+            }
+            this_thread::sleep_for(chrono::milliseconds(ADMIN_ACCEPT_BACKOFF_MS));
+            continue;
+        }
+        accept_failing = false;
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &io_timeout, sizeof(io_timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &io_timeout, sizeof(io_timeout));
+
+        // Only the request line matters; reading it also keeps close from resetting
+        ssize_t length = recv(client, request, sizeof(request), 0);
+        string path = length > 0 ? request_path(request, length) : "";
+
+        string body;
+        string content_type = "text/plain; version=0.0.4";
+        AdminPage page;
+        {
+            lock_guard<mutex> lock(admin_pages_mutex);
+            auto it = admin_pages().find(path);
+            if (it != admin_pages().end()) {
+                page = it->second;
+            }
+        }
+        if (page.render) {
+            body = page.render();
+            content_type = page.content_type;
+        } else {
+            body = metrics().render();
+        }
+
+        string response = "HTTP/1.0 200 OK\r\n"
+                          "Content-Type: " + content_type + "\r\n"
+                          "Content-Length: " + to_string(body.size()) + "\r\n\r\n" + body;
+        size_t offset = 0;
+        while (offset < response.size()) {
+            ssize_t n = send(client, response.data() + offset, response.size() - offset, MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            offset += n;
+        }
+        close(client);
+    }
+}
+
+bool start_metrics_server(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("Metrics socket failed");
+        return false;
+    }
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, 16) < 0) {
+        perror("Metrics bind failed");
+        close(fd);
+        return false;
+    }
+
+    thread(serve_metrics, fd).detach();
+    LOG_INFO("Metrics available on http://127.0.0.1:%d/metrics", port);
+    return true;
+}
@@ -0,0 +1,308 @@
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "question_bank.h"
+
+using namespace std;
+
+static const char MAGIC[8] = {'M', 'Q', 'B', 'A', 'N', 'K', 0, 0};
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+QuestionBank::~QuestionBank() {
+    if (mapped != nullptr) {
+        munmap(const_cast<char*>(mapped), mapped_size);
+    }
+}
+
+shared_ptr<const QuestionBank> QuestionBank::load(const string& path, string& error) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "cannot open " + path + ": " + strerror(errno);
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        error = "cannot stat " + path + ": " + strerror(errno);
+        close(fd);
+        return nullptr;
+    }
+
+    char magic[sizeof(MAGIC)] = {0};
+    bool binary = pread(fd, magic, sizeof(magic), 0) == sizeof(magic) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+
+    auto bank = make_shared<QuestionBank>();
+    if (binary) {
+        void* image = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (image == MAP_FAILED) {
+            error = "cannot map " + path + ": " + strerror(errno);
+            return nullptr;
+        }
+        bank->mapped = static_cast<const char*>(image);
+        bank->mapped_size = st.st_size;
+        if (!bank->attach(bank->mapped, bank->mapped_size, error)) {
+            error = path + ": " + error;
+            return nullptr;
+        }
+        return bank;
+    }
+    close(fd);
+
+    ifstream file(path);
+    stringstream contents;
+    contents << file.rdbuf();
+
+    vector<Source> questions;
+    if (!parse_text(contents.str(), path, questions, error) || !compile(questions, bank->owned, error)) {
+        return nullptr;
+    }
+    if (!bank->attach(bank->owned.data(), bank->owned.size(), error)) {
+        error = path + ": " + error;
+        return nullptr;
+    }
+    return bank;
+}
+
+// True if length bytes at offset lie within size bytes. Written so a huge
+// offset from a corrupt header cannot wrap the sum around.
+static bool in_bounds(uint64_t offset, uint64_t length, uint64_t size) {
+    return offset <= size && length <= size - offset;
+}
+
+// Points the accessors at an image after checking every offset in it, so a
+// truncated or corrupt file is rejected up front instead of read out of bounds
+bool QuestionBank::attach(const char* image, size_t size, string& error) {
+    if (size < sizeof(Header)) {
+        error = "truncated header";
+        return false;
+    }
+    const Header* h = reinterpret_cast<const Header*>(image);
+    if (memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->version != VERSION || h->tier_count != TIERS) {
+        error = "not a version " + to_string(VERSION) + " question bank";
+        return false;
+    }
+
+    // Counts are 32 bits, so the section lengths themselves cannot overflow
+    uint64_t count = h->question_count;
+    if (h->file_size != size ||
+        !in_bounds(h->records_offset, count * sizeof(Record), size) ||
+        !in_bounds(h->tier_table_offset, count * sizeof(uint32_t), size) ||
+        !in_bounds(h->categories_offset, uint64_t(h->category_count) * sizeof(StringRef), size) ||
+        !in_bounds(h->pool_offset, h->pool_size, size) ||
+        h->records_offset % 8 != 0 || h->tier_table_offset % 8 != 0 || h->categories_offset % 8 != 0) {
+        error = "section out of bounds";
+        return false;
+    }
+
+    const Record* r = reinterpret_cast<const Record*>(image + h->records_offset);
+    const uint32_t* ids = reinterpret_cast<const uint32_t*>(image + h->tier_table_offset);
+    const StringRef* cats = reinterpret_cast<const StringRef*>(image + h->categories_offset);
+
+    auto valid = [&](StringRef ref) {
+        return uint64_t(ref.offset) + ref.length <= h->pool_size;
+    };
+
+    for (uint32_t i = 0; i < h->category_count; i++) {
+        if (!valid(cats[i])) {
+            error = "category " + to_string(i) + " out of bounds";
+            return false;
+        }
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        bool ok = valid(r[i].text) && r[i].tier < TIERS && r[i].correct >= 'A' && r[i].correct <= 'D' &&
+                  r[i].category < h->category_count;
+        for (int j = 0; j < OPTIONS; j++) {
+            ok = ok && valid(r[i].options[j]);
+        }
+        if (!ok) {
+            error = "question " + to_string(i) + " is corrupt";
+            return false;
+        }
+    }
+    for (int tier = 0; tier < TIERS; tier++) {
+        if (h->tier_length[tier] == 0) {
+            error = "no questions for tier " + to_string(tier);
+            return false;
+        }
+        if (uint64_t(h->tier_start[tier]) + h->tier_length[tier] > count) {
+            error = "tier " + to_string(tier) + " out of bounds";
+            return false;
+        }
+        for (uint32_t i = 0; i < h->tier_length[tier]; i++) {
+            uint32_t id = ids[h->tier_start[tier] + i];
+            if (id >= count || r[id].tier != tier) {
+                error = "tier " + to_string(tier) + " lists a foreign question";
+                return false;
+            }
+        }
+    }
+
+    header = h;
+    records = r;
+    tier_table = ids;
+    categories = cats;
+    pool = image + h->pool_offset;
+    return true;
+}
+
+bool QuestionBank::parse_text(const string& text, const string& name, vector<Source>& out, string& error) {
+    int line_number = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == string::npos) {
+            end = text.size();
+        }
+        string_view line(text.data() + pos, end - pos);
+        pos = end + 1;
+        line_number++;
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        string_view fields[8];
+        int count = 0;
+        while (count < 8) {
+            size_t bar = line.find('|');
+            fields[count++] = line.substr(0, bar);
+            if (bar == string_view::npos) {
+                break;
+            }
+            line.remove_prefix(bar + 1);
+        }
+
+        int tier = fields[0].size() == 1 ? fields[0][0] - '0' : -1;
+        char correct = fields[6].size() == 1 ? fields[6][0] : '?';
+        if (count < 7 || tier < 0 || tier >= TIERS || correct < 'A' || correct > 'D') {
+            error = name + ":" + to_string(line_number) + ": expected tier|question|A|B|C|D|correct[|category]";
+            return false;
+        }
+
+        Source question;
+        question.tier = tier;
+        question.text = string(fields[1]);
+        for (int i = 0; i < OPTIONS; i++) {
+            question.options[i] = string(fields[2 + i]);
+        }
+        question.correct = correct;
+        question.category = count == 8 ? string(fields[7]) : "general";
+        out.push_back(move(question));
+    }
+    return true;
+}
+
+bool QuestionBank::compile(const vector<Source>& questions, string& image, string& error) {
+    if (questions.size() > UINT32_MAX / 2) {
+        error = "too many questions";
+        return false;
+    }
+
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.question_count = static_cast<uint32_t>(questions.size());
+    h.tier_count = TIERS;
+
+    // Identical strings (years, "Stack", ...) are stored once. Keys point
+    // into the sources, which outlive the map.
+    string strings;
+    unordered_map<string_view, StringRef> interned;
+    auto intern = [&](const string& s) {
+        auto it = interned.find(s);
+        if (it != interned.end()) {
+            return it->second;
+        }
+        StringRef ref = {static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(s.size())};
+        strings += s;
+        interned.emplace(s, ref);
+        return ref;
+    };
+
+    vector<StringRef> category_refs;
+    unordered_map<string_view, uint16_t> category_ids;
+    vector<Record> records(questions.size());
+    vector<uint32_t> by_tier[TIERS];
+
+    for (size_t i = 0; i < questions.size(); i++) {
+        const Source& q = questions[i];
+        if (q.tier < 0 || q.tier >= TIERS || q.correct < 'A' || q.correct > 'D') {
+            error = "question " + to_string(i + 1) + " has an invalid tier or answer";
+            return false;
+        }
+
+        auto cat = category_ids.find(q.category);
+        if (cat == category_ids.end()) {
+            if (category_refs.size() > UINT16_MAX) {
+                error = "too many categories";
+                return false;
+            }
+            cat = category_ids.emplace(q.category, static_cast<uint16_t>(category_refs.size())).first;
+            category_refs.push_back(intern(q.category));
+        }
+
+        Record& r = records[i];
+        memset(&r, 0, sizeof(r));
+        r.text = intern(q.text);
+        for (int j = 0; j < OPTIONS; j++) {
+            r.options[j] = intern(q.options[j]);
+        }
+        r.tier = static_cast<uint8_t>(q.tier);
+        r.correct = q.correct;
+        r.category = cat->second;
+        by_tier[q.tier].push_back(static_cast<uint32_t>(i));
+    }
+
+    uint32_t start = 0;
+    for (int tier = 0; tier < TIERS; tier++) {
+        if (by_tier[tier].empty()) {
+            error = "no questions for tier " + to_string(tier);
+            return false;
+        }
+        h.tier_start[tier] = start;
+        h.tier_length[tier] = static_cast<uint32_t>(by_tier[tier].size());
+        start += h.tier_length[tier];
+    }
+    if (strings.size() > UINT32_MAX) {
+        error = "string pool too large";
+        return false;
+    }
+
+    h.category_count = static_cast<uint32_t>(category_refs.size());
+    h.records_offset = align8(sizeof(Header));
+    h.tier_table_offset = align8(h.records_offset + records.size() * sizeof(Record));
+    h.categories_offset = align8(h.tier_table_offset + questions.size() * sizeof(uint32_t));
+    h.pool_offset = align8(h.categories_offset + category_refs.size() * sizeof(StringRef));
+    h.pool_size = strings.size();
+    h.file_size = h.pool_offset + h.pool_size;
+
+    image.assign(h.file_size, '\0');
+    memcpy(&image[0], &h, sizeof(h));
+    if (!records.empty()) {
+        memcpy(&image[h.records_offset], records.data(), records.size() * sizeof(Record));
+    }
+    size_t offset = h.tier_table_offset;
+    for (int tier = 0; tier < TIERS; tier++) {
+        memcpy(&image[offset], by_tier[tier].data(), by_tier[tier].size() * sizeof(uint32_t));
+        offset += by_tier[tier].size() * sizeof(uint32_t);
+    }
+    if (!category_refs.empty()) {
+        memcpy(&image[h.categories_offset], category_refs.data(), category_refs.size() * sizeof(StringRef));
+    }
+    memcpy(&image[h.pool_offset], strings.data(), strings.size());
+    return true;
+}
@@ -0,0 +1,64 @@
+#include <atomic>
+#include <chrono>
+#include <random>
+#include "random.h"
+
+using namespace std;
+
+static uint64_t splitmix64(uint64_t& x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+FastRandom::FastRandom(uint64_t seed) {
+    // splitmix64 spreads any seed, including 0, over the whole state
+    for (uint64_t& word : s) {
+        word = splitmix64(seed);
+    }
+}
+
+uint64_t FastRandom::next() {
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+uint32_t FastRandom::below(uint32_t bound) {
+    // Lemire's multiply-and-shift with rejection of the biased low range
+    uint64_t m = (next() >> 32) * bound;
+    uint32_t low = static_cast<uint32_t>(m);
+    if (low < bound) {
+        uint32_t threshold = -bound % bound;
+        while (low < threshold) {
+            m = (next() >> 32) * bound;
+            low = static_cast<uint32_t>(m);
+        }
+    }
+    return static_cast<uint32_t>(m >> 32);
+}
+
+static atomic<uint64_t> base_seed{random_device()() ^
+    static_cast<uint64_t>(chrono::steady_clock::now().time_since_epoch().count())};
+static atomic<uint64_t> thread_counter{0};
+
+void seed_thread_random(uint64_t seed) {
+    base_seed = seed;
+    thread_counter = 0;
+}
+
+FastRandom& thread_random() {
+    thread_local FastRandom generator(base_seed.load() + 0x9e3779b97f4a7c15ULL * ++thread_counter);
+    return generator;
+}
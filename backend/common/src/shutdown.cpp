@@ -0,0 +1,42 @@
+#include <csignal>
+#include <cstdlib>
+#include <thread>
+#include <pthread.h>
+#include "logger.h"
+#include "shutdown.h"
+
+using namespace std;
+
+void handle_signals(function<void()> on_stop, function<void()> on_reload) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    thread([signals, on_stop, on_reload] {
+        bool stopping = false;
+        while (true) {
+            int signal = 0;
+            if (sigwait(&signals, &signal) != 0) {
+                continue;
+            }
+
+            if (signal == SIGHUP) {
+                if (on_reload) {
+                    LOG_INFO("Received SIGHUP, reloading");
+                    on_reload();
+                }
+                continue;
+            }
+            if (stopping) {
+                LOG_WARN("Received signal %d while stopping, exiting now", signal);
+                exit(0);
+            }
+            stopping = true;
+            LOG_INFO("Received signal %d, stopping", signal);
+            on_stop();
+        }
+    }).detach();
+}
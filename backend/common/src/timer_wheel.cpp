@@ -0,0 +1,149 @@
+#include <chrono>
+#include "timer_wheel.h"
+
+using namespace std;
+
+void Timer::cancel() {
+    if (wheel != nullptr) {
+        wheel->unlink(*this);
+    }
+}
+
+TimerWheel::TimerWheel(uint32_t tick_ms) {
+    this->tick_ms = tick_ms > 0 ? tick_ms : 1;
+    current = now() / this->tick_ms;
+}
+
+uint64_t TimerWheel::now() {
+    return static_cast<uint64_t>(
+        chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void TimerWheel::arm(Timer& timer, void* owner, uint64_t delay_ms) {
+    timer.cancel();
+
+    // An empty wheel is not advanced while its thread sleeps, so its clock
+    // may be behind
+    if (count == 0) {
+        uint64_t ticks_now = now() / tick_ms + 1;
+        if (ticks_now > current) {
+            current = ticks_now;
+        }
+    }
+
+    // At least one tick: the slot advance() is running may already be done
+    uint64_t ticks = (delay_ms + tick_ms - 1) / tick_ms;
+    if (ticks == 0) {
+        ticks = 1;
+    } else if (ticks > MAX_TICKS) {
+        ticks = MAX_TICKS;
+    }
+    timer.owner = owner;
+    timer.expires = current + ticks;
+    timer.wheel = this;
+    count++;
+    insert(timer);
+}
+
+// Files a timer by how far away it is: level 0 holds the next SLOTS ticks
+// one per slot, each level above a SLOTS times coarser span
+void TimerWheel::insert(Timer& timer) {
+    uint64_t delta = timer.expires > current ? timer.expires - current : 0;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    TimerLink& head = slots[level][(timer.expires >> (SLOT_BITS * level)) & (SLOTS - 1)];
+
+    timer.prev = head.prev;
+    timer.next = &head;
+    head.prev->next = &timer;
+    head.prev = &timer;
+}
+
+void TimerWheel::unlink(Timer& timer) {
+    timer.prev->next = timer.next;
+    timer.next->prev = timer.prev;
+    timer.prev = timer.next = &timer;
+    timer.wheel = nullptr;
+    count--;
+}
+
+// Refiles the slot of level that the current tick has reached; its timers
+// are now close enough for the levels below
+void TimerWheel::cascade(int level) {
+    TimerLink& head = slots[level][(current >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    TimerLink* link = head.next;
+    head.prev = head.next = &head;
+    while (link != &head) {
+        TimerLink* next = link->next;
+        insert(*static_cast<Timer*>(link));
+        link = next;
+    }
+}
+
+size_t TimerWheel::advance(uint64_t now_ms, const function<void(Timer&)>& expired) {
+    uint64_t target = now_ms / tick_ms;
+    if (count == 0) {
+        if (target >= current) {
+            current = target + 1;
+        }
+        return 0;
+    }
+
+    size_t fired = 0;
+    while (current <= target && count > 0) {
+        // Each time a level wraps, the next one up hands down a slot
+        for (int level = 1; level < LEVELS; level++) {
+            if ((current >> (SLOT_BITS * (level - 1))) & (SLOTS - 1)) {
+                break;
+            }
+            cascade(level);
+        }
+
+        // Detach the due timers first: expired may arm new ones
+        TimerLink due;
+        TimerLink& head = slots[0][current & (SLOTS - 1)];
+        if (head.next != &head) {
+            due.next = head.next;
+            due.prev = head.prev;
+            due.next->prev = &due;
+            due.prev->next = &due;
+            head.prev = head.next = &head;
+        }
+        current++;
+
+        // Unlinking from due as it goes lets expired cancel any timer in it
+        while (due.next != &due) {
+            Timer& timer = *static_cast<Timer*>(due.next);
+            unlink(timer);
+            fired++;
+            expired(timer);
+        }
+    }
+    if (current <= target) {
+        current = target + 1;
+    }
+    return fired;
+}
+
+int TimerWheel::timeout() const {
+    if (count == 0) {
+        return -1;
+    }
+
+    // The next non-empty slot before level 0 wraps, or the wrap itself,
+    // where the level above cascades
+    uint64_t ticks = SLOTS - (current & (SLOTS - 1));
+    for (uint64_t i = 0; i < ticks; i++) {
+        const TimerLink& head = slots[0][(current + i) & (SLOTS - 1)];
+        if (head.next != &head) {
+            ticks = i;
+            break;
+        }
+    }
+
+    uint64_t due = (current + ticks) * tick_ms;
+    uint64_t now_ms = now();
+    return due > now_ms ? static_cast<int>(due - now_ms) : 0;
+}
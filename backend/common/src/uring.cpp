@@ -0,0 +1,237 @@
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "uring.h"
+
+using namespace std;
+
+template <typename T>
+static T* at(void* base, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+IoUring::~IoUring() {
+    if (sqes != nullptr) {
+        munmap(sqes, sqes_size);
+    }
+    if (cq_map != nullptr && cq_map != sq_map) {
+        munmap(cq_map, cq_map_size);
+    }
+    if (sq_map != nullptr) {
+        munmap(sq_map, sq_map_size);
+    }
+    if (ring_fd >= 0) {
+        close(ring_fd);
+    }
+}
+
+bool IoUring::init(unsigned entries, string& error) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    // Completions are reaped in batches, so give them more room than SQEs
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+
+    ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ring_fd < 0) {
+        error = string("io_uring_setup: ") + strerror(errno);
+        return false;
+    }
+
+    sq_map_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_map_size = cq_map_size = max(sq_map_size, cq_map_size);
+    }
+
+    sq_map = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_map == MAP_FAILED) {
+        sq_map = nullptr;
+        error = string("mmap of the submission ring: ") + strerror(errno);
+        return false;
+    }
+    cq_map = sq_map;
+    if (!single_mmap) {
+        cq_map = mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_map == MAP_FAILED) {
+            cq_map = nullptr;
+            error = string("mmap of the completion ring: ") + strerror(errno);
+            return false;
+        }
+    }
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqe_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqe_map == MAP_FAILED) {
+        error = string("mmap of the SQEs: ") + strerror(errno);
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe*>(sqe_map);
+
+    sq_head = at<atomic<uint32_t>>(sq_map, params.sq_off.head);
+    sq_tail = at<atomic<uint32_t>>(sq_map, params.sq_off.tail);
+    sq_mask = *at<uint32_t>(sq_map, params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sq_array = at<uint32_t>(sq_map, params.sq_off.array);
+    sq_local_tail = sq_tail->load(memory_order_relaxed);
+
+    cq_head = at<atomic<uint32_t>>(cq_map, params.cq_off.head);
+    cq_tail = at<atomic<uint32_t>>(cq_map, params.cq_off.tail);
+    cq_mask = *at<uint32_t>(cq_map, params.cq_off.ring_mask);
+    cqes = at<io_uring_cqe>(cq_map, params.cq_off.cqes);
+    return true;
+}
+
+io_uring_sqe* IoUring::next_sqe() {
+    // A full queue is handed to the kernel early rather than failing
+    if (sq_local_tail - sq_head->load(memory_order_acquire) >= sq_entries) {
+        submit_and_wait(0);
+    }
+    uint32_t index = sq_local_tail & sq_mask;
+    sq_array[index] = index;
+    sq_local_tail++;
+
+    io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int IoUring::submit_and_wait(unsigned wait_nr) {
+    sq_tail->store(sq_local_tail, memory_order_release);
+    unsigned to_submit = sq_local_tail - sq_head->load(memory_order_acquire);
+
+    // GETEVENTS even without waiting: deferred completions only run on it
+    enters++;
+    int submitted = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, wait_nr, IORING_ENTER_GETEVENTS,
+                                             nullptr, 0));
+    if (submitted < 0) {
+        return errno == EINTR ? 0 : -errno;
+    }
+    return submitted;
+}
+
+io_uring_cqe* IoUring::peek() {
+    uint32_t head = cq_head->load(memory_order_relaxed);
+    if (head == cq_tail->load(memory_order_acquire)) {
+        return nullptr;
+    }
+    return &cqes[head & cq_mask];
+}
+
+void IoUring::advance() {
+    cq_head->store(cq_head->load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+void IoUring::prep_accept_multishot(int listen_fd, uint64_t tag) {
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = tag;
+}
+
+void IoUring::prep_recv_multishot(int fd, uint16_t group, uint64_t tag) {
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group;
+    sqe->user_data = tag;
+}
+
+void IoUring::prep_send(int fd, const void* data, size_t size, uint64_t tag) {
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(data);
+    sqe->len = static_cast<uint32_t>(size);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = tag;
+}
+
+void IoUring::prep_poll(int fd, uint32_t events, uint64_t tag) {
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = tag;
+}
+
+void IoUring::prep_cancel(uint64_t target, uint64_t tag) {
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = tag;
+}
+
+void IoUring::prep_timeout(const __kernel_timespec* ts, uint64_t tag) {
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(ts);
+    sqe->len = 1;
+    sqe->user_data = tag;
+}
+
+int IoUring::register_op(unsigned opcode, void* arg, unsigned count) {
+    if (syscall(__NR_io_uring_register, ring_fd, opcode, arg, count) < 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+BufferRing::~BufferRing() {
+    if (ring != nullptr) {
+        munmap(ring, ring_size);
+    }
+}
+
+bool BufferRing::init(IoUring& uring, uint16_t group, uint32_t count, uint32_t buffer_size, string& error) {
+    this->group = group;
+    this->count = count;
+    this->buffer_size = buffer_size;
+
+    ring_size = count * sizeof(io_uring_buf);
+    void* memory = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        error = string("mmap of the buffer ring: ") + strerror(errno);
+        return false;
+    }
+    ring = static_cast<io_uring_buf_ring*>(memory);
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = count;
+    reg.bgid = group;
+    int result = uring.register_op(IORING_REGISTER_PBUF_RING, &reg, 1);
+    if (result < 0) {
+        error = string("registering the buffer ring: ") + strerror(-result);
+        return false;
+    }
+
+    buffers.reset(new char[static_cast<size_t>(count) * buffer_size]);
+    for (uint32_t bid = 0; bid < count; bid++) {
+        recycle(static_cast<uint16_t>(bid));
+    }
+    return true;
+}
+
+void BufferRing::recycle(uint16_t bid) {
+    // Only this thread writes the tail; it shares memory with bufs[0].resv,
+    // which is why the entry's other fields are set one by one. The entries
+    // are indexed from the start of the ring: in C++ the header's flexible
+    // array member sits 8 bytes further in, past an empty placeholder struct.
+    uint16_t tail = ring->tail;
+    io_uring_buf* entry = reinterpret_cast<io_uring_buf*>(ring) + (tail & (count - 1));
+    entry->addr = reinterpret_cast<uint64_t>(buffer(bid));
+    entry->len = buffer_size;
+    entry->bid = bid;
+    __atomic_store_n(&ring->tail, static_cast<uint16_t>(tail + 1), __ATOMIC_RELEASE);
+}
@@ -0,0 +1,323 @@
+#include <cstring>
+#include "websocket.h"
+
+using namespace std;
+
+namespace {
+
+const char GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+uint32_t rotl(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// SHA-1 (FIPS 180-4). Only used on handshake keys, so it favors brevity.
+void sha1(string_view message, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+    // Padding: 0x80, zeros, then the bit length as a big-endian u64
+    string padded(message);
+    padded += static_cast<char>(0x80);
+    while (padded.size() % 64 != 56) {
+        padded += '\0';
+    }
+    uint64_t bits = static_cast<uint64_t>(message.size()) * 8;
+    for (int i = 7; i >= 0; i--) {
+        padded += static_cast<char>(bits >> (8 * i));
+    }
+
+    for (size_t block = 0; block < padded.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(padded.data() + block + 4 * i);
+            w[i] = static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+                   static_cast<uint32_t>(p[2]) << 8 | p[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            uint32_t t = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; j < 4; j++) {
+            digest[4 * i + j] = static_cast<uint8_t>(h[i] >> (24 - 8 * j));
+        }
+    }
+}
+
+string base64(const uint8_t* data, size_t size) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    string out;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t group = static_cast<uint32_t>(data[i]) << 16;
+        if (i + 1 < size) {
+            group |= static_cast<uint32_t>(data[i + 1]) << 8;
+        }
+        if (i + 2 < size) {
+            group |= data[i + 2];
+        }
+        out += alphabet[(group >> 18) & 63];
+        out += alphabet[(group >> 12) & 63];
+        out += i + 1 < size ? alphabet[(group >> 6) & 63] : '=';
+        out += i + 2 < size ? alphabet[group & 63] : '=';
+    }
+    return out;
+}
+
+char lower(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool equals_ignore_case(string_view a, string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (lower(a[i]) != lower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+string_view trim(string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+// True if a comma-separated header value lists token (case-insensitive),
+// as in "Connection: keep-alive, Upgrade"
+bool has_token(string_view value, string_view token) {
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        if (equals_ignore_case(trim(value.substr(0, comma)), token)) {
+            return true;
+        }
+        value.remove_prefix(comma == string_view::npos ? value.size() : comma + 1);
+    }
+    return false;
+}
+
+}
+
+namespace WebSocket {
+
+const char BAD_REQUEST[] =
+    "HTTP/1.1 400 Bad Request\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n\r\n";
+
+int parse_upgrade(string_view buffer, string_view& key) {
+    size_t end = buffer.find("\r\n\r\n");
+    if (end == string_view::npos) {
+        return 0;
+    }
+    string_view request = buffer.substr(0, end + 2);
+
+    size_t line_end = request.find("\r\n");
+    if (request.compare(0, 4, "GET ") != 0 || request.substr(0, line_end).find(" HTTP/1.1") == string_view::npos) {
+        return -1;
+    }
+    request.remove_prefix(line_end + 2);
+
+    bool upgrade = false, connection = false, version = false;
+    key = string_view();
+    while (!request.empty()) {
+        line_end = request.find("\r\n");
+        string_view line = request.substr(0, line_end);
+        request.remove_prefix(line_end + 2);
+
+        size_t colon = line.find(':');
+        if (colon == string_view::npos) {
+            return -1;
+        }
+        string_view name = line.substr(0, colon);
+        string_view value = trim(line.substr(colon + 1));
+
+        if (equals_ignore_case(name, "Upgrade")) {
+            upgrade = has_token(value, "websocket");
+        } else if (equals_ignore_case(name, "Connection")) {
+            connection = has_token(value, "upgrade");
+        } else if (equals_ignore_case(name, "Sec-WebSocket-Version")) {
+            version = value == "13";
+        } else if (equals_ignore_case(name, "Sec-WebSocket-Key")) {
+            key = value;
+        }
+    }
+
+    // The key is 16 random bytes in base64
+    if (!upgrade || !connection || !version || key.size() != 24) {
+        return -1;
+    }
+    return static_cast<int>(end + 4);
+}
+
+string accept_key(string_view key) {
+    string input(key);
+    input += GUID;
+    uint8_t digest[20];
+    sha1(input, digest);
+    return base64(digest, sizeof(digest));
+}
+
+string upgrade_response(string_view key) {
+    return "HTTP/1.1 101 Switching Protocols\r\n"
+           "Upgrade: websocket\r\n"
+           "Connection: Upgrade\r\n"
+           "Sec-WebSocket-Accept: " + accept_key(key) + "\r\n\r\n";
+}
+
+int decode(char* data, size_t size, Frame& frame) {
+    if (size < 2) {
+        return 0;
+    }
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+    if (in[0] & 0x70) {
+        return -1;      // reserved bits, no extension was negotiated
+    }
+    frame.fin = in[0] & 0x80;
+    frame.opcode = static_cast<Opcode>(in[0] & 0x0f);
+    frame.masked = in[1] & 0x80;
+
+    uint64_t length = in[1] & 0x7f;
+    size_t header = 2;
+    if (length == 126) {
+        if (size < 4) {
+            return 0;
+        }
+        length = static_cast<uint64_t>(in[2]) << 8 | in[3];
+        header = 4;
+    } else if (length == 127) {
+        if (size < 10) {
+            return 0;
+        }
+        length = 0;
+        for (int i = 0; i < 8; i++) {
+            length = length << 8 | in[2 + i];
+        }
+        header = 10;
+    }
+
+    switch (frame.opcode) {
+    case Opcode::CONTINUATION:
+    case Opcode::TEXT:
+    case Opcode::BINARY:
+        break;
+    case Opcode::CLOSE:
+    case Opcode::PING:
+    case Opcode::PONG:
+        if (!frame.fin || length > 125) {
+            return -1;
+        }
+        break;
+    default:
+        return -1;
+    }
+    if (length > MAX_PAYLOAD) {
+        return -1;
+    }
+
+    uint8_t mask[4] = {0, 0, 0, 0};
+    if (frame.masked) {
+        if (size < header + 4) {
+            return 0;
+        }
+        memcpy(mask, in + header, 4);
+        header += 4;
+    }
+    if (size < header + length) {
+        return 0;
+    }
+
+    char* payload = data + header;
+    if (frame.masked) {
+        for (size_t i = 0; i < length; i++) {
+            payload[i] ^= mask[i % 4];
+        }
+    }
+    frame.payload = string_view(payload, length);
+    return static_cast<int>(header + length);
+}
+
+size_t encode_header(uint8_t* out, Opcode opcode, uint64_t length) {
+    out[0] = 0x80 | static_cast<uint8_t>(opcode);
+    if (length < 126) {
+        out[1] = static_cast<uint8_t>(length);
+        return 2;
+    }
+    if (length <= 0xffff) {
+        out[1] = 126;
+        out[2] = static_cast<uint8_t>(length >> 8);
+        out[3] = static_cast<uint8_t>(length);
+        return 4;
+    }
+    out[1] = 127;
+    for (int i = 0; i < 8; i++) {
+        out[2 + i] = static_cast<uint8_t>(length >> (56 - 8 * i));
+    }
+    return 10;
+}
+
+void encode(string& out, Opcode opcode, string_view payload) {
+    uint8_t header[MAX_HEADER];
+    size_t header_size = encode_header(header, opcode, payload.size());
+    out.append(reinterpret_cast<const char*>(header), header_size);
+    out.append(payload);
+}
+
+void encode_masked(string& out, Opcode opcode, string_view payload, uint32_t mask_key) {
+    uint8_t header[MAX_HEADER];
+    size_t header_size = encode_header(header, opcode, payload.size());
+    header[1] |= 0x80;
+    uint8_t mask[4];
+    for (int i = 0; i < 4; i++) {
+        mask[i] = static_cast<uint8_t>(mask_key >> (8 * i));
+        header[header_size++] = mask[i];
+    }
+    out.append(reinterpret_cast<const char*>(header), header_size);
+    for (size_t i = 0; i < payload.size(); i++) {
+        out += static_cast<char>(payload[i] ^ mask[i % 4]);
+    }
+}
+
+void encode_close(string& out, uint16_t code) {
+    char status[2] = {static_cast<char>(code >> 8), static_cast<char>(code)};
+    encode(out, Opcode::CLOSE, string_view(status, sizeof(status)));
+}
+
+}
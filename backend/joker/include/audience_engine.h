@@ -0,0 +1,50 @@
+#ifndef AUDIENCE_ENGINE_H
+#define AUDIENCE_ENGINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "question_bank.h"
+
+// "Ask the Audience" polls for every question of a bank, kept in a flat
+// table indexed by question ID. Each poll starts from a prior set by the
+// question's difficulty tier (the easier the question, the more the
+// audience agrees on the right answer) and is recomputed whenever answer
+// statistics for that question arrive, so a lookup is one atomic load no
+// matter how large the bank is.
+class AudienceEngine {
+public:
+    static constexpr int OPTIONS = QuestionBank::OPTIONS;
+
+    // Weight of the tier prior, in answers; real answers outweigh it once a
+    // question has been played a few dozen times
+    static constexpr uint32_t PRIOR_VOTES = 40;
+
+private:
+    struct Entry {
+        std::atomic<uint32_t> poll{0};              // four percentages, one byte each
+        std::atomic<uint64_t> answers[OPTIONS] = {};
+        uint16_t prior[OPTIONS] = {};               // per mille, sums to 1000
+    };
+
+    std::unique_ptr<Entry[]> entries;
+    size_t count = 0;
+
+    static uint32_t compute_poll(const Entry& entry);
+
+public:
+    explicit AudienceEngine(const QuestionBank& bank);
+    AudienceEngine(const AudienceEngine&) = delete;
+    AudienceEngine& operator=(const AudienceEngine&) = delete;
+
+    size_t size() const { return count; }
+
+    // Percentages for A, B, C and D, summing to 100; an even split for IDs
+    // outside the bank
+    void poll(uint32_t question_id, uint8_t percentages[OPTIONS]) const;
+
+    // Adds how many players picked each option; ignored for unknown IDs
+    void record_answers(uint32_t question_id, const uint32_t answers[OPTIONS]);
+};
+
+#endif
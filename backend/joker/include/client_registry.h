@@ -0,0 +1,44 @@
+#ifndef CLIENT_REGISTRY_H
+#define CLIENT_REGISTRY_H
+
+#include <cstddef>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "entry.h"
+
+// Concurrent map from WebSocket client ID to the game_host socket that sent
+// it. Keys are spread over lock stripes by hash; each stripe is a linear
+// probing table that grows on demand and deletes by backward shifting, so
+// insert, lookup and removal are O(1) without tombstones or a size cap.
+class ClientRegistry {
+private:
+    static constexpr size_t STRIPES = 64;
+
+    struct alignas(64) Stripe {
+        std::mutex lock;
+        std::vector<Entry> slots;   // power-of-two sized
+        size_t count = 0;
+    };
+
+    Stripe stripes[STRIPES];
+
+    static size_t hash_of(std::string_view client_id);
+    static size_t find_slot(const Stripe& stripe, size_t hash, std::string_view client_id);
+    static void grow(Stripe& stripe);
+    static void remove_slot(Stripe& stripe, size_t hole);
+
+public:
+    explicit ClientRegistry(size_t expected_clients);
+
+    // Returns true if the ID was new; a known ID just has its socket updated
+    bool insert(std::string_view client_id, int socket);
+    bool find(std::string_view client_id, int& socket);
+    bool erase(std::string_view client_id);
+    // Removes every ID last seen on socket, once that connection has closed;
+    // returns how many there were
+    size_t erase_socket(int socket);
+    size_t size();
+};
+
+#endif
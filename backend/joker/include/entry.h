@@ -1,9 +1,14 @@
 #ifndef ENTRY_H
 #define ENTRY_H
 
+#include <cstddef>
+#include <string>
+
+// One slot of the client registry's open-addressing table
 struct Entry {
-    int key;
-    char value[100]; 
+    size_t hash = 0;     // 0 marks an empty slot
+    int key = -1;        // socket of the game_host connection
+    std::string value;   // WebSocket client ID
 };
 
-#endif
\ No newline at end of file
+#endif
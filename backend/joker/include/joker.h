@@ -1,7 +1,11 @@
 #include <iostream>
+#include <memory>
 #include <string>
-#include <map>
-#include "entry.h"
+#include <string_view>
+#include "audience_engine.h"
+#include "client_registry.h"
+#include "joker_wire.h"
+#include "snapshot_ptr.h"
 
 #ifndef JOKER_H 
 #define JOKER_H
@@ -9,16 +13,34 @@
 class Joker {
 private:
     int m;
-    int currentSize = 0; 
-    static const int MAX_SIZE = 100;
-    struct Entry map[MAX_SIZE];
+    ClientRegistry registry;
+    SnapshotPtr<AudienceEngine> audience;     // replaced on reload
 
 public:
     Joker(int max_clients);
-    void register_client(int client_socket, const char* value);
-    std::string get_audience_results(int question_index);
-    std::string get_fifty_fifty_options(int question_index, char correct_answer);
-    void process_request(const std::string& request, int client_socket);
+    // Players are registered by JokerWire::client_handle() of their ID, the
+    // form binary requests carry it in
+    void register_client(int client_socket, std::string_view client_id);
+    void register_handle(int client_socket, uint64_t handle);
+    bool unregister_client(std::string_view client_id);
+    bool unregister_handle(uint64_t handle);
+    // Players of a game_host connection that closed without unregistering
+    // them
+    size_t forget_socket(int client_socket) { return registry.erase_socket(client_socket); }
+    size_t client_count() { return registry.size(); }
+    // Polls for bank from now on; requests in flight finish on the old
+    // engine, and answers recorded for the old bank start over
+    void set_question_bank(const QuestionBank& bank);
+    void audience_percentages(uint32_t question_id, uint8_t percentages[4]);
+    std::string get_audience_results(uint32_t question_id);
+    void record_answers(uint32_t question_id, const uint32_t answers[4]);
+    char fifty_fifty_partner(char correct_answer);
+    std::string get_fifty_fifty_options(char correct_answer);
+    std::string process_request(std::string_view request, int client_socket);
+
+    // Binary protocol counterpart of process_request: appends the reply
+    // message (if one is due) to out
+    void process_message(const JokerWire::Header& request, std::string_view payload, int client_socket, std::string& out);
 };
 
 #endif
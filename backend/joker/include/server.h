@@ -1,6 +1,8 @@
 #ifndef SERVER_H 
 #define SERVER_H
 #include "joker.h"
+#include <atomic>
+#include <chrono>
 #include <netinet/in.h> // Add this include for sockaddr_in
 
 class Server {
@@ -8,12 +10,24 @@ private:
     int p;  
     int server_fd, new_socket;
     struct sockaddr_in address;
+    int stop_fd;
+    std::atomic<bool> stopping{false};
+    std::atomic<std::chrono::steady_clock::rep> drain_deadline{0};
     
 public:
     Server(int port);
     void setJokerService(Joker* joker);
+    // Blocks until stop() and the drain that follows are done
     void start();
+    // The same on one io_uring: multishot accept and recv, and the replies
+    // to a batch of requests submitted together. Falls back to start() on
+    // kernels without io_uring support.
+    void start_uring();
     void handle_client(int client_socket);
+    // Stops accepting game_host connections. Open ones are served until
+    // game_host closes them or drain_timeout passes, then their reads are
+    // shut down so requests already received are still answered.
+    void stop(std::chrono::seconds drain_timeout);
 };
 
 #endif
@@ -1,27 +1,122 @@
 #include <iostream>
+#include <cstring>
+#include <mutex>
 #include "include/server.h"
 #include "include/joker.h"
+#include "logger.h"
+#include "metrics.h"
+#include "shutdown.h"
 
 using namespace std;
 
 #define SERVER_PORT 4338
-#define MAX_CLIENTS 10
+#define ADMIN_PORT 9338     // Prometheus metrics, loopback only
+#define MAX_CLIENTS 100000 // expected concurrent players, sizes the client registry
+#define QUESTIONS_FILE "../data/questions.txt"
+#define DRAIN_TIMEOUT_S 5   // how long game hosts keep being served after SIGTERM
+
+// What the signal thread acts on; it may outlive main(), so these do too
+static mutex lifecycle_mutex;
+static Server* running_server = nullptr;
+static Joker* running_joker = nullptr;
+static const char* questions_file = QUESTIONS_FILE;
+static long drain_timeout_s = DRAIN_TIMEOUT_S;
+
+// Usage: joker_service [--questions=PATH] [--drain-timeout=S] [--uring]
+//   --questions  question bank the audience polls are computed for; must be
+//                the bank game_host plays (default ../data/questions.txt)
+//   --drain-timeout  seconds open game_host connections are still served
+//                once SIGINT or SIGTERM stops the service (default 5)
+//   --uring      serve every game_host connection from one io_uring event
+//                loop instead of a thread each (Linux 6.1 or later)
+//
+// SIGHUP reloads the question bank; send it to game_host at the same time.
+// The port is bound with SO_REUSEPORT, so a new joker_service can start
+// before the old one is stopped; game_host reconnects to it when the old
+// one closes its connections.
+int main(int argc, char* argv[]) {
+    // A signal before the server is up just exits
+    handle_signals([] {
+        {
+            lock_guard<mutex> lock(lifecycle_mutex);
+            if (running_server != nullptr) {
+                running_server->stop(chrono::seconds(drain_timeout_s));
+                return;
+            }
+        }
+        exit(0);
+    }, [] {
+        lock_guard<mutex> lock(lifecycle_mutex);
+        if (running_joker == nullptr) {
+            return;
+        }
+        string error;
+        shared_ptr<const QuestionBank> bank = QuestionBank::load(questions_file, error);
+        if (bank == nullptr) {
+            LOG_ERROR("Reload failed, keeping the current audience polls: %s", error.c_str());
+            return;
+        }
+        running_joker->set_question_bank(*bank);
+        LOG_INFO("Audience polls recomputed for %zu questions from %s", bank->size(), questions_file);
+    });
+
+    bool uring = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--questions=", 12) == 0) {
+            questions_file = argv[i] + 12;
+        } else if (strncmp(argv[i], "--drain-timeout=", 16) == 0) {
+            drain_timeout_s = atol(argv[i] + 16);
+        } else if (strcmp(argv[i], "--uring") == 0) {
+            uring = true;
+        } else {
+            cerr << "Unknown option: " << argv[i] << endl;
+            cerr << "Usage: " << argv[0] <<  " [--questions=PATH] [--drain-timeout=S] [--uring]" << endl;
+            return 1;
+        }
+    }
 
-int main() {
     // Create the joker service
     Joker* joker = new Joker(MAX_CLIENTS);
+
+    // Audience polls are precomputed per question; without the bank every
+    // poll is an even split
+    string error;
+    shared_ptr<const QuestionBank> bank = QuestionBank::load(questions_file, error);
+    if (bank != nullptr) {
+        joker->set_question_bank(*bank);
+        LOG_INFO("Audience polls precomputed for %zu questions from %s", bank->size(), questions_file);
+    } else {
+        LOG_WARN("No question bank for audience polls (%s); polls will be even", error.c_str());
+    }
     
     // Create the server and set the joker service
     Server server(SERVER_PORT);
     server.setJokerService(joker);
     
-    cout << "Joker Service started on port " << SERVER_PORT << endl;
-    
-    // Start the server (this will block until the server is stopped)
-    server.start();
+    {
+        lock_guard<mutex> lock(lifecycle_mutex);
+        running_server = &server;
+        running_joker = joker;
+    }
+
+    LOG_INFO("Joker Service started on port %d", SERVER_PORT);
+    start_metrics_server(ADMIN_PORT);
     
-    // Clean up (this will never be reached in the current implementation)
+    // Start the server (this blocks until a signal stops it and the game
+    // host connections have drained)
+    if (uring) {
+        server.start_uring();
+    } else {
+        server.start();
+    }
+
+    {
+        lock_guard<mutex> lock(lifecycle_mutex);
+        running_server = nullptr;
+        running_joker = nullptr;
+    }
     delete joker;
+    LOG_INFO("Joker Service stopped");
     
     return 0;
 }
@@ -0,0 +1,114 @@
+#include <cmath>
+#include "../include/audience_engine.h"
+
+using namespace std;
+
+// Share of the audience that knows the answer, per mille, by tier
+static const uint16_t CORRECT_SHARE[QuestionBank::TIERS] = {720, 600, 490, 400, 330};
+
+AudienceEngine::AudienceEngine(const QuestionBank& bank) {
+    count = bank.size();
+    entries.reset(new Entry[count]);
+
+    for (uint32_t id = 0; id < count; id++) {
+        Entry& entry = entries[id];
+        int tier = bank.tier(id);
+        int correct = bank.correct_answer(id) - 'A';
+        if (correct < 0 || correct >= OPTIONS) {
+            correct = 0;
+        }
+        uint16_t correct_share = CORRECT_SHARE[tier >= 0 && tier < QuestionBank::TIERS ? tier : QuestionBank::TIERS - 1];
+
+        // The rest of the audience guesses, with a per-question lean so
+        // wrong options do not all poll the same (Knuth hash of the ID)
+        uint32_t lean = id * 2654435761u;
+        uint32_t weights[OPTIONS];
+        uint32_t weight_total = 0;
+        for (int i = 0; i < OPTIONS; i++) {
+            weights[i] = i == correct ? 0 : 1 + (lean >> (8 * i)) % 4;
+            weight_total += weights[i];
+        }
+
+        int assigned = correct_share;
+        int largest = -1;
+        for (int i = 0; i < OPTIONS; i++) {
+            if (i == correct) {
+                entry.prior[i] = correct_share;
+                continue;
+            }
+            entry.prior[i] = static_cast<uint16_t>((1000 - correct_share) * weights[i] / weight_total);
+            assigned += entry.prior[i];
+            if (largest < 0 || weights[i] > weights[largest]) {
+                largest = i;
+            }
+        }
+        entry.prior[largest] += 1000 - assigned;
+
+        entry.poll = compute_poll(entry);
+    }
+}
+
+// Blends the prior with the recorded answers and rounds to whole
+// percentages that still sum to 100 (largest remainder)
+uint32_t AudienceEngine::compute_poll(const Entry& entry) {
+    double weights[OPTIONS];
+    double total = 0;
+    for (int i = 0; i < OPTIONS; i++) {
+        weights[i] = entry.prior[i] * (PRIOR_VOTES / 1000.0) + static_cast<double>(entry.answers[i].load(memory_order_relaxed));
+        total += weights[i];
+    }
+
+    int percentages[OPTIONS];
+    double remainders[OPTIONS];
+    int assigned = 0;
+    for (int i = 0; i < OPTIONS; i++) {
+        double exact = 100.0 * weights[i] / total;
+        percentages[i] = static_cast<int>(floor(exact));
+        remainders[i] = exact - percentages[i];
+        assigned += percentages[i];
+    }
+    for (; assigned < 100; assigned++) {
+        int best = 0;
+        for (int i = 1; i < OPTIONS; i++) {
+            if (remainders[i] > remainders[best]) {
+                best = i;
+            }
+        }
+        percentages[best]++;
+        remainders[best] = -1;
+    }
+
+    uint32_t packed = 0;
+    for (int i = 0; i < OPTIONS; i++) {
+        packed |= static_cast<uint32_t>(percentages[i]) << (8 * i);
+    }
+    return packed;
+}
+
+void AudienceEngine::poll(uint32_t question_id, uint8_t percentages[OPTIONS]) const {
+    if (question_id >= count) {
+        for (int i = 0; i < OPTIONS; i++) {
+            percentages[i] = 100 / OPTIONS;
+        }
+        return;
+    }
+
+    uint32_t packed = entries[question_id].poll.load(memory_order_relaxed);
+    for (int i = 0; i < OPTIONS; i++) {
+        percentages[i] = static_cast<uint8_t>(packed >> (8 * i));
+    }
+}
+
+void AudienceEngine::record_answers(uint32_t question_id, const uint32_t answers[OPTIONS]) {
+    if (question_id >= count) {
+        return;
+    }
+
+    // Concurrent updates of one question may publish slightly stale polls;
+    // the next update for it corrects them
+    Entry& entry = entries[question_id];
+    for (int i = 0; i < OPTIONS; i++) {
+        entry.answers[i].fetch_add(answers[i], memory_order_relaxed);
+    }
+    entry.poll.store(compute_poll(entry), memory_order_relaxed);
+}
@@ -0,0 +1,143 @@
+#include <functional>
+#include "../include/client_registry.h"
+
+using namespace std;
+
+ClientRegistry::ClientRegistry(size_t expected_clients) {
+    // Keep every stripe at most half full for the expected population
+    size_t per_stripe = expected_clients * 2 / STRIPES;
+    size_t capacity = 16;
+    while (capacity < per_stripe) {
+        capacity <<= 1;
+    }
+    for (Stripe& stripe : stripes) {
+        stripe.slots.resize(capacity);
+    }
+}
+
+size_t ClientRegistry::hash_of(string_view client_id) {
+    size_t hash = std::hash<string_view>()(client_id);
+    return hash == 0 ? 1 : hash;
+}
+
+// Index of the slot holding client_id, or of the empty slot ending its probe
+size_t ClientRegistry::find_slot(const Stripe& stripe, size_t hash, string_view client_id) {
+    size_t mask = stripe.slots.size() - 1;
+    // The high bits picked the stripe, so probe with the low bits
+    size_t i = hash & mask;
+    while (true) {
+        const Entry& entry = stripe.slots[i];
+        if (entry.hash == 0 || (entry.hash == hash && entry.value == client_id)) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+void ClientRegistry::grow(Stripe& stripe) {
+    vector<Entry> old(stripe.slots.size() * 2);
+    old.swap(stripe.slots);
+
+    for (Entry& entry : old) {
+        if (entry.hash != 0) {
+            size_t i = find_slot(stripe, entry.hash, entry.value);
+            stripe.slots[i] = move(entry);
+        }
+    }
+}
+
+bool ClientRegistry::insert(string_view client_id, int socket) {
+    size_t hash = hash_of(client_id);
+    Stripe& stripe = stripes[hash >> 58];
+    lock_guard<mutex> lock(stripe.lock);
+
+    size_t i = find_slot(stripe, hash, client_id);
+    if (stripe.slots[i].hash != 0) {
+        stripe.slots[i].key = socket;
+        return false;
+    }
+
+    if ((stripe.count + 1) * 2 > stripe.slots.size()) {
+        grow(stripe);
+        i = find_slot(stripe, hash, client_id);
+    }
+
+    Entry& entry = stripe.slots[i];
+    entry.hash = hash;
+    entry.key = socket;
+    entry.value.assign(client_id);
+    stripe.count++;
+    return true;
+}
+
+bool ClientRegistry::find(string_view client_id, int& socket) {
+    size_t hash = hash_of(client_id);
+    Stripe& stripe = stripes[hash >> 58];
+    lock_guard<mutex> lock(stripe.lock);
+
+    const Entry& entry = stripe.slots[find_slot(stripe, hash, client_id)];
+    if (entry.hash == 0) {
+        return false;
+    }
+    socket = entry.key;
+    return true;
+}
+
+bool ClientRegistry::erase(string_view client_id) {
+    size_t hash = hash_of(client_id);
+    Stripe& stripe = stripes[hash >> 58];
+    lock_guard<mutex> lock(stripe.lock);
+
+    size_t hole = find_slot(stripe, hash, client_id);
+    if (stripe.slots[hole].hash == 0) {
+        return false;
+    }
+    remove_slot(stripe, hole);
+    return true;
+}
+
+size_t ClientRegistry::erase_socket(int socket) {
+    size_t removed = 0;
+    for (Stripe& stripe : stripes) {
+        lock_guard<mutex> lock(stripe.lock);
+        size_t i = 0;
+        while (i < stripe.slots.size()) {
+            // A removal may shift a later entry into slot i, so look again
+            if (stripe.slots[i].hash != 0 && stripe.slots[i].key == socket) {
+                remove_slot(stripe, i);
+                removed++;
+            } else {
+                i++;
+            }
+        }
+    }
+    return removed;
+}
+
+// Backward-shift deletion: pull later entries of the probe run into the
+// hole unless that would move them before their home slot
+void ClientRegistry::remove_slot(Stripe& stripe, size_t hole) {
+    size_t mask = stripe.slots.size() - 1;
+    size_t i = (hole + 1) & mask;
+    while (stripe.slots[i].hash != 0) {
+        size_t home = stripe.slots[i].hash & mask;
+        bool movable = hole <= i ? (home <= hole || home > i) : (home <= hole && home > i);
+        if (movable) {
+            stripe.slots[hole] = move(stripe.slots[i]);
+            hole = i;
+        }
+        i = (i + 1) & mask;
+    }
+
+    stripe.slots[hole] = Entry();
+    stripe.count--;
+}
+
+size_t ClientRegistry::size() {
+    size_t total = 0;
+    for (Stripe& stripe : stripes) {
+        lock_guard<mutex> lock(stripe.lock);
+        total += stripe.count;
+    }
+    return total;
+}
@@ -1,5 +1 @@
-struct Entry {
-    int key;
-    char value[100]; 
-};
-
+#include "../include/entry.h"
@@ -1,209 +1,293 @@
-#include <iostream>
+#include <charconv>
+#include <cstdio>
 #include <cstring>
-#include <cstdlib>
-#include <ctime>
 #include <sys/socket.h>
-#include <map>
 #include "../include/joker.h"
-#include "../include/entry.h"
+#include "command.h"
+#include "logger.h"
+#include "metrics.h"
+#include "random.h"
 
 using namespace std;
 
-// Map to store client WebSocket IDs
-map<int, string> clientWebsocketIds;
+#define JOKER_LIST "Ask the Audience (S), 50:50 (Y)"
 
-Joker::Joker(int max_clients) {
+Joker::Joker(int max_clients) : registry(max_clients) {
     m = max_clients;
-    currentSize = 0;
-    
-    // Seed the random number generator for 50:50 lifeline
-    srand(time(nullptr));
 }
 
-void Joker::register_client(int client_socket, const char* value) {
-    if (currentSize < MAX_SIZE) {
-        map[currentSize].key = client_socket;
-        strncpy(map[currentSize].value, value, sizeof(map[currentSize].value) - 1);
-        map[currentSize].value[sizeof(map[currentSize].value) - 1] = '\0';
-        currentSize++;
-        
-        // Store the WebSocket ID in our map
-        clientWebsocketIds[client_socket] = string(value);
-        cout << "Client registered with socket: " << client_socket << " and WebSocket ID: " << value << endl;
-    } else {
-        cout << "Map is full! Cannot register more clients." << endl;
+// Registry key for a binary protocol client handle: its hex digits
+static string_view handle_key(uint64_t handle, char (&buffer)[16]) {
+    auto result = to_chars(buffer, buffer + sizeof(buffer), handle, 16);
+    return string_view(buffer, result.ptr - buffer);
+}
+
+// Registers a WebSocket client ID; registering a known ID again only
+// refreshes its socket so repeated requests do not grow the table. Binary
+// requests carry only the ID's handle, so text ones are keyed by it too and
+// a player is one entry whichever protocol its game host speaks.
+void Joker::register_client(int client_socket, string_view client_id) {
+    register_handle(client_socket, JokerWire::client_handle(client_id));
+}
+
+void Joker::register_handle(int client_socket, uint64_t handle) {
+    char buffer[16];
+    string_view key = handle_key(handle, buffer);
+    if (registry.insert(key, client_socket)) {
+        LOG_DEBUG("Client registered with socket: %d and handle: %.*s", client_socket, (int)key.size(), key.data());
     }
 }
 
-string Joker::get_audience_results(int question_index) {
-    // For each question, provide different audience poll percentages
-    string results;
-    
-    switch (question_index) {
-        case 0: // Python year question
-            results = "A:40%,B:25%,C:30%,D:5%";
-            break;
-        case 1: // C++ year question
-            results = "A:45%,B:35%,C:15%,D:5%";
-            break;
-        case 2: // HTML question
-            results = "A:10%,B:60%,C:25%,D:5%";
-            break;
-        case 3: // TCP question
-            results = "A:55%,B:20%,C:15%,D:10%";
-            break;
-        case 4: // Client-server question
-            results = "A:15%,B:65%,C:10%,D:10%";
-            break;
-        default:
-            results = "A:25%,B:25%,C:25%,D:25%";
+bool Joker::unregister_client(string_view client_id) {
+    return unregister_handle(JokerWire::client_handle(client_id));
+}
+
+bool Joker::unregister_handle(uint64_t handle) {
+    char buffer[16];
+    return registry.erase(handle_key(handle, buffer));
+}
+
+// Polls come from the question bank's audience engine; without a bank
+// every option gets an even share
+void Joker::set_question_bank(const QuestionBank& bank) {
+    audience.store(make_shared<AudienceEngine>(bank));
+}
+
+// Audience poll percentages for A, B, C and D
+void Joker::audience_percentages(uint32_t question_id, uint8_t percentages[4]) {
+    const shared_ptr<AudienceEngine>& engine = audience.load();
+    if (engine != nullptr) {
+        engine->poll(question_id, percentages);
+    } else {
+        memset(percentages, 25, 4);
     }
-    
+}
+
+string Joker::get_audience_results(uint32_t question_id) {
+    uint8_t percentages[4];
+    audience_percentages(question_id, percentages);
+
+    char results[32];
+    snprintf(results, sizeof(results), "A:%u%%,B:%u%%,C:%u%%,D:%u%%",
+             percentages[0], percentages[1], percentages[2], percentages[3]);
     return results;
 }
 
-string Joker::get_fifty_fifty_options(int question_index, char correct_answer) {
+// Folds in how players answered a question
+void Joker::record_answers(uint32_t question_id, const uint32_t answers[4]) {
+    static Counter* recorded = metrics().counter("joker_service_answers_recorded_total", "Player answers folded into audience polls");
+    const shared_ptr<AudienceEngine>& engine = audience.load();
+    if (engine != nullptr) {
+        engine->record_answers(question_id, answers);
+    }
+    recorded->add(static_cast<uint64_t>(answers[0]) + answers[1] + answers[2] + answers[3]);
+}
+
+// Randomly selects the incorrect answer kept next to the correct one
+char Joker::fifty_fifty_partner(char correct_answer) {
     char options[4] = {'A', 'B', 'C', 'D'};
-    string result = "";
-    
-    // Always include the correct answer
-    result += correct_answer;
-    
-    // Randomly select one incorrect answer to keep
     char second_option;
     do {
-        int random_index = rand() % 4;
+        int random_index = thread_random().below(4);
         second_option = options[random_index];
     } while (second_option == correct_answer);
-    
-    result += "," + string(1, second_option);
+    return second_option;
+}
+
+string Joker::get_fifty_fifty_options(char correct_answer) {
+    // Always include the correct answer
+    string result(1, correct_answer);
+    result += ',';
+    result += fifty_fifty_partner(correct_answer);
     return result;
 }
 
-void Joker::process_request(const string& request, int client_socket) {
-    cout << "Processing request: " << request << " from socket: " << client_socket << endl;
-    
-    // Parse the request string based on the protocol format: ACTION-DATA
-    size_t delimiter_pos = request.find('-');
-    
-    if (delimiter_pos == string::npos) {
-        cout << "Invalid request format: " << request << endl;
-        string error_response = "ERROR-Invalid request format";
-        send(client_socket, error_response.c_str(), error_response.length(), 0);
-        return;
-    }
-    
-    string action = request.substr(0, delimiter_pos);
-    string data = request.substr(delimiter_pos + 1);
-    
-    cout << "Action: " << action << ", Data: " << data << endl;
-    
-    // Check if the request includes a WebSocket client ID
-    size_t client_id_pos = data.find(':');
-    string client_id = "";
-    
-    if (client_id_pos != string::npos) {
-        client_id = data.substr(0, client_id_pos);
-        data = data.substr(client_id_pos + 1);
-        cout << "WebSocket Client ID: " << client_id << ", Actual data: " << data << endl;
-    }
-    
-    if (action == "REGISTER") {
-        register_client(client_socket, data.c_str());
-        
-        // Confirm registration
-        string response = "REGISTERED-" + string(data);
-        send(client_socket, response.c_str(), response.length(), 0);
-    } 
-    else if (action == "AUDIENCE") {
-        // Format: AUDIENCE-question_index or AUDIENCE-clientId:question_index
-        int question_index;
-        
-        if (client_id.empty()) {
-            question_index = stoi(data);
-        } else {
-            question_index = stoi(data);
+void Joker::process_message(const JokerWire::Header& request, string_view payload, int client_socket, string& out) {
+    LOG_TRACE("Processing binary request type %d for client %016llx from socket: %d",
+              static_cast<int>(request.type), static_cast<unsigned long long>(request.client), client_socket);
+
+    // Replies echo the request ID and client handle
+    JokerWire::Header reply;
+    reply.request_id = request.request_id;
+    reply.client = request.client;
+
+    // As in the text protocol, lifelines register their client implicitly
+    if (request.client != 0 && (request.type == JokerWire::Type::AUDIENCE || request.type == JokerWire::Type::FIFTY_FIFTY)) {
+        register_handle(client_socket, request.client);
+    }
+
+    switch (request.type) {
+    case JokerWire::Type::REGISTER:
+        register_handle(client_socket, request.client);
+        reply.type = JokerWire::Type::REGISTERED;
+        JokerWire::encode(out, reply);
+        break;
+
+    case JokerWire::Type::AUDIENCE: {
+        uint8_t percentages[4];
+        audience_percentages(request.question, percentages);
+        reply.type = JokerWire::Type::AUDIENCE_RESULT;
+        reply.question = request.question;
+        JokerWire::encode(out, reply, string_view(reinterpret_cast<const char*>(percentages), 4));
+        break;
+    }
+
+    case JokerWire::Type::FIFTY_FIFTY: {
+        char correct_answer = static_cast<char>(request.arg);
+        if (correct_answer < 'A' || correct_answer > 'D') {
+            reply.type = JokerWire::Type::ERROR;
+            JokerWire::encode(out, reply, "Invalid FIFTY_FIFTY request format");
+            break;
         }
-        
-        string result = get_audience_results(question_index);
-        
-        // Send the result back to the client, including client ID if provided
-        string response;
-        if (client_id.empty()) {
-            response = "AUDIENCE_RESULT-" + result;
-        } else {
-            response = "AUDIENCE_RESULT-" + client_id + ":" + result;
+        char options[2] = {correct_answer, fifty_fifty_partner(correct_answer)};
+        reply.type = JokerWire::Type::FIFTY_FIFTY_RESULT;
+        reply.question = request.question;
+        JokerWire::encode(out, reply, string_view(options, 2));
+        break;
+    }
+
+    case JokerWire::Type::GET_JOKERS:
+        reply.type = JokerWire::Type::AVAILABLE_JOKERS;
+        JokerWire::encode(out, reply, JOKER_LIST);
+        break;
+
+    case JokerWire::Type::DISCONNECT:
+        if (unregister_handle(request.client)) {
+            LOG_DEBUG("Client %016llx disconnected and removed from registry", static_cast<unsigned long long>(request.client));
         }
-        
-        send(client_socket, response.c_str(), response.length(), 0);
-        cout << "Sent audience results: " << response << endl;
-    } 
-    else if (action == "FIFTY_FIFTY") {
-        // Format: FIFTY_FIFTY-question_index,correct_answer or FIFTY_FIFTY-clientId:question_index,correct_answer
-        string payload = data;
-        size_t comma_pos = payload.find(',');
-        
-        if (comma_pos == string::npos) {
-            cout << "Invalid FIFTY_FIFTY request format" << endl;
-            string error_response = "ERROR-Invalid FIFTY_FIFTY request format";
-            send(client_socket, error_response.c_str(), error_response.length(), 0);
-            return;
+        break;
+
+    case JokerWire::Type::ANSWER_STATS: {
+        // Four little-endian uint32 counts; no reply
+        if (payload.size() != 4 * sizeof(uint32_t)) {
+            LOG_WARN("Invalid ANSWER_STATS message for question %u", request.question);
+            break;
         }
-        
-        int question_index = stoi(payload.substr(0, comma_pos));
-        char correct_answer = payload.substr(comma_pos + 1)[0];
-        
-        string result = get_fifty_fifty_options(question_index, correct_answer);
-        
-        // Send the result back to the client, including client ID if provided
-        string response;
-        if (client_id.empty()) {
-            response = "FIFTY_FIFTY_RESULT-" + result;
-        } else {
-            response = "FIFTY_FIFTY_RESULT-" + client_id + ":" + result;
+        uint32_t answers[4];
+        for (int i = 0; i < 4; i++) {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(payload.data()) + 4 * i;
+            answers[i] = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
         }
-        
-        send(client_socket, response.c_str(), response.length(), 0);
-        cout << "Sent fifty-fifty results: " << response << endl;
+        record_answers(request.question, answers);
+        break;
     }
-    else if (action == "GET_JOKERS") {
-        // Return the available jokers
-        string available_jokers = "Ask the Audience (S), 50:50 (Y)";
-        
-        // Send the result back to the client, including client ID if provided
-        string response;
-        if (client_id.empty()) {
-            response = "AVAILABLE_JOKERS-" + available_jokers;
-        } else {
-            response = "AVAILABLE_JOKERS-" + client_id + ":" + available_jokers;
+
+    default:
+        LOG_WARN("Unknown binary request type: %d", static_cast<int>(request.type));
+        reply.type = JokerWire::Type::ERROR;
+        JokerWire::encode(out, reply, "Unknown request type");
+        break;
+    }
+}
+
+// Handles one request and returns the response line (empty if none is due)
+string Joker::process_request(string_view line, int client_socket) {
+    LOG_TRACE("Processing request: %.*s from socket: %d", (int)line.size(), line.data(), client_socket);
+
+    // Parse the request string based on the protocol format: ACTION-[clientId:]DATA
+    JokerRequest request;
+    if (!parse_joker_request(line, request)) {
+        LOG_WARN("Invalid request format: %.*s", (int)line.size(), line.data());
+        return "ERROR-Invalid request format";
+    }
+    string_view client_id = request.client_id;
+    string_view data = request.data;
+
+    LOG_TRACE("Action: %.*s, Client ID: %.*s, Data: %.*s", (int)request.name.size(), request.name.data(),
+              (int)client_id.size(), client_id.data(), (int)data.size(), data.data());
+
+    // Lifeline requests carry the client ID, which registers it implicitly so
+    // game_host does not need a separate REGISTER round trip first
+    if (!client_id.empty() && (request.action == JokerAction::AUDIENCE || request.action == JokerAction::FIFTY_FIFTY)) {
+        register_client(client_socket, client_id);
+    }
+
+    // Results echo the client ID when the request carried one
+    auto reply = [&](const char* action, const string& result) {
+        string response = action;
+        response += '-';
+        if (!client_id.empty()) {
+            response.append(client_id);
+            response += ':';
         }
-        
-        send(client_socket, response.c_str(), response.length(), 0);
-        cout << "Sent available jokers: " << response << endl;
-    } 
-    else if (action == "DISCONNECT") {
-        // Client is disconnecting, remove from our maps
-        for (int i = 0; i < currentSize; i++) {
-            if (map[i].key == client_socket) {
-                // Remove by shifting remaining entries
-                for (int j = i; j < currentSize - 1; j++) {
-                    map[j] = map[j+1];
-                }
-                currentSize--;
-                break;
-            }
+        response += result;
+        return response;
+    };
+
+    switch (request.action) {
+    case JokerAction::REGISTER:
+        register_client(client_socket, data);
+
+        // Confirm registration
+        return "REGISTERED-" + string(data);
+
+    case JokerAction::AUDIENCE: {
+        // Format: AUDIENCE-question_id or AUDIENCE-clientId:question_id
+        uint32_t question_id;
+        if (!parse_number(data, question_id)) {
+            LOG_WARN("Invalid AUDIENCE request format");
+            return "ERROR-Invalid AUDIENCE request format";
         }
-        
-        // Remove from WebSocket ID map
-        clientWebsocketIds.erase(client_socket);
-        cout << "Client disconnected and removed from maps" << endl;
+
+        string response = reply("AUDIENCE_RESULT", get_audience_results(question_id));
+        LOG_TRACE("Sent audience results: %s", response.c_str());
+        return response;
     }
-    else {
-        cout << "Unknown action: " << action << endl;
-        string error_response = "ERROR-Unknown action: " + action;
-        send(client_socket, error_response.c_str(), error_response.length(), 0);
+
+    case JokerAction::FIFTY_FIFTY: {
+        // Format: FIFTY_FIFTY-question_index,correct_answer or FIFTY_FIFTY-clientId:question_index,correct_answer
+        size_t comma_pos = data.find(',');
+        int question_index;
+        if (comma_pos == string_view::npos || comma_pos + 1 >= data.size() ||
+            !parse_number(data.substr(0, comma_pos), question_index)) {
+            LOG_WARN("Invalid FIFTY_FIFTY request format");
+            return "ERROR-Invalid FIFTY_FIFTY request format";
+        }
+        char correct_answer = data[comma_pos + 1];
+
+        string response = reply("FIFTY_FIFTY_RESULT", get_fifty_fifty_options(correct_answer));
+        LOG_TRACE("Sent fifty-fifty results: %s", response.c_str());
+        return response;
     }
-}
 
+    case JokerAction::GET_JOKERS: {
+        // Return the available jokers
+        string response = reply("AVAILABLE_JOKERS", JOKER_LIST);
+        LOG_TRACE("Sent available jokers: %s", response.c_str());
+        return response;
+    }
 
+    case JokerAction::ANSWER_STATS: {
+        // Format: ANSWER_STATS-question_id,a,b,c,d (no reply)
+        uint32_t fields[5];
+        int parsed = 0;
+        while (parsed < 5) {
+            size_t comma = data.find(',');
+            if (!parse_number(data.substr(0, comma), fields[parsed])) {
+                break;
+            }
+            parsed++;
+            data = comma == string_view::npos ? string_view() : data.substr(comma + 1);
+        }
+        if (parsed != 5 || !data.empty()) {
+            LOG_WARN("Invalid ANSWER_STATS request format");
+            return "ERROR-Invalid ANSWER_STATS request format";
+        }
+        record_answers(fields[0], fields + 1);
+        return "";
+    }
 
+    case JokerAction::DISCONNECT: {
+        // Format: DISCONNECT-clientId or DISCONNECT-clientId:anything
+        string_view id = client_id.empty() ? data : client_id;
+        if (unregister_client(id)) {
+            LOG_DEBUG("Client %.*s disconnected and removed from registry", (int)id.size(), id.data());
+        }
+        return "";
+    }
+
+    default:
+        LOG_WARN("Unknown action: %.*s", (int)request.name.size(), request.name.data());
+        return "ERROR-Unknown action: " + string(request.name);
+    }
+}
@@ -6,9 +6,25 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <unistd.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <thread>
 #include <map>
+#include <memory>
+#include <set>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include "../include/joker.h"
+#include "command.h"
+#include "frame_buffer.h"
+#include "joker_wire.h"
+#include "logger.h"
+#include "metrics.h"
+#include "uring.h"
 
 using namespace std;
 
@@ -17,6 +33,40 @@ Joker* jokerService = nullptr;
 
 // Map to track game server client sockets and their associated WebSocket client IDs
 map<int, string> clientConnections;
+mutex clientConnectionsMutex;
+
+// Open game_host connections
+atomic<int> gameHostConnections{0};
+set<int> gameHostSockets;
+mutex gameHostSocketsMutex;
+
+// First line on every game_host connection
+#define WELCOME_MESSAGE "Connected to Joker Server. Ready to process lifeline requests.\n"
+
+// io_uring mode: ring size, and the receive buffers game_host requests are
+// read into
+#define URING_ENTRIES 64
+#define URING_BUFFERS 64
+#define URING_BUFFER_SIZE 4096
+
+// Time to handle one request, per action
+static Histogram* request_latency(JokerAction action) {
+    static Histogram* const* const table = [] {
+        static const char* const help = "Time to handle one game_host request";
+        Histogram* other = metrics().histogram("joker_service_request_duration_seconds", help, "action=\"OTHER\"");
+        Histogram** entries = new Histogram*[static_cast<int>(JokerAction::COUNT)];
+        for (int i = 0; i < static_cast<int>(JokerAction::COUNT); i++) {
+            entries[i] = other;
+        }
+        for (JokerAction timed : {JokerAction::AUDIENCE, JokerAction::FIFTY_FIFTY, JokerAction::GET_JOKERS, JokerAction::REGISTER,
+                                  JokerAction::ANSWER_STATS}) {
+            entries[static_cast<int>(timed)] = metrics().histogram(
+                "joker_service_request_duration_seconds", help, string("action=\"") + joker_action_name(timed) + "\"");
+        }
+        return entries;
+    }();
+    return table[static_cast<int>(action)];
+}
 
 Server::Server(int port) {
     p = port;
@@ -26,6 +76,11 @@ Server::Server(int port) {
         exit(EXIT_FAILURE);
     }
 
+    // A restarted service binds while the old one still drains
+    int opt = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
     address.sin_port = htons(p);
@@ -34,10 +89,28 @@ Server::Server(int port) {
         perror("Bind failed");
         exit(EXIT_FAILURE);
     }
+
+    if ((stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        perror("eventfd failed");
+        exit(EXIT_FAILURE);
+    }
 }
 
 void Server::setJokerService(Joker* joker) {
     jokerService = joker;
+    metrics().gauge("joker_service_clients_registered", "Player IDs in the client registry", [joker] {
+        return static_cast<double>(joker->client_count());
+    });
+}
+
+static Counter* connections_accepted() {
+    static Counter* accepted = [] {
+        metrics().gauge("joker_service_game_hosts_connected", "Open game_host connections", [] {
+            return static_cast<double>(gameHostConnections.load());
+        });
+        return metrics().counter("joker_service_connections_accepted_total", "game_host connections accepted");
+    }();
+    return accepted;
 }
 
 void Server::start() {
@@ -47,92 +120,584 @@ void Server::start() {
         exit(EXIT_FAILURE);
     }
 
-    cout << "Joker Server waiting for connections on port " << p << "...\n";
+    Counter* accepted = connections_accepted();
+
+    LOG_INFO("Joker Server waiting for connections on port %d...", p);
+    struct pollfd fds[2] = {{server_fd, POLLIN, 0}, {stop_fd, POLLIN, 0}};
     while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno != EINTR) {
+                perror("poll failed");
+            }
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+
         if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen)) < 0) {
-            perror("Accept failed");
-            exit(EXIT_FAILURE);
+            if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN) {
+                // Out of descriptors or memory: retry shortly, the open
+                // connections keep being served
+                perror("Accept failed");
+                this_thread::sleep_for(chrono::milliseconds(100));
+            }
+            continue;
         }
         
-        cout << "Connection established with a game host!\n";
+        accepted->add();
+        LOG_INFO("Connection established with a game host!");
 
+        {
+            lock_guard<mutex> lock(gameHostSocketsMutex);
+            gameHostSockets.insert(new_socket);
+        }
         thread(&Server::handle_client, this, new_socket).detach(); 
     }
+    close(server_fd);
+    LOG_INFO("Stopped accepting game host connections");
+
+    // game_host keeps its connections open, so past the deadline their
+    // reads are shut down: whatever was received is still answered
+    while (gameHostConnections > 0 && chrono::steady_clock::now().time_since_epoch().count() < drain_deadline.load()) {
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    {
+        lock_guard<mutex> lock(gameHostSocketsMutex);
+        for (int sock : gameHostSockets) {
+            shutdown(sock, SHUT_RD);
+        }
+    }
+    auto grace = chrono::steady_clock::now() + chrono::seconds(1);
+    while (gameHostConnections > 0 && chrono::steady_clock::now() < grace) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
 }
 
-// Helper function to parse client ID from requests
-pair<string, string> parseCommand(const string& cmd) {
-    // Format: ACTION-[clientId:]DATA
-    size_t dashPos = cmd.find('-');
-    if (dashPos == string::npos) {
-        return make_pair("", "");
-    }
-    
-    string action = cmd.substr(0, dashPos);
-    string data = cmd.substr(dashPos + 1);
-    
-    // Check if there's a client ID in the data
-    size_t colonPos = data.find(':');
-    string clientId = "";
-    
-    if (colonPos != string::npos) {
-        clientId = data.substr(0, colonPos);
-        data = data.substr(colonPos + 1);
-        return make_pair(action, clientId);
-    }
-    
-    return make_pair(action, "");
+void Server::stop(chrono::seconds drain_timeout) {
+    if (stopping.exchange(true)) {
+        return;
+    }
+    drain_deadline = (chrono::steady_clock::now() + drain_timeout).time_since_epoch().count();
+
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) < 0) {
+        perror("Stop notification failed");
+    }
 }
 
-void Server::handle_client(int client_socket) {
-    char buffer[1024] = {0};
-    string welcome_msg = "Connected to Joker Server. Ready to process lifeline requests.\n";
-    send(client_socket, welcome_msg.c_str(), welcome_msg.length(), 0);
+// Queues a response line, echoing the caller's request ID when it sent one.
+// Everything answered from one recv goes out in a single send.
+static void append_response(string& out, string_view request_id, const string& response) {
+    if (!request_id.empty()) {
+        out.append(request_id);
+        out += '|';
+    }
+    out += response;
+    out += '\n';
+}
 
-    while (true) {
-        memset(buffer, 0, sizeof(buffer));
-        int bytes_read = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
-        
-        if (bytes_read <= 0) {
-            // Connection closed or error
-            cout << "Client disconnected." << endl;
-            
-            // Remove from connections map if present
-            clientConnections.erase(client_socket);
-            break;
+// Metrics label for a binary request
+static JokerAction message_action(JokerWire::Type type) {
+    switch (type) {
+    case JokerWire::Type::REGISTER: return JokerAction::REGISTER;
+    case JokerWire::Type::AUDIENCE: return JokerAction::AUDIENCE;
+    case JokerWire::Type::FIFTY_FIFTY: return JokerAction::FIFTY_FIFTY;
+    case JokerWire::Type::GET_JOKERS: return JokerAction::GET_JOKERS;
+    case JokerWire::Type::DISCONNECT: return JokerAction::DISCONNECT;
+    case JokerWire::Type::ANSWER_STATS: return JokerAction::ANSWER_STATS;
+    default: return JokerAction::UNKNOWN;
+    }
+}
+
+// Handles one request, or every request of a BATCH, appending the replies
+static bool process_message(const JokerWire::Header& header, string_view payload, int client_socket, string& out) {
+    if (header.type != JokerWire::Type::BATCH) {
+        Histogram::Timer timer(request_latency(message_action(header.type)));
+        jokerService->process_message(header, payload, client_socket, out);
+        return true;
+    }
+
+    static Counter* batched = metrics().counter("joker_service_batched_requests_total", "Requests that arrived in a BATCH");
+    string replies;
+    JokerWire::Header request;
+    string_view data;
+    while (!payload.empty()) {
+        int consumed = JokerWire::decode(payload, request, data);
+        if (consumed <= 0 || request.type == JokerWire::Type::BATCH) {
+            return false;
         }
-        
-        string request(buffer);
-        cout << "Received request: " << request << endl;
-        
+        Histogram::Timer timer(request_latency(message_action(request.type)));
+        jokerService->process_message(request, data, client_socket, replies);
+        batched->add();
+        payload.remove_prefix(consumed);
+    }
+    JokerWire::encode_batches(out, JokerWire::Type::BATCH_RESULT, replies);
+    return true;
+}
+
+// Handles every complete binary message in the buffer, appending the
+// replies. Returns false if the stream is corrupt.
+static bool process_messages(FrameBuffer& in, int client_socket, string& out) {
+    JokerWire::Header header;
+    string_view payload;
+    int consumed;
+
+    while ((consumed = JokerWire::decode(in.peek(), header, payload)) > 0) {
+        if (!process_message(header, payload, client_socket, out)) {
+            return false;
+        }
+        in.consume(consumed);
+    }
+    return consumed == 0;
+}
+
+// Handles every complete request in the buffer, text lines until a HELLO
+// switches the connection to binary messages, appending the replies so
+// everything answered from one read goes out in a single send. Returns
+// false if the stream is corrupt and the connection should be closed.
+static bool process_input(FrameBuffer& in, bool& binary, int client_socket, string& out) {
+    string_view frame;
+    while (!binary && in.next_frame(frame)) {
+        // Split off the optional request ID
+        string_view request_id;
+        size_t bar = frame.find('|');
+        if (bar != string_view::npos && frame.find('-') > bar) {
+            request_id = frame.substr(0, bar);
+            frame.remove_prefix(bar + 1);
+        }
+
+        LOG_TRACE("Received request: %.*s", (int)frame.size(), frame.data());
+
+        JokerRequest request;
+        parse_joker_request(frame, request);
+
+        if (request.action == JokerAction::HELLO) {
+            // Agree on the binary protocol if we speak the offered
+            // version; "HELLO-0" keeps the connection on text
+            int version = 0;
+            if (!parse_number(request.data, version) || version != JokerWire::VERSION || jokerService == nullptr) {
+                version = 0;
+            }
+            append_response(out, request_id, "HELLO-" + to_string(version));
+            binary = version != 0;
+            if (binary) {
+                LOG_INFO("Game host switched to binary protocol version %d", version);
+            }
+            continue;
+        }
+
+        Histogram::Timer timer(request_latency(request.action));
+
         // Check if this is a registration request with a WebSocket client ID
-        auto [action, clientId] = parseCommand(request);
-        
-        if (action == "REGISTER" && !clientId.empty()) {
+        if (request.action == JokerAction::REGISTER && !request.client_id.empty()) {
+            string clientId(request.client_id);
+
             // Store the client socket and WebSocket ID association
-            clientConnections[client_socket] = clientId;
-            cout << "Registered connection from game server for WebSocket client: " << clientId << endl;
-            
+            {
+                lock_guard<mutex> lock(clientConnectionsMutex);
+                clientConnections[client_socket] = clientId;
+            }
+            LOG_DEBUG("Registered connection from game server for WebSocket client: %s", clientId.c_str());
+
             // Also register with the joker service
             if (jokerService != nullptr) {
-                jokerService->register_client(client_socket, clientId.c_str());
+                jokerService->register_client(client_socket, clientId);
             }
-            
+
             // Send confirmation
-            string response = "REGISTERED-" + clientId;
-            send(client_socket, response.c_str(), response.length(), 0);
+            append_response(out, request_id, "REGISTERED-" + clientId);
             continue;
         }
-        
+
         // Process the request using the joker service
         if (jokerService != nullptr) {
-            jokerService->process_request(request, client_socket);
+            string response = jokerService->process_request(frame, client_socket);
+            if (!response.empty()) {
+                append_response(out, request_id, response);
+            }
         } else {
-            cout << "Error: Joker service not initialized!" << endl;
-            string error_msg = "ERROR-Joker service not available";
-            send(client_socket, error_msg.c_str(), error_msg.length(), 0);
+            LOG_ERROR("Joker service not initialized!");
+            append_response(out, request_id, "ERROR-Joker service not available");
         }
     }
-    
+
+    if (binary && !process_messages(in, client_socket, out)) {
+        LOG_WARN("Corrupt binary message from game host, closing connection");
+        return false;
+    }
+    return true;
+}
+
+// Drops a closed connection from the registries, with any players still
+// registered through it
+static void forget_client(int client_socket) {
+    if (jokerService != nullptr) {
+        size_t players = jokerService->forget_socket(client_socket);
+        if (players > 0) {
+            LOG_DEBUG("Dropped %zu client(s) of closed connection %d from registry", players, client_socket);
+        }
+    }
+    {
+        lock_guard<mutex> lock(clientConnectionsMutex);
+        clientConnections.erase(client_socket);
+    }
+    {
+        lock_guard<mutex> lock(gameHostSocketsMutex);
+        gameHostSockets.erase(client_socket);
+    }
+    gameHostConnections--;
+}
+
+void Server::handle_client(int client_socket) {
+    string welcome_msg = WELCOME_MESSAGE;
+    send(client_socket, welcome_msg.c_str(), welcome_msg.length(), 0);
+    gameHostConnections++;
+
+    // Requests are newline framed and may be pipelined: "<id>|ACTION-DATA\n",
+    // until a HELLO switches the connection to binary messages
+    FrameBuffer in(4096);
+    string out;
+    bool binary = false;
+
+    while (true) {
+        int bytes_read = recv(client_socket, in.write_ptr(), in.writable(), 0);
+        
+        if (bytes_read <= 0 || in.overflowed()) {
+            // Connection closed or error
+            LOG_INFO("Game host disconnected.");
+            break;
+        }
+        in.commit(bytes_read);
+
+        bool open = process_input(in, binary, client_socket, out);
+        if (!out.empty()) {
+            send(client_socket, out.data(), out.size(), MSG_NOSIGNAL);
+            out.clear();
+        }
+        if (!open) {
+            break;
+        }
+    }
+
+    forget_client(client_socket);
     close(client_socket);
 }
+
+// io_uring mode: one game_host connection. Replies collect in out while a
+// batch of completions is handled and go out as one send, at most one in
+// flight (sending); the socket is closed once no request refers to it.
+struct UringConnection {
+    FrameBuffer in{4096};
+    bool binary = false;
+    bool closing = false;           // close once the replies are sent
+    bool closed = false;
+    bool queued = false;            // on the list to flush
+    int ops = 0;                    // requests in flight on the socket
+    string out;
+    string sending;
+};
+
+// What a completion belongs to, with the socket (IoUring::tag)
+enum : uint32_t {
+    OP_ACCEPT = 1,
+    OP_ACCEPT_RETRY,
+    OP_RECV,
+    OP_SEND,
+    OP_STOP,
+    OP_CANCEL,
+    OP_TICK,
+};
+
+// While draining, how often the loop wakes up to check the deadline; also
+// the pause before re-arming an accept that failed
+static const __kernel_timespec TICK = {0, 50 * 1000 * 1000};
+
+struct UringLoop {
+    IoUring ring;
+    BufferRing buffers;
+    unordered_map<int, unique_ptr<UringConnection>> connections;
+    vector<int> dirty;              // sockets with replies to send
+
+    void arm_recv(int fd, UringConnection& connection) {
+        ring.prep_recv_multishot(fd, buffers.id(), IoUring::tag(OP_RECV, fd));
+        connection.ops++;
+    }
+
+    void queue_send(int fd, UringConnection& connection) {
+        if (!connection.queued) {
+            connection.queued = true;
+            dirty.push_back(fd);
+        }
+    }
+
+    void add(int fd) {
+        connections_accepted()->add();
+        LOG_INFO("Connection established with a game host!");
+        {
+            lock_guard<mutex> lock(gameHostSocketsMutex);
+            gameHostSockets.insert(fd);
+        }
+        gameHostConnections++;
+
+        auto connection = make_unique<UringConnection>();
+        connection->out = WELCOME_MESSAGE;
+        arm_recv(fd, *connection);
+        queue_send(fd, *connection);
+        connections[fd] = move(connection);
+    }
+
+    // Closes the socket now if nothing is in flight on it, otherwise shuts
+    // it down so the requests complete and the last one closes it
+    void close_connection(int fd, UringConnection& connection) {
+        if (connection.closed) {
+            return;
+        }
+        connection.closed = true;
+        forget_client(fd);
+        if (connection.ops == 0) {
+            close(fd);
+            connections.erase(fd);
+            return;
+        }
+        shutdown(fd, SHUT_RDWR);
+    }
+
+    // A request on a closed connection finished
+    void release(int fd, UringConnection& connection) {
+        if (connection.ops == 0) {
+            close(fd);
+            connections.erase(fd);
+        }
+    }
+
+    // Like thread mode: what was answered still goes out before the close
+    void finish(int fd, UringConnection& connection) {
+        if (connection.out.empty() && connection.sending.empty()) {
+            close_connection(fd, connection);
+        } else {
+            connection.closing = true;
+        }
+    }
+
+    void read(int fd, int result, uint32_t flags) {
+        auto it = connections.find(fd);
+        if (it == connections.end()) {
+            return;
+        }
+        UringConnection& connection = *it->second;
+        bool more = flags & IORING_CQE_F_MORE;
+        if (!more) {
+            connection.ops--;
+        }
+
+        bool open = true;
+        if (result > 0) {
+            uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+            const char* data = buffers.buffer(bid);
+            size_t left = result;
+            while (open && left > 0 && !connection.closing && !connection.closed) {
+                size_t n = min(left, connection.in.writable());
+                if (n == 0) {
+                    LOG_INFO("Game host disconnected.");
+                    open = false;
+                    break;
+                }
+                memcpy(connection.in.write_ptr(), data, n);
+                connection.in.commit(n);
+                data += n;
+                left -= n;
+                open = process_input(connection.in, connection.binary, fd, connection.out);
+            }
+            buffers.recycle(bid);
+        }
+
+        if (connection.closed) {
+            release(fd, connection);
+            return;
+        }
+        if (result == -ENOBUFS) {
+            arm_recv(fd, connection);
+            return;
+        }
+        if (result <= 0) {
+            LOG_INFO("Game host disconnected.");
+            open = false;
+        }
+        if (!connection.out.empty()) {
+            queue_send(fd, connection);
+        }
+        if (!open) {
+            finish(fd, connection);
+        } else if (!more && !connection.closing) {
+            arm_recv(fd, connection);
+        }
+    }
+
+    void sent(int fd, int result) {
+        auto it = connections.find(fd);
+        if (it == connections.end()) {
+            return;
+        }
+        UringConnection& connection = *it->second;
+        connection.ops--;
+
+        if (connection.closed) {
+            release(fd, connection);
+            return;
+        }
+        if (result < 0) {
+            close_connection(fd, connection);
+            return;
+        }
+        if (static_cast<size_t>(result) < connection.sending.size()) {
+            connection.sending.erase(0, result);
+            ring.prep_send(fd, connection.sending.data(), connection.sending.size(), IoUring::tag(OP_SEND, fd));
+            connection.ops++;
+            return;
+        }
+
+        connection.sending.clear();
+        if (!connection.out.empty()) {
+            queue_send(fd, connection);
+        } else if (connection.closing) {
+            close_connection(fd, connection);
+        }
+    }
+
+    // Turns the replies queued since the last submission into sends
+    void flush() {
+        for (int fd : dirty) {
+            auto it = connections.find(fd);
+            if (it == connections.end()) {
+                continue;
+            }
+            UringConnection& connection = *it->second;
+            connection.queued = false;
+            if (connection.closed || !connection.sending.empty() || connection.out.empty()) {
+                continue;
+            }
+            connection.sending.swap(connection.out);
+            ring.prep_send(fd, connection.sending.data(), connection.sending.size(), IoUring::tag(OP_SEND, fd));
+            connection.ops++;
+        }
+        dirty.clear();
+    }
+};
+
+void Server::start_uring() {
+    UringLoop loop;
+    string error;
+    if (!loop.ring.init(URING_ENTRIES, error) ||
+        !loop.buffers.init(loop.ring, 0, URING_BUFFERS, URING_BUFFER_SIZE, error)) {
+        LOG_WARN("io_uring unavailable (%s), using a thread per connection", error.c_str());
+        start();
+        return;
+    }
+
+    if (listen(server_fd, SOMAXCONN) < 0) {
+        perror("Listen failed");
+        exit(EXIT_FAILURE);
+    }
+    // Only for the accept4() calls that empty the queue on stop
+    if (fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL, 0) | O_NONBLOCK) < 0) {
+        perror("Nonblocking listen socket failed");
+        exit(EXIT_FAILURE);
+    }
+    connections_accepted();
+
+    LOG_INFO("Joker Server waiting for connections on port %d (io_uring)...", p);
+    loop.ring.prep_accept_multishot(server_fd, IoUring::tag(OP_ACCEPT, server_fd));
+    loop.ring.prep_poll(stop_fd, POLLIN, IoUring::tag(OP_STOP, 0));
+
+    bool accepting = true;
+    bool draining = false;
+    bool cut_off = false;
+    chrono::steady_clock::time_point grace;
+
+    while (true) {
+        loop.flush();
+
+        if (draining && !accepting) {
+            if (loop.connections.empty()) {
+                break;
+            }
+            // Same drain as thread mode: reads are shut down at the deadline
+            // and connections get a second to answer what they received
+            if (!cut_off && chrono::steady_clock::now().time_since_epoch().count() >= drain_deadline.load()) {
+                for (auto& entry : loop.connections) {
+                    if (!entry.second->closed) {
+                        shutdown(entry.first, SHUT_RD);
+                    }
+                }
+                cut_off = true;
+                grace = chrono::steady_clock::now() + chrono::seconds(1);
+            } else if (cut_off && chrono::steady_clock::now() >= grace) {
+                break;
+            }
+        }
+
+        int result = loop.ring.submit_and_wait(1);
+        if (result < 0 && result != -EBUSY && result != -EAGAIN) {
+            errno = -result;
+            perror("io_uring_enter failed");
+            break;
+        }
+
+        while (io_uring_cqe* entry = loop.ring.peek()) {
+            io_uring_cqe cqe = *entry;
+            loop.ring.advance();
+            uint32_t op = IoUring::tag_op(cqe.user_data);
+            int fd = IoUring::tag_fd(cqe.user_data);
+
+            switch (op) {
+            case OP_ACCEPT:
+                if (cqe.res >= 0) {
+                    loop.add(cqe.res);
+                } else if (cqe.res != -ECANCELED) {
+                    LOG_WARN("Accept failed: %s", strerror(-cqe.res));
+                }
+                if (cqe.flags & IORING_CQE_F_MORE) {
+                    break;
+                }
+                if (!draining) {
+                    // Out of descriptors or memory: retry shortly, the open
+                    // connections keep being served
+                    loop.ring.prep_timeout(&TICK, IoUring::tag(OP_ACCEPT_RETRY, fd));
+                    break;
+                }
+                // The accept was cancelled by stop()
+                [[fallthrough]];
+            case OP_ACCEPT_RETRY:
+                if (draining) {
+                    int client;
+                    while ((client = accept4(server_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                        loop.add(client);
+                    }
+                    close(server_fd);
+                    accepting = false;
+                    LOG_INFO("Stopped accepting game host connections");
+                } else {
+                    loop.ring.prep_accept_multishot(server_fd, IoUring::tag(OP_ACCEPT, server_fd));
+                }
+                break;
+            case OP_STOP:
+                draining = true;
+                loop.ring.prep_cancel(IoUring::tag(OP_ACCEPT, server_fd), IoUring::tag(OP_CANCEL, 0));
+                loop.ring.prep_timeout(&TICK, IoUring::tag(OP_TICK, 0));
+                break;
+            case OP_TICK:
+                loop.ring.prep_timeout(&TICK, IoUring::tag(OP_TICK, 0));
+                break;
+            case OP_RECV:
+                loop.read(fd, cqe.res, cqe.flags);
+                break;
+            case OP_SEND:
+                loop.sent(fd, cqe.res);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef ANSWER_STATS_H
+#define ANSWER_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "metrics.h"
+#include "question_bank.h"
+
+class Joker;
+
+// How players answer each question. Every ANSWER is counted in the shard
+// of the CPU recording it (MetricShards::current()), so answer volume does
+// not contend on shared cache lines. A merge thread sums the shards
+// periodically into an immutable snapshot that readers load without
+// locking, and forwards what changed since the previous merge to
+// joker_service as ANSWER_STATS so audience polls follow real play. A
+// reloaded bank gets a new AnswerStats.
+//
+// Shard counters are 32 bits and only ever grow; the merge thread takes
+// wrapping differences, which stay exact as long as no question gets 2^32
+// answers in one shard between two merges.
+class AnswerStats {
+public:
+    static constexpr int OPTIONS = QuestionBank::OPTIONS;
+
+    struct Snapshot {
+        std::vector<std::array<uint64_t, OPTIONS>> answers;    // by question ID
+        uint64_t total = 0;
+        uint64_t merges = 0;
+    };
+
+private:
+    struct Row {
+        std::atomic<uint32_t> answers[OPTIONS] = {};
+    };
+    // Rows packed four to a cache line; each shard's rows start on a line
+    // of their own
+    static constexpr size_t ROWS_PER_BLOCK = 64 / sizeof(Row);
+    struct alignas(64) Block {
+        Row rows[ROWS_PER_BLOCK];
+    };
+
+    std::shared_ptr<const QuestionBank> bank;
+    size_t count;
+    size_t blocks_per_shard;
+    std::unique_ptr<Block[]> blocks;    // SHARDS x blocks_per_shard
+
+    std::vector<std::array<uint32_t, OPTIONS>> merged;     // shard sums at the last merge
+    std::shared_ptr<const Snapshot> current;
+
+    std::mutex merger_mutex;
+    std::condition_variable merger_wakeup;
+    bool running = false;
+    std::thread merger;
+
+    Row& row(int shard, uint32_t question_id) const {
+        return blocks[shard * blocks_per_shard + question_id / ROWS_PER_BLOCK].rows[question_id % ROWS_PER_BLOCK];
+    }
+    void merge_loop(Joker* joker, std::chrono::milliseconds interval);
+
+public:
+    explicit AnswerStats(std::shared_ptr<const QuestionBank> bank);
+    ~AnswerStats();
+    AnswerStats(const AnswerStats&) = delete;
+    AnswerStats& operator=(const AnswerStats&) = delete;
+
+    // True if question IDs of this bank are the ones being counted
+    bool counts(const QuestionBank* questions) const { return questions == bank.get(); }
+
+    // Counts one answer (choice 0..3 for A..D); unknown IDs are ignored
+    void record(uint32_t question_id, int choice) {
+        if (question_id < count && choice >= 0 && choice < OPTIONS) {
+            row(MetricShards::current(), question_id).answers[choice].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Sums the shards into a new snapshot and returns the per-question
+    // changes since the previous merge (only questions that changed).
+    // Called by the merge thread; safe to call directly when none runs.
+    std::vector<std::pair<uint32_t, std::array<uint32_t, OPTIONS>>> merge();
+
+    // Latest merged totals; never null
+    std::shared_ptr<const Snapshot> snapshot() const { return std::atomic_load(&current); }
+
+    // Merges every interval on a background thread, sending the changes to
+    // joker (if not null) as ANSWER_STATS
+    void start_merging(Joker* joker, std::chrono::milliseconds interval);
+    void stop_merging();
+
+    // "question_id,tier,correct,A,B,C,D,correct_rate" CSV of the snapshot
+    std::string render_csv() const;
+};
+
+#endif
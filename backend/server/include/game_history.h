@@ -0,0 +1,54 @@
+#ifndef GAME_HISTORY_H
+#define GAME_HISTORY_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "question_bank.h"
+
+// The ladders of each player's last few games, by client ID, so a new deal
+// can avoid questions the player has just seen. Kept by the server rather
+// than the Session, which ends with its game: a player's next game arrives
+// on a new connection (or a new multiplexed Session). Shared by every
+// connection thread and reactor worker; keys are hashed onto independently
+// locked shards, each holding at most CAPACITY / SHARDS players and
+// evicting the least recently dealt one beyond that.
+class GameHistory {
+public:
+    static constexpr int RECENT_GAMES = 4;
+    static constexpr size_t CAPACITY = 1 << 16;
+
+    struct Recent {
+        uint32_t ladders[RECENT_GAMES][QuestionBank::TIERS] = {};
+        int games = 0;                  // dealt so far; the ring holds the last RECENT_GAMES
+    };
+
+private:
+    static constexpr size_t SHARDS = 64;
+
+    struct Player {
+        std::string clientId;
+        Recent recent;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex lock;
+        std::list<Player> players;      // most recently dealt first
+        std::unordered_map<std::string, std::list<Player>::iterator> index;
+    };
+
+    Shard shards[SHARDS];
+
+    Shard& shard_for(const std::string& clientId);
+
+public:
+    // The player's recent ladders; games == 0 for a player not seen lately
+    Recent find(const std::string& clientId);
+    // Adds a dealt ladder to the player's history
+    void record(const std::string& clientId, const uint32_t ladder[QuestionBank::TIERS]);
+    size_t size();
+};
+
+#endif
@@ -1,25 +1,182 @@
-#ifndef JOKER_H 
+#ifndef JOKER_H
 #define JOKER_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include <netinet/in.h> // Add this include for sockaddr_in
+#include "command.h"
+#include "frame_buffer.h"
+#include "joker_wire.h"
 
+// Thread-safe client for joker_service. Requests are spread over a small
+// pool of connections and tagged with a request ID, so any number of
+// lifeline calls can be in flight on one socket; a reader thread per
+// connection matches each response to its caller. Concurrent requests on a
+// connection are queued and written together. Every connection offers
+// the binary protocol (joker_wire.h) when it opens and stays on
+// "<id>|ACTION-DATA\n" text lines if the service does not accept it.
+// Event loops use submit_async(), which leaves connecting, the batch
+// window and the write to a writer thread.
 class Joker {
+public:
+    // One joker_service request, independent of the wire format
+    struct Request {
+        JokerAction action = JokerAction::UNKNOWN;
+        std::string_view client_id;     // only read while submit() runs
+        int question_id = 0;
+        char correct_answer = 0;        // FIFTY_FIFTY
+        uint32_t answers[4] = {};       // ANSWER_STATS: new answers per option
+    };
+
+    // Called exactly once with the reply as text ready to use (display text
+    // for lifelines, the joker list for GET_JOKERS, "REGISTERED"), or with
+    // ok == false if the connection failed or the reply was not the
+    // expected one. DISCONNECT and ANSWER_STATS get no reply and succeed
+    // once queued.
+    using Callback = std::function<void(bool ok, const std::string& response)>;
+
 private:
-    int p; 
+    // A response as received: a text line without its ID, or a binary
+    // header with its payload in text
+    struct Reply {
+        const JokerWire::Header* header = nullptr;
+        std::string_view text;
+    };
+    using ReplyHandler = std::function<void(bool ok, const Reply& reply)>;
+
+    // An asynchronous request no connection could take at once, for the
+    // writer thread to send once it has opened one
+    struct Deferred {
+        uint32_t id;
+        Request request;
+        std::string client_id;      // request.client_id points here
+        ReplyHandler handler;
+    };
+
+    struct Connection {
+        int sock = -1;
+        bool binary = false;        // negotiated in open()
+        std::atomic<bool> connected{false};
+        std::mutex connect_mutex;   // serializes (re)connects
+        std::mutex write_mutex;     // held by the submitter flushing the queue
+        std::mutex queue_mutex;
+        std::string outbox;         // encoded requests waiting to be written
+        std::vector<uint32_t> queued;   // their IDs
+        bool flushing = false;      // a submitter is writing the queue out
+        std::mutex pending_mutex;
+        std::unordered_map<uint32_t, ReplyHandler> pending;
+        std::thread reader;
+    };
+
+    int p;
     std::string h;
-    int sock = 0;
     struct sockaddr_in serv_addr;
-    
+    bool offer_binary = true;
+    std::chrono::microseconds batch_window{0};
+    std::vector<std::unique_ptr<Connection>> pool;
+    std::atomic<uint32_t> next_id{1};
+    std::atomic<uint32_t> next_connection{0};
+    std::atomic<uint64_t> saved_round_trips{0};
+    std::atomic<uint64_t> generation{0};    // bumped on every (re)connect
+
+    std::mutex jokers_mutex;
+    std::shared_ptr<const std::string> jokers_cache;
+    uint64_t jokers_generation = 0;
+    bool jokers_refreshing = false;
+
+    std::thread writer;
+    std::mutex writer_mutex;
+    std::condition_variable writer_wakeup;
+    std::vector<Connection*> to_flush;      // queues an async submitter left
+    std::vector<Deferred> deferred;
+    bool writer_stopping = false;
+
+    bool open(Connection& conn);
+    void read_responses(Connection* conn, int sock, bool binary, FrameBuffer in);
+    void deliver(Connection& conn, uint32_t id, const Reply& reply);
+    void deliver_batch(Connection& conn, std::string_view replies);
+    void flush(Connection& conn);
+    void fail_requests(Connection& conn, const std::vector<uint32_t>& ids);
+    void fail_pending(Connection& conn);
+    uint32_t submit_request(const Request& request, Callback callback, bool async);
+    uint32_t send_request(const Request& request, ReplyHandler handler, bool async);
+    bool dispatch(uint32_t id, const Request& request, const ReplyHandler& handler, bool async);
+    void run_writer();
+    std::future<std::string> submit(const Request& request, uint32_t& id);
+    std::string call(const Request& request, const std::string& fallback);
+    static bool render_reply(JokerAction action, std::string_view clientId, const Reply& reply, std::string& text);
+
 public:
-    bool is_connected = false;
-    Joker(std::string host, int port);
+    std::atomic<bool> is_connected{false};
+    Joker(std::string host, int port, int pool_size = 4);
+    ~Joker();
+
+    // Offer the binary protocol on new connections (default); off keeps
+    // every connection on text
+    void use_binary_protocol(bool enabled) { offer_binary = enabled; }
+
+    // How long the submitter that starts a write waits for concurrent
+    // lifelines to join it (default 0: only requests queued while the
+    // previous write was in progress share a write)
+    void set_batch_window(std::chrono::microseconds window) { batch_window = window; }
     bool connect();
-    std::string request_audience_help(int question_index, const std::string& clientId = "");
-    std::string request_fifty_fifty(int question_index, char correct_answer, const std::string& clientId = "");
+
+    // Asynchronous interface: the callback runs on a pool reader thread
+    void submit(const Request& request, Callback callback);
+    std::future<std::string> submit(const Request& request);
+    // Never blocks: the request is queued on an open connection and written
+    // by the writer thread, which also opens a connection first if none is.
+    // Returns the request ID for cancel().
+    uint32_t submit_async(const Request& request, Callback callback);
+    // Forgets a request that is still waiting for its reply; its callback
+    // never runs
+    void cancel(uint32_t id);
+
+    // Queues requests that get no reply (DISCONNECT, ANSWER_STATS) on one
+    // connection so they go out together; false if none could be opened
+    bool post(const std::vector<Request>& requests);
+
+    // A lifeline request for callers that submit() it themselves. It carries
+    // the client ID, which registers the player on the joker side.
+    Request lifeline_request(JokerAction action, int question_id, char correct_answer, std::string_view clientId);
+    // Forwarded to the player when a lifeline got no reply
+    static const char LIFELINE_FAILED[];
+
+    // Blocking helpers returning text ready to forward to the player
+    std::string request_audience_help(int question_id, const std::string& clientId = "");
+    std::string request_fifty_fifty(int question_id, char correct_answer, const std::string& clientId = "");
     std::string get_available_jokers(const std::string& clientId = "");
+
+    // Joker list fetched by connect() and shared by every game, refreshed in
+    // the background after a reconnect; never blocks. nullptr while the
+    // service is unreachable.
+    std::shared_ptr<const std::string> cached_jokers();
     bool register_client(const std::string& clientId);
     void close_connection();
+
+    // Lifelines that registered their client implicitly instead of paying a
+    // separate REGISTER round trip
+    uint64_t registrations_saved() const { return saved_round_trips; }
+
+    // Request encoders and response formatters for both wire formats
+    static std::string audience_request(int question_id, std::string_view clientId);
+    static std::string fifty_fifty_request(int question_id, char correct_answer, std::string_view clientId);
+    static std::string text_request(const Request& request);
+    static void encode_request(std::string& out, uint32_t id, const Request& request);
+    static std::string format_audience_result(const std::string& response);
+    static std::string format_fifty_fifty_result(const std::string& response);
+    static std::string format_audience_percentages(const uint8_t percentages[4]);
 };
 
 #endif
@@ -0,0 +1,30 @@
+#ifndef PAYLOAD_CACHE_H
+#define PAYLOAD_CACHE_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "question_bank.h"
+
+// Protocol text for every question in a bank, rendered once when the bank is
+// loaded: "QUESTION:t:<t+1>. text\nOPTIONS:t:A) ..|B) ..|C) ..|D) ..\n",
+// where t is the question's tier and therefore its rung on the ladder. START
+// and REQUEST replies are assembled from these fragments with writev, so no
+// reply text is built per game. A reloaded bank gets a new cache.
+class PayloadCache {
+private:
+    std::shared_ptr<const QuestionBank> questions;
+    std::string blob;                 // all fragments back to back
+    std::vector<uint32_t> offsets;    // fragment i is blob[offsets[i], offsets[i + 1])
+
+public:
+    explicit PayloadCache(std::shared_ptr<const QuestionBank> bank);
+
+    const std::shared_ptr<const QuestionBank>& bank() const { return questions; }
+    std::string_view question(uint32_t id) const {
+        return std::string_view(blob.data() + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+};
+
+#endif
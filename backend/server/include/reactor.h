@@ -0,0 +1,63 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "resume_queue.h"
+#include "session.h"
+#include "timer_wheel.h"
+
+class Server;
+
+// epoll based event loop server. Each worker owns an epoll instance and the
+// sessions it accepted, so a session is only ever touched by one thread.
+// After Server::stop() each worker closes its listener and runs until its
+// sessions have finished or the drain deadline passes. The WebSocket
+// listener, if any, is shared by all workers like the main one without
+// SO_REUSEPORT.
+class Reactor {
+private:
+    struct Worker {
+        int id = 0;
+        int epfd = -1;
+        int listen_fd = -1;
+        std::thread thread;
+        TimerWheel timers;              // every session's timeouts
+        std::unordered_map<int, std::shared_ptr<Session>> sessions;
+        std::shared_ptr<ResumeQueue> resumes;   // lifelines answered
+    };
+
+    Server* server;
+    int port;
+    int server_fd;
+    int ws_fd;
+    bool reuse_port;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<int> shared_listeners{0};    // workers waiting on server_fd
+    std::atomic<int> ws_listeners{0};        // workers waiting on ws_fd
+
+    void run_worker(Worker& worker);
+    void accept_clients(Worker& worker, int listen_fd, bool websocket);
+    void read_client(Worker& worker, Session& session);
+    void close_client(Worker& worker, int fd);
+    void resumed(Worker& worker, Session& session);
+    void expired(Worker& worker, Timer& timer);
+    void stop_accepting(Worker& worker);
+    void notify_carriers(Worker& worker);
+
+public:
+    Reactor(Server* server, int port, int server_fd, int ws_fd, int worker_count, bool reuse_port);
+    void run();
+
+    // Opens an extra SO_REUSEPORT listener on port, or returns -1
+    static int open_listener(int port);
+
+    // Writes as much of the pending output as the socket accepts without
+    // blocking and arms EPOLLOUT for the rest. Returns false on socket error.
+    static bool flush(Session& session);
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef RESUME_QUEUE_H
+#define RESUME_QUEUE_H
+
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+#include "session.h"
+
+// Coroutines to continue on an event loop's thread. A coroutine that
+// suspends on a worker (a lifeline waiting for joker_service) is posted
+// back by whichever thread completes its wait; the worker watches fd(), an
+// eventfd, and resumes everything posted with run(). Shared, so a late
+// post after the worker has exited still lands somewhere valid; close()
+// then destroys the coroutines that will never run.
+class ResumeQueue {
+public:
+    struct Entry {
+        std::coroutine_handle<> handle;
+        std::shared_ptr<Session> connection;    // the socket it works for
+    };
+
+private:
+    std::mutex entries_mutex;
+    std::vector<Entry> entries;
+    std::unordered_set<void*> waiting;      // suspended, not yet posted
+    bool closed = false;
+    int event_fd;
+
+public:
+    ResumeQueue();
+    ~ResumeQueue();
+    ResumeQueue(const ResumeQueue&) = delete;
+    ResumeQueue& operator=(const ResumeQueue&) = delete;
+
+    int fd() const { return event_fd; }
+    // A coroutine suspending on this loop, to be posted later
+    void suspend(std::coroutine_handle<> handle);
+    // Safe from any thread; ignored once the queue is closed
+    void post(std::coroutine_handle<> handle, std::shared_ptr<Session> connection);
+    // Resumes every coroutine posted so far, then calls resumed with its
+    // connection so the loop can act on what it did (close it, say)
+    void run(const std::function<void(Session&)>& resumed);
+    // The worker has exited: destroys every coroutine suspended or posted
+    // and not yet resumed. Call once the worker's thread is done.
+    void close();
+
+    // The queue of the event loop running on this thread; null in thread
+    // mode, where lifelines block instead
+    static thread_local std::shared_ptr<ResumeQueue> current;
+};
+
+#endif
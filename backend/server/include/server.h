@@ -1,22 +1,146 @@
 #ifndef SERVER_H 
 #define SERVER_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <netinet/in.h>
+#include <sys/uio.h>
+#include "answer_stats.h"
+#include "command.h"
 #include "joker.h"
+#include "metrics.h"
+#include "session.h"
+#include "game_history.h"
+#include "session_registry.h"
+#include "task.h"
+#include "websocket.h"
 
 class Server {
 private:
     int p;  
     int server_fd, new_socket;
     struct sockaddr_in address;
+    int ws_port = 0;
+    int ws_fd = -1;                 // WebSocket listener, if enabled
+
+    // Timeouts in milliseconds, 0 for none
+    uint64_t idle_timeout_ms = 0;
+    uint64_t register_timeout_ms = 0;
+    uint64_t answer_timeout_ms = 0;
+
+    void accept_connection(int listen_fd, bool websocket);
     
 public:
+    // Every registered player, by WebSocket client ID
+    SessionRegistry sessions;
+    // Recent ladders of every player seen lately, avoided by new deals
+    GameHistory history;
+
+    Counter* connections_accepted;
+    Counter* accept_errors;
+
+    // Set by stop(); stop_fd turns readable at the same time so blocked
+    // accept loops and reactor workers wake up
+    std::atomic<bool> stopping{false};
+    int stop_fd;
+    std::atomic<std::chrono::steady_clock::rep> drain_deadline{0};
+    std::atomic<int> active_connections{0};     // thread mode
+    std::atomic<int> websocket_connections{0};  // upgraded, still open
+    bool past_drain_deadline() const {
+        return std::chrono::steady_clock::now().time_since_epoch().count() >= drain_deadline.load();
+    }
+
     Server(int port);
     void setJokerClient(Joker* joker);
+    // Answers from here on are counted in stats if they are to questions of
+    // its bank (null stops counting)
+    void setAnswerStats(AnswerStats* stats);
+    // Games started from here on use bank; games in progress keep theirs
+    void setQuestionBank(std::shared_ptr<const QuestionBank> bank);
+    // How long a connection may take to send its first command, a player
+    // may stay silent, and a question may go unanswered; zero disables one.
+    // Call before starting the server.
+    void setTimeouts(std::chrono::seconds idle, std::chrono::seconds registration, std::chrono::seconds answer);
+    // Also serve browsers directly over WebSocket on port; call before
+    // starting the server
+    void listen_websocket(int port);
+    // All three block until the server has stopped and drained;
+    // start_uring() falls back to start_reactor() on kernels without
+    // io_uring support
     void start();
-    void handle_client(int client_socket);
-    std::string process_audience_joker(int question_index, const std::string& clientId = "");
-    std::string process_fifty_fifty_joker(int question_index, std::string correct_answer, const std::string& clientId = "");
+    void start_reactor(int workers, bool reuse_port);
+    void start_uring(int workers, bool reuse_port);
+    // Stops accepting connections and lets open games finish for up to
+    // drain_timeout before they are cut off; safe from any thread
+    void stop(std::chrono::seconds drain_timeout);
+    void wait_for_drain();
+    void handle_client(int client_socket, bool websocket = false);
+
+    // Handles one frame from a connection. "MUX:<name>" as a connection's
+    // first frame makes it a carrier for any number of players: every later
+    // frame is routed by its client ID to that player's Session, created on
+    // first use, and every reply goes out as "MSG:<clientId>:<length>\n"
+    // followed by length bytes of the usual reply text. The handshake is
+    // answered with "MUX_READY\n"; "CLOSED:<clientId>\n" says a player's
+    // game ended, and "GOAWAY\n" that the server is draining and new players
+    // belong on a new connection. A carrier already holding MAX_MUX_PLAYERS
+    // answers a new player with an ERROR message and CLOSED. Returns false
+    // once the connection should be closed.
+    bool handle_frame(Session& session, std::string_view frame);
+    // Event loops: handles whatever complete frames (or WebSocket data) the
+    // session's input buffer holds, setting closing once the session should
+    // end after its output drains. Returns false if it must be dropped now.
+    bool handle_input(Session& session);
+    bool handle_command(Session& session, std::string_view cmd, const Command& command);
+    bool handle_mux_frame(Session& carrier, std::string_view frame, const Command& command);
+    // Tells a carrier about stop(); false if it has no players left and
+    // can be closed
+    bool notify_stopping(Session& session);
+    void handle_disconnect(Session& session);
+    // A player's session is over: it leaves the registry, and joker_service
+    // is told to forget it if a lifeline registered it there
+    void end_session(Session& session);
+
+    // Timeouts, on the session's TimerWheel: touch() re-arms the idle (or,
+    // before the first command, registration) timer when a session is heard
+    // from, start_countdown() arms the answer timer for the current
+    // question. handle_timeout() ends the session or game whose timer
+    // expired and returns false if its connection should close; a player's
+    // carrier stays open and the player is dropped from it.
+    void touch(Session& session);
+    void start_countdown(Session& session);
+    bool handle_timeout(Session& session, Timer& timer);
+    // Disarms a closing session's timers, and its players' on a carrier
+    static void cancel_timers(Session& session);
+
+    // Consumes the upgrade request or complete frames from a WebSocket
+    // connection's buffer, handling every line of each text message as a
+    // frame; answers pings and CLOSE. Returns false once the connection
+    // should be closed (a CLOSE frame to the browser is already queued).
+    bool handle_websocket(Session& session);
+    bool handle_websocket_frame(Session& session, const WebSocket::Frame& frame);
+    void close_websocket(Session& session, uint16_t code);
+    void send_message(Session& session, std::string_view msg);
+    void send_buffers(Session& session, const struct iovec* buffers, int count);
+    // Writes bytes to the session's socket as they are, without the MUX or
+    // WebSocket framing send_message adds
+    void send_raw(Session& session, std::string_view bytes);
+    // Event loops: asks joker_service for a lifeline and sends the reply
+    // without blocking the loop, then runs the commands deferred meanwhile
+    DetachedTask run_lifeline(std::shared_ptr<Session> owner, JokerAction action, int question_id, char correct_answer);
+    void run_deferred(Session& session);
+    void deal_questions(Session& session, uint64_t seed, const GameHistory::Recent* recent);
+    std::string process_audience_joker(int question_id, const std::string& clientId = "");
+    void start_game(Session& session, std::string_view payload);
+    // Connections waiting in a listen socket's accept queue, from TCP_INFO
+    static int accept_queue_length(int listen_fd);
+    static void export_accept_queue(int listen_fd, const std::string& labels);
+    // Closes a listener; its accept queue gauge reads 0 from then on rather
+    // than whatever socket reuses the descriptor
+    static void close_listener(int listen_fd);
+    std::string process_fifty_fifty_joker(int question_id, std::string correct_answer, const std::string& clientId = "");
 };
 
 #endif
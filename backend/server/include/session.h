@@ -0,0 +1,106 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "frame_buffer.h"
+#include "payload_cache.h"
+#include "question_bank.h"
+#include "timer_wheel.h"
+
+// A lifeline request an event loop is waiting on (Server::run_lifeline).
+// Its reply, from a Joker thread, and its timeout, on the loop, race to
+// claim it; the winner resumes the coroutine.
+struct LifelineWait {
+    std::atomic<bool> claimed{false};
+    bool timed_out = false;
+    uint32_t request_id = 0;            // for Joker::cancel
+    std::string text;                   // the reply, empty if it failed
+    std::coroutine_handle<> handle;
+};
+
+// Per-player game state. In thread mode a Session is owned by
+// handle_client; in reactor and io_uring mode by the event loop that
+// accepted the socket, which drives it one command at a time. Registered sessions are also
+// reachable by client ID through the SessionRegistry.
+//
+// A connection that opens with "MUX:<name>" carries many players instead
+// (see Server::handle_frame): its Session is only the carrier, holding the
+// socket and buffers, and owns one Session per client ID it has seen.
+// A browser connected to the WebSocket port is a Session of its own, like
+// a connection from the adapter.
+struct Session : std::enable_shared_from_this<Session> {
+    int socket = -1;
+    std::string clientId;
+    std::string registeredId;           // key in the session registry
+
+    bool registered = false;            // first command (CLIENT_ID) consumed
+    bool joker_used[3] = {false, false, false}; // [0] = Ask the Audience, [1] = 50:50, [2] = Skip
+    bool joker_registered = false;      // a lifeline told joker_service about it
+    int score = 0;
+    int current_question = 0;
+    bool game_over = false;
+
+    // Questions dealt for this game: ladder[i] is a question ID in tier i
+    std::shared_ptr<const QuestionBank> bank;
+    std::shared_ptr<const PayloadCache> payloads;
+    uint32_t ladder[QuestionBank::TIERS] = {};
+    uint64_t seed = 0;                  // "START:<id>:<seed>" replays this deal
+
+    // Bytes received but not yet consumed as complete commands
+    FrameBuffer in;
+
+    // Timeouts run on the wheel of the thread driving the session (a
+    // player's is its carrier's): the registration timeout, then the idle
+    // timeout, re-armed by each command; and the current question's
+    // countdown, if answers have a time limit (Server::handle_timeout)
+    TimerWheel* timers = nullptr;
+    Timer idle_timer;
+    Timer answer_timer;
+
+    // Event loops: a lifeline waits for joker_service in a coroutine
+    // (Server::run_lifeline) instead of blocking the loop. The player's
+    // commands received meanwhile wait in deferred, one per line, and run
+    // once its reply is sent; a reply for a closed connection is dropped.
+    // lifeline_timer gives up on the reply (Server::handle_timeout).
+    bool lifeline_pending = false;
+    std::shared_ptr<LifelineWait> lifeline;
+    Timer lifeline_timer;
+    std::string deferred;
+    bool closed = false;
+
+    // Reactor mode only: replies that could not be written without blocking
+    bool nonblocking = false;
+    int epfd = -1;
+    bool want_write = false;            // EPOLLOUT currently armed
+    bool closing = false;               // close once the output buffer drains
+    std::string out;
+
+    // io_uring mode: out is handed to the kernel as sending, one send in
+    // flight at a time; the socket is closed once no request refers to it
+    bool uring = false;
+    bool send_queued = false;           // on the worker's list to flush
+    uint32_t uring_ops = 0;             // requests in flight on the socket
+    std::string sending;
+
+    // Connections from the WebSocket listener speak HTTP until the upgrade,
+    // then carry the usual command lines in text messages (websocket.h)
+    bool websocket = false;
+    bool upgraded = false;
+    bool fragmented = false;            // a message's first fragment arrived
+    std::string message;                // fragments received so far
+
+    // Multiplexed connections: a carrier's players, keyed by a view of
+    // their clientId (which never changes for them), and a player's carrier
+    bool multiplexed = false;
+    bool goaway_sent = false;           // told the adapter to move new players on
+    std::unordered_map<std::string_view, std::shared_ptr<Session>> players;
+    Session* carrier = nullptr;
+};
+
+#endif
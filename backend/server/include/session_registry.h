@@ -0,0 +1,43 @@
+#ifndef SESSION_REGISTRY_H
+#define SESSION_REGISTRY_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "session.h"
+
+// Client ID -> live session, shared by every connection thread and reactor
+// worker. Keys are hashed onto independently locked shards so registrations
+// and disconnects on different shards never contend.
+class SessionRegistry {
+private:
+    static constexpr size_t SHARDS = 64;
+
+    struct alignas(64) Shard {
+        std::mutex lock;
+        std::unordered_map<std::string, std::shared_ptr<Session>> sessions;
+    };
+
+    Shard shards[SHARDS];
+
+    Shard& shard_for(const std::string& clientId);
+
+public:
+    // Registers a session, replacing any older session with the same ID
+    void insert(const std::string& clientId, std::shared_ptr<Session> session);
+    std::shared_ptr<Session> find(const std::string& clientId);
+
+    // Removes clientId only while it still maps to session, so a stale
+    // connection closing cannot evict the player's newer session
+    bool erase(const std::string& clientId, const Session* session);
+
+    // Visits every session, one shard lock at a time. The callback must not
+    // call back into the registry. Only socket and clientId are stable while
+    // the owning thread keeps playing; other fields are a best-effort view.
+    void for_each(const std::function<void(Session&)>& visit);
+    size_t size();
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef URING_REACTOR_H
+#define URING_REACTOR_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "resume_queue.h"
+#include "session.h"
+#include "timer_wheel.h"
+
+class Server;
+class IoUring;
+class BufferRing;
+
+// io_uring based event loop server, laid out like Reactor: each worker owns
+// a ring and the sessions it accepted. Listeners take connections through
+// one multishot accept, sockets read through one multishot recv into a ring
+// of provided buffers, and replies are queued during a batch of completions
+// and submitted together with the next wait, so a busy worker handles many
+// commands per io_uring_enter instead of a recv and a send each.
+class UringReactor {
+private:
+    struct Worker {
+        int id = 0;
+        int listen_fd = -1;
+        std::thread thread;
+        IoUring* ring = nullptr;
+        BufferRing* buffers = nullptr;
+        TimerWheel timers;              // every session's timeouts
+        std::unordered_map<int, std::shared_ptr<Session>> sessions;
+        // Closed sessions whose socket still has requests in flight
+        std::unordered_map<int, std::shared_ptr<Session>> closed;
+        std::vector<int> dirty;         // sockets with output to send
+        std::shared_ptr<ResumeQueue> resumes;   // lifelines answered
+        int listeners = 0;              // multishot accepts still armed
+        bool draining = false;
+    };
+
+    Server* server;
+    int port;
+    int server_fd;
+    int ws_fd;
+    bool reuse_port;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<int> shared_listeners{0};    // workers accepting on server_fd
+    std::atomic<int> ws_listeners{0};        // workers accepting on ws_fd
+
+    static thread_local Worker* current;
+
+    void run_worker(Worker& worker);
+    void handle_completion(Worker& worker, uint64_t tag, int result, uint32_t flags);
+    void add_client(Worker& worker, int fd, bool websocket);
+    void read_client(Worker& worker, Session& session, int result, uint32_t flags);
+    void sent(Worker& worker, Session& session, int result);
+    void flush(Worker& worker);
+    void close_client(Worker& worker, int fd);
+    void resumed(Worker& worker, Session& session);
+    void expired(Worker& worker, Timer& timer);
+    void release(Worker& worker, Session& session);
+    void stop_accepting(Worker& worker, int listen_fd);
+    void notify_carriers(Worker& worker);
+
+public:
+    UringReactor(Server* server, int port, int server_fd, int ws_fd, int worker_count, bool reuse_port);
+    // False with a reason if this kernel cannot run the loop (io_uring
+    // disabled, or no provided buffer rings before Linux 6.1)
+    static bool supported(std::string& error);
+    void run();
+
+    // Puts a session's pending output on its worker's list for the next
+    // submission; only called from the worker thread that owns it
+    static void queue_send(Session& session);
+};
+
+#endif
@@ -2,29 +2,243 @@
 #include "include/server.h"
 #include "include/joker.h"
 #include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#include "logger.h"
+#include "metrics.h"
+#include "random.h"
+#include "shutdown.h"
 
 using namespace std;
 
 #define SERVER_PORT 4337
 #define JOKER_PORT 4338
 #define JOKER_HOST "127.0.0.1"
+#define QUESTIONS_FILE "../data/questions.txt"
+#define ADMIN_PORT 9337     // Prometheus metrics, loopback only
+#define STATS_INTERVAL_MS 1000  // answer statistics merge period
+#define DRAIN_TIMEOUT_S 30      // how long games may finish after SIGTERM
+#define IDLE_TIMEOUT_S 300      // silence before a connection is closed
+#define REGISTER_TIMEOUT_S 10   // time to send the first command
+
+// What the signal thread acts on; it may outlive main(), so these do too
+static mutex lifecycle_mutex;
+static Server* running_server = nullptr;
+static function<void()> reload_questions;
+static long drain_timeout_s = DRAIN_TIMEOUT_S;
+
+// Answer counters, one per question bank loaded. Replaced ones stay
+// allocated until exit because connection threads may still count into them.
+static vector<unique_ptr<AnswerStats>> answer_stats;
+
+// Usage: game_host [--reactor[=WORKERS] | --uring[=WORKERS]] [--reuseport] [--questions=PATH] [--seed=N] [--log-level=LEVEL]
+//                 [--admin-port=PORT] [--joker-protocol=binary|text] [--joker-batch-window=US]
+//                 [--stats-interval=MS] [--drain-timeout=S] [--ws-port=PORT]
+//                 [--idle-timeout=S] [--register-timeout=S] [--answer-timeout=S]
+//   --reactor    serve all clients from epoll event loops instead of one
+//                thread per connection (WORKERS defaults to the core count)
+//   --uring      the same with io_uring instead of epoll: multishot accept
+//                and recv into provided buffers, replies submitted in
+//                batches (Linux 6.1 or later; falls back to --reactor)
+//   --reuseport  give every reactor worker its own SO_REUSEPORT listener
+//   --questions  question bank to load (default ../data/questions.txt)
+//   --seed       base seed for question draws, to reproduce a whole run
+//   --log-level  trace, debug, info (default), warn, error or off; overrides
+//                the LOG_LEVEL environment variable
+//   --admin-port serve Prometheus metrics on 127.0.0.1:PORT (default 9337,
+//                0 disables)
+//   --joker-protocol  binary (default) offers the compact binary protocol to
+//                joker_service and falls back to text if it is refused;
+//                text never offers it
+//   --stats-interval  milliseconds between merges of the per-question answer
+//                counters, which feed joker_service's audience polls and
+//                http://127.0.0.1:ADMIN_PORT/answer-stats (default 1000)
+//   --joker-batch-window  microseconds a lifeline request waits for others
+//                to share its write to joker_service (default 0: only
+//                requests that queue up behind a write in progress share one)
+//   --drain-timeout  seconds games in progress may take to finish once
+//                SIGINT or SIGTERM stops the server (default 30); a second
+//                signal exits at once
+//   --ws-port    also serve browsers directly over WebSocket on PORT,
+//                without the Socket.IO adapter (default 0: off). Each text
+//                message carries the adapter's command lines, starting with
+//                CLIENT_ID, and every reply comes back as one text message.
+//   --idle-timeout  seconds a player may stay silent before the server
+//                closes its session (default 300, 0 never)
+//   --register-timeout  seconds a new connection has to send its first
+//                command (default 10, 0 never)
+//   --answer-timeout  seconds allowed per question: a player who has not
+//                answered by then loses the game as with a wrong answer
+//                (default 0: no limit)
+//
+// SIGHUP reloads the question bank from the same path: new games are dealt
+// from the new bank while games in progress finish on the old one. The
+// listen socket uses SO_REUSEPORT, so a restart can start the new process
+// before stopping the old one and no connection is refused.
+int main(int argc, char* argv[]) {
+    // A signal before the server is up just exits
+    handle_signals([] {
+        {
+            lock_guard<mutex> lock(lifecycle_mutex);
+            if (running_server != nullptr) {
+                running_server->stop(chrono::seconds(drain_timeout_s));
+                return;
+            }
+        }
+        exit(0);
+    }, [] {
+        lock_guard<mutex> lock(lifecycle_mutex);
+        if (reload_questions) {
+            reload_questions();
+        }
+    });
+
+    const char* questions_file = QUESTIONS_FILE;
+    bool reactor = false;
+    bool uring = false;
+    bool reuse_port = false;
+    int workers = thread::hardware_concurrency();
+    LogLevel log_level;
+    int admin_port = ADMIN_PORT;
+    bool joker_binary = true;
+    long batch_window_us = 0;
+    long stats_interval_ms = STATS_INTERVAL_MS;
+    int ws_port = 0;
+    long idle_timeout_s = IDLE_TIMEOUT_S;
+    long register_timeout_s = REGISTER_TIMEOUT_S;
+    long answer_timeout_s = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--reactor") == 0) {
+            reactor = true;
+        } else if (strncmp(argv[i], "--reactor=", 10) == 0) {
+            reactor = true;
+            workers = atoi(argv[i] + 10);
+        } else if (strcmp(argv[i], "--uring") == 0) {
+            uring = true;
+        } else if (strncmp(argv[i], "--uring=", 8) == 0) {
+            uring = true;
+            workers = atoi(argv[i] + 8);
+        } else if (strcmp(argv[i], "--reuseport") == 0) {
+            reuse_port = true;
+        } else if (strncmp(argv[i], "--questions=", 12) == 0) {
+            questions_file = argv[i] + 12;
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            seed_thread_random(strtoull(argv[i] + 7, nullptr, 10));
+        } else if (strncmp(argv[i], "--admin-port=", 13) == 0) {
+            admin_port = atoi(argv[i] + 13);
+        } else if (strcmp(argv[i], "--joker-protocol=binary") == 0 || strcmp(argv[i], "--joker-protocol=text") == 0) {
+            joker_binary = strcmp(argv[i] + 17, "binary") == 0;
+        } else if (strncmp(argv[i], "--joker-batch-window=", 21) == 0) {
+            batch_window_us = atol(argv[i] + 21);
+        } else if (strncmp(argv[i], "--stats-interval=", 17) == 0) {
+            stats_interval_ms = atol(argv[i] + 17);
+        } else if (strncmp(argv[i], "--drain-timeout=", 16) == 0) {
+            drain_timeout_s = atol(argv[i] + 16);
+        } else if (strncmp(argv[i], "--ws-port=", 10) == 0) {
+            ws_port = atoi(argv[i] + 10);
+        } else if (strncmp(argv[i], "--idle-timeout=", 15) == 0) {
+            idle_timeout_s = atol(argv[i] + 15);
+        } else if (strncmp(argv[i], "--register-timeout=", 19) == 0) {
+            register_timeout_s = atol(argv[i] + 19);
+        } else if (strncmp(argv[i], "--answer-timeout=", 17) == 0) {
+            answer_timeout_s = atol(argv[i] + 17);
+        } else if (strncmp(argv[i], "--log-level=", 12) == 0 && Logger::parse_level(argv[i] + 12, log_level)) {
+            Logger::set_level(log_level);
+        } else {
+            cerr << "Unknown option: " << argv[i] << endl;
+            cerr << "Usage: " << argv[0] << " [--reactor[=WORKERS] | --uring[=WORKERS]] [--reuseport] [--questions=PATH] [--seed=N] [--log-level=LEVEL] [--admin-port=PORT] [--joker-protocol=binary|text] [--joker-batch-window=US] [--stats-interval=MS] [--drain-timeout=S] [--ws-port=PORT] [--idle-timeout=S] [--register-timeout=S] [--answer-timeout=S]" << endl;
+            return 1;
+        }
+    }
+
+    // Load the question bank shared by all games
+    string error;
+    shared_ptr<const QuestionBank> bank = QuestionBank::load(questions_file, error);
+    if (bank == nullptr) {
+        cerr << "Failed to load question bank: " << error << endl;
+        return 1;
+    }
+    LOG_INFO("Loaded %zu questions from %s", bank->size(), questions_file);
 
-int main() {
     // Create the joker client
     Joker* joker = new Joker(JOKER_HOST, JOKER_PORT);
+    joker->use_binary_protocol(joker_binary);
+    joker->set_batch_window(chrono::microseconds(batch_window_us));
     
     // Create the game server and set the joker client
     Server server(SERVER_PORT);
     server.setJokerClient(joker);
+    server.setQuestionBank(bank);
+    server.setTimeouts(chrono::seconds(idle_timeout_s), chrono::seconds(register_timeout_s),
+                       chrono::seconds(answer_timeout_s));
+    if (ws_port > 0) {
+        server.listen_websocket(ws_port);
+    }
+
+    // Answer counters, merged in the background and pushed to joker_service
+    chrono::milliseconds stats_interval(stats_interval_ms > 0 ? stats_interval_ms : STATS_INTERVAL_MS);
+    answer_stats.push_back(make_unique<AnswerStats>(bank));
+    answer_stats.back()->start_merging(joker, stats_interval);
+    server.setAnswerStats(answer_stats.back().get());
+    add_admin_page("/answer-stats", "text/csv", [] {
+        lock_guard<mutex> lock(lifecycle_mutex);
+        return answer_stats.back()->render_csv();
+    });
+
+    {
+        lock_guard<mutex> lock(lifecycle_mutex);
+        running_server = &server;
+        reload_questions = [&] {
+            static Counter* reloads = metrics().counter("game_host_question_bank_reloads_total", "Question banks reloaded on SIGHUP");
+            string error;
+            shared_ptr<const QuestionBank> next = QuestionBank::load(questions_file, error);
+            if (next == nullptr) {
+                LOG_ERROR("Reload failed, keeping the current question bank: %s", error.c_str());
+                return;
+            }
+
+            // The old counters get a final merge so their answers still
+            // reach joker_service
+            AnswerStats* previous = answer_stats.back().get();
+            answer_stats.push_back(make_unique<AnswerStats>(next));
+            answer_stats.back()->start_merging(joker, stats_interval);
+            server.setQuestionBank(next);
+            server.setAnswerStats(answer_stats.back().get());
+            previous->stop_merging();
+            reloads->add();
+            LOG_INFO("Reloaded %zu questions from %s", next->size(), questions_file);
+        };
+    }
     
-    cout << "Game Host server started on port " << SERVER_PORT << endl;
-    cout << "Will connect to Joker service on " << JOKER_HOST << ":" << JOKER_PORT << endl;
-    
-    // Start the server (this will block until the server is stopped)
-    server.start();
+    LOG_INFO("Game Host server started on port %d", SERVER_PORT);
+    LOG_INFO("Will connect to Joker service on %s:%d", JOKER_HOST, JOKER_PORT);
+    if (admin_port > 0) {
+        start_metrics_server(admin_port);
+    }
     
-    // Clean up (will never be reached in the current implementation)
+    // Start the server (this blocks until a signal stops it and the games
+    // in progress have drained)
+    if (uring) {
+        server.start_uring(workers, reuse_port);
+    } else if (reactor) {
+        server.start_reactor(workers, reuse_port);
+    } else {
+        server.start();
+    }
+
+    // Forward the last answers, then release joker_service
+    {
+        lock_guard<mutex> lock(lifecycle_mutex);
+        running_server = nullptr;
+        reload_questions = nullptr;
+        answer_stats.back()->stop_merging();
+    }
+    joker->close_connection();
     delete joker;
+    LOG_INFO("Game host stopped");
     
     return 0;
 }
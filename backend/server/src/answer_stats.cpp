@@ -0,0 +1,123 @@
+#include <cstdio>
+#include <cstring>
+#include "../include/answer_stats.h"
+#include "../include/joker.h"
+#include "logger.h"
+
+using namespace std;
+
+AnswerStats::AnswerStats(shared_ptr<const QuestionBank> bank) : bank(bank) {
+    count = bank->size();
+    blocks_per_shard = (count + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK;
+    blocks.reset(new Block[MetricShards::SHARDS * blocks_per_shard]);
+    merged.assign(count, {});
+
+    auto empty = make_shared<Snapshot>();
+    empty->answers.assign(count, {});
+    current = empty;
+}
+
+AnswerStats::~AnswerStats() {
+    stop_merging();
+}
+
+vector<pair<uint32_t, array<uint32_t, AnswerStats::OPTIONS>>> AnswerStats::merge() {
+    // Process-wide, so they keep counting across the instances a bank
+    // reload creates
+    static Counter* recorded = metrics().counter("game_host_answers_recorded_total", "Player answers counted for question statistics");
+    static Counter* merges = metrics().counter("game_host_answer_stats_merges_total", "Merges of the answer statistics shards");
+
+    shared_ptr<const Snapshot> previous = snapshot();
+    auto next = make_shared<Snapshot>(*previous);
+    next->merges++;
+
+    vector<pair<uint32_t, array<uint32_t, OPTIONS>>> changes;
+    for (uint32_t id = 0; id < count; id++) {
+        array<uint32_t, OPTIONS> sums = {};
+        for (int shard = 0; shard < MetricShards::SHARDS; shard++) {
+            const Row& shard_row = row(shard, id);
+            for (int i = 0; i < OPTIONS; i++) {
+                sums[i] += shard_row.answers[i].load(memory_order_relaxed);
+            }
+        }
+
+        array<uint32_t, OPTIONS> delta;
+        bool changed = false;
+        for (int i = 0; i < OPTIONS; i++) {
+            delta[i] = sums[i] - merged[id][i];     // wraps with the counters
+            next->answers[id][i] += delta[i];
+            next->total += delta[i];
+            changed = changed || delta[i] != 0;
+        }
+        merged[id] = sums;
+        if (changed) {
+            changes.emplace_back(id, delta);
+        }
+    }
+
+    recorded->add(next->total - previous->total);
+    merges->add();
+    atomic_store(&current, shared_ptr<const Snapshot>(move(next)));
+    return changes;
+}
+
+void AnswerStats::merge_loop(Joker* joker, chrono::milliseconds interval) {
+    unique_lock<mutex> lock(merger_mutex);
+    while (running) {
+        merger_wakeup.wait_for(lock, interval, [this] { return !running; });
+
+        // A final merge on shutdown still forwards the last answers
+        lock.unlock();
+        auto changes = merge();
+        if (joker != nullptr && joker->is_connected && !changes.empty()) {
+            vector<Joker::Request> requests(changes.size());
+            for (size_t i = 0; i < changes.size(); i++) {
+                requests[i].action = JokerAction::ANSWER_STATS;
+                requests[i].question_id = static_cast<int>(changes[i].first);
+                memcpy(requests[i].answers, changes[i].second.data(), sizeof(requests[i].answers));
+            }
+            joker->post(requests);
+        }
+        if (!changes.empty()) {
+            LOG_DEBUG("Merged answer statistics for %zu questions", changes.size());
+        }
+        lock.lock();
+    }
+}
+
+void AnswerStats::start_merging(Joker* joker, chrono::milliseconds interval) {
+    lock_guard<mutex> lock(merger_mutex);
+    if (running) {
+        return;
+    }
+    running = true;
+    merger = thread(&AnswerStats::merge_loop, this, joker, interval);
+}
+
+void AnswerStats::stop_merging() {
+    {
+        lock_guard<mutex> lock(merger_mutex);
+        running = false;
+    }
+    merger_wakeup.notify_all();
+    if (merger.joinable()) {
+        merger.join();
+    }
+}
+
+string AnswerStats::render_csv() const {
+    shared_ptr<const Snapshot> stats = snapshot();
+    string out = "question_id,tier,correct,A,B,C,D,correct_rate\n";
+    char line[160];
+    for (uint32_t id = 0; id < count; id++) {
+        const array<uint64_t, OPTIONS>& answers = stats->answers[id];
+        uint64_t total = answers[0] + answers[1] + answers[2] + answers[3];
+        int correct = bank->correct_answer(id) - 'A';
+        double rate = total > 0 && correct >= 0 && correct < OPTIONS ? static_cast<double>(answers[correct]) / total : 0;
+        snprintf(line, sizeof(line), "%u,%d,%c,%llu,%llu,%llu,%llu,%.3f\n", id, bank->tier(id), bank->correct_answer(id),
+                 static_cast<unsigned long long>(answers[0]), static_cast<unsigned long long>(answers[1]),
+                 static_cast<unsigned long long>(answers[2]), static_cast<unsigned long long>(answers[3]), rate);
+        out += line;
+    }
+    return out;
+}
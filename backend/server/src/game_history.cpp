@@ -0,0 +1,45 @@
+#include <cstring>
+#include "game_history.h"
+
+using namespace std;
+
+GameHistory::Shard& GameHistory::shard_for(const string& clientId) {
+    return shards[hash<string>()(clientId) % SHARDS];
+}
+
+GameHistory::Recent GameHistory::find(const string& clientId) {
+    Shard& shard = shard_for(clientId);
+    lock_guard<mutex> lock(shard.lock);
+    auto it = shard.index.find(clientId);
+    return it == shard.index.end() ? Recent() : it->second->recent;
+}
+
+void GameHistory::record(const string& clientId, const uint32_t ladder[QuestionBank::TIERS]) {
+    Shard& shard = shard_for(clientId);
+    lock_guard<mutex> lock(shard.lock);
+
+    auto it = shard.index.find(clientId);
+    if (it != shard.index.end()) {
+        shard.players.splice(shard.players.begin(), shard.players, it->second);
+    } else {
+        if (shard.players.size() >= CAPACITY / SHARDS) {
+            shard.index.erase(shard.players.back().clientId);
+            shard.players.pop_back();
+        }
+        shard.players.push_front(Player{clientId, Recent()});
+        shard.index.emplace(clientId, shard.players.begin());
+    }
+
+    Recent& recent = shard.players.front().recent;
+    memcpy(recent.ladders[recent.games % RECENT_GAMES], ladder, sizeof(recent.ladders[0]));
+    recent.games++;
+}
+
+size_t GameHistory::size() {
+    size_t total = 0;
+    for (Shard& shard : shards) {
+        lock_guard<mutex> lock(shard.lock);
+        total += shard.players.size();
+    }
+    return total;
+}
@@ -1,271 +1,912 @@
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 #include <unistd.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/time.h>
 #include "../include/joker.h"
+#include "frame_buffer.h"
+#include "logger.h"
+#include "metrics.h"
 
 using namespace std;
 
-Joker::Joker(string host, int port) {
+#define DEFAULT_JOKERS "Ask the Audience (S), 50:50 (Y)"
+#define RESPONSE_TIMEOUT chrono::seconds(2)
+#define HANDSHAKE_TIMEOUT_SECONDS 1
+#define NO_RESPONSE "ERROR: Failed to receive response from joker server\n"
+
+Joker::Joker(string host, int port, int pool_size) {
     p = port;
     h = host;
     is_connected = false;
 
-    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-        perror("Socket creation failed");
-        return;
-    }
-
+    memset(&serv_addr, 0, sizeof(serv_addr));
     serv_addr.sin_family = AF_INET;
     serv_addr.sin_port = htons(p);
 
     if (inet_pton(AF_INET, h.c_str(), &serv_addr.sin_addr) <= 0) {
         perror("Invalid address / Address not supported");
-        return;
     }
+
+    if (pool_size < 1) {
+        pool_size = 1;
+    }
+    for (int i = 0; i < pool_size; i++) {
+        pool.push_back(make_unique<Connection>());
+    }
+    writer = thread(&Joker::run_writer, this);
 }
 
-bool Joker::connect() {
+Joker::~Joker() {
+    {
+        lock_guard<mutex> lock(writer_mutex);
+        writer_stopping = true;
+    }
+    writer_wakeup.notify_one();
+    writer.join();
+    close_connection();
+}
+
+// Offers the binary protocol with "HELLO-<version>" and reads lines until
+// the answer; the welcome banner comes first. Returns 1 if the service
+// switched to binary, 0 if the connection stays on text (a service that
+// predates the handshake answers "ERROR-Unknown action: HELLO"), or -1 if
+// nothing came back in time.
+static int negotiate_binary(int sock, FrameBuffer& in) {
+    struct timeval timeout = {HANDSHAKE_TIMEOUT_SECONDS, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    string hello = "HELLO-" + to_string(JokerWire::VERSION) + "\n";
+    int result = -1;
+    if (send(sock, hello.data(), hello.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(hello.size())) {
+        string_view line;
+        while (result < 0) {
+            int bytes_read = recv(sock, in.write_ptr(), in.writable(), 0);
+            if (bytes_read <= 0) {
+                break;
+            }
+            in.commit(bytes_read);
+
+            while (result < 0 && in.next_frame(line)) {
+                int version;
+                if (line.compare(0, 6, "HELLO-") == 0) {
+                    result = parse_number(line.substr(6), version) && version == JokerWire::VERSION ? 1 : 0;
+                } else if (line.compare(0, 6, "ERROR-") == 0) {
+                    result = 0;
+                }
+            }
+        }
+    }
+
+    timeout = {0, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return result;
+}
+
+bool Joker::open(Connection& conn) {
+    lock_guard<mutex> lock(conn.connect_mutex);
+    if (conn.connected) {
+        return true;
+    }
+    if (conn.reader.joinable()) {
+        conn.reader.join();
+    }
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        perror("Socket creation failed");
+        return false;
+    }
     if (::connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
         perror("Connection to joker server failed");
+        close(sock);
         return false;
     }
 
-    cout << "Connected to joker server at " << h << ":" << p << endl;
+    FrameBuffer in(4096);
+    int binary = offer_binary ? negotiate_binary(sock, in) : 0;
+    if (binary < 0) {
+        LOG_WARN("Joker server did not answer the protocol handshake");
+        close(sock);
+        return false;
+    }
+
+    // Requests still queued for the previous connection were encoded for it
+    vector<uint32_t> stale;
+    {
+        lock_guard<mutex> lock(conn.write_mutex);
+        lock_guard<mutex> queue_lock(conn.queue_mutex);
+        conn.sock = sock;
+        conn.binary = binary > 0;
+        conn.outbox.clear();
+        stale.swap(conn.queued);
+        conn.connected = true;
+    }
+    fail_requests(conn, stale);
+    generation++;
+    conn.reader = thread(&Joker::read_responses, this, &conn, sock, conn.binary, move(in));
+    return true;
+}
+
+bool Joker::connect() {
+    int opened = 0;
+    int binary = 0;
+    for (auto& conn : pool) {
+        if (open(*conn)) {
+            opened++;
+            binary += conn->binary ? 1 : 0;
+        }
+    }
+
+    if (opened == 0) {
+        return false;
+    }
+    LOG_INFO("Connected to joker server at %s:%d (%d/%zu connections, %d binary)", h.c_str(), p, opened, pool.size(), binary);
     is_connected = true;
-    
-    // Read welcome message from joker server
-    char buffer[1024] = {0};
-    read(sock, buffer, sizeof(buffer));
-    cout << "Joker server message: " << buffer << endl;
-    
+
+    // First joker list before any game starts; cached_jokers() refreshes it
+    // in the background after reconnects
+    uint64_t current = generation;
+    string jokers = get_available_jokers();
+    lock_guard<mutex> lock(jokers_mutex);
+    jokers_cache = make_shared<const string>(jokers);
+    jokers_generation = current;
     return true;
 }
 
-string Joker::get_available_jokers(const string& clientId) {
-    if (!is_connected) {
-        if (!connect()) {
-            return "Ask the Audience (S), 50:50 (Y)"; // Default jokers if can't connect
-        }
-    }
-    
-    // Format the request according to the protocol, including client ID if provided
-    string request;
-    if (clientId.empty()) {
-        request = "GET_JOKERS-0";
-    } else {
-        request = "GET_JOKERS-" + clientId + ":0";
-    }
-    
-    // Send the request
-    send(sock, request.c_str(), request.length(), 0);
-    
-    // Receive the response
-    char buffer[1024] = {0};
-    int bytes_read = read(sock, buffer, sizeof(buffer));
-    
-    if (bytes_read <= 0) {
-        is_connected = false;
-        return "Ask the Audience (S), 50:50 (Y)"; // Default jokers if no response
+// Reader loop for one pooled connection. Text lines look like
+// "<id>|ACTION-DATA"; anything without an ID (the welcome banner) is
+// ignored. Binary messages carry their ID in the header.
+void Joker::read_responses(Connection* conn, int sock, bool binary, FrameBuffer in) {
+    string_view line;
+    JokerWire::Header header;
+    string_view payload;
+
+    // Bytes left over from the handshake are handled before the first recv
+    while (true) {
+        if (binary) {
+            int consumed;
+            while ((consumed = JokerWire::decode(in.peek(), header, payload)) > 0) {
+                if (header.type == JokerWire::Type::BATCH_RESULT) {
+                    deliver_batch(*conn, payload);
+                } else {
+                    Reply reply;
+                    reply.header = &header;
+                    reply.text = payload;
+                    deliver(*conn, header.request_id, reply);
+                }
+                in.consume(consumed);
+            }
+            if (consumed < 0) {
+                break;
+            }
+        } else {
+            while (in.next_frame(line)) {
+                size_t bar = line.find('|');
+                uint32_t id;
+                if (bar == string_view::npos || !parse_number(line.substr(0, bar), id)) {
+                    continue;
+                }
+
+                Reply reply;
+                reply.text = line.substr(bar + 1);
+                deliver(*conn, id, reply);
+            }
+            if (in.overflowed()) {
+                break;
+            }
+        }
+
+        int bytes_read = recv(sock, in.write_ptr(), in.writable(), 0);
+        if (bytes_read <= 0) {
+            break;
+        }
+        in.commit(bytes_read);
+    }
+
+    {
+        // Writers hold write_mutex while using the descriptor
+        lock_guard<mutex> lock(conn->write_mutex);
+        conn->connected = false;
+        close(sock);
+        conn->sock = -1;
+    }
+    fail_pending(*conn);
+
+    bool any_connected = false;
+    for (auto& other : pool) {
+        any_connected = any_connected || other->connected;
+    }
+    is_connected = any_connected;
+    LOG_WARN("Joker server connection closed");
+}
+
+void Joker::deliver(Connection& conn, uint32_t id, const Reply& reply) {
+    ReplyHandler handler;
+    {
+        lock_guard<mutex> lock(conn.pending_mutex);
+        auto it = conn.pending.find(id);
+        if (it == conn.pending.end()) {
+            return;
+        }
+        handler = move(it->second);
+        conn.pending.erase(it);
+    }
+    handler(true, reply);
+}
+
+void Joker::deliver_batch(Connection& conn, string_view replies) {
+    JokerWire::Header header;
+    Reply reply;
+    reply.header = &header;
+    int consumed;
+    while ((consumed = JokerWire::decode(replies, header, reply.text)) > 0) {
+        deliver(conn, header.request_id, reply);
+        replies.remove_prefix(consumed);
+    }
+}
+
+void Joker::fail_pending(Connection& conn) {
+    unordered_map<uint32_t, ReplyHandler> failed;
+    {
+        lock_guard<mutex> lock(conn.pending_mutex);
+        failed.swap(conn.pending);
+    }
+    for (auto& entry : failed) {
+        entry.second(false, Reply());
     }
-    
-    // Parse the response
-    string response(buffer);
+}
+
+// Round trip time and failures per joker_service action
+struct ActionMetrics {
+    Histogram* rtt;
+    Counter* failures;
+};
+
+static const ActionMetrics* action_metrics(JokerAction action) {
+    static const ActionMetrics* const* const table = [] {
+        const ActionMetrics** entries = new const ActionMetrics*[static_cast<int>(JokerAction::COUNT)]();
+        for (JokerAction measured : {JokerAction::AUDIENCE, JokerAction::FIFTY_FIFTY, JokerAction::GET_JOKERS, JokerAction::REGISTER}) {
+            string labels = string("action=\"") + joker_action_name(measured) + "\"";
+            entries[static_cast<int>(measured)] = new ActionMetrics{
+                metrics().histogram("game_host_joker_rtt_seconds", "Round trip time of joker_service requests", labels),
+                metrics().counter("game_host_joker_failures_total", "joker_service requests that got no response", labels)};
+        }
+        return entries;
+    }();
+    return table[static_cast<int>(action)];
+}
+
+void Joker::submit(const Request& request, Callback callback) {
+    submit_request(request, move(callback), false);
+}
+
+uint32_t Joker::submit_async(const Request& request, Callback callback) {
+    return submit_request(request, move(callback), true);
+}
+
+// DISCONNECT and ANSWER_STATS are fire and forget; everything else waits
+// for its reply
+static bool expects_reply(JokerAction action) {
+    return action != JokerAction::DISCONNECT && action != JokerAction::ANSWER_STATS;
+}
+
+uint32_t Joker::submit_request(const Request& request, Callback callback, bool async) {
+    ReplyHandler handler;
+    if (!expects_reply(request.action)) {
+        handler = [callback = move(callback)](bool ok, const Reply&) { callback(ok, ""); };
+        return send_request(request, move(handler), async);
+    }
+
+    // The text AVAILABLE_JOKERS reply echoes the client ID, which has to be
+    // stripped again; other replies are rendered without it
+    string clientId = request.action == JokerAction::GET_JOKERS ? string(request.client_id) : string();
+    const ActionMetrics* measured = action_metrics(request.action);
+    auto start = chrono::steady_clock::now();
+    handler = [callback, measured, start, action = request.action, clientId = move(clientId)](bool ok, const Reply& reply) {
+        string text;
+        ok = ok && render_reply(action, clientId, reply, text);
+        if (measured != nullptr) {
+            if (ok) {
+                measured->rtt->record(chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now() - start).count());
+            } else {
+                measured->failures->add();
+            }
+        }
+        callback(ok, text);
+    };
+    return send_request(request, move(handler), async);
+}
+
+uint32_t Joker::send_request(const Request& request, ReplyHandler handler, bool async) {
+    uint32_t id = next_id++;
+    if (dispatch(id, request, handler, async)) {
+        return id;
+    }
+    if (async) {
+        // Opening a connection blocks, so the writer does it
+        {
+            lock_guard<mutex> lock(writer_mutex);
+            deferred.push_back(Deferred{id, request, string(request.client_id), move(handler)});
+        }
+        writer_wakeup.notify_one();
+        return id;
+    }
+    handler(false, Reply());
+    return id;
+}
+
+// Queues a request on a pooled connection, round-robin, and sends the
+// queue if no one else is. Blocking callers open connections as needed and
+// write themselves; async ones skip closed connections and leave the write
+// to the writer thread. False if no connection took the request.
+bool Joker::dispatch(uint32_t id, const Request& request, const ReplyHandler& handler, bool async) {
+    bool reply_due = expects_reply(request.action);
+    uint32_t first = next_connection++;
+    for (size_t attempt = 0; attempt < pool.size(); attempt++) {
+        Connection& conn = *pool[(first + attempt) % pool.size()];
+        if (!conn.connected && (async || !open(conn))) {
+            continue;
+        }
+
+        if (reply_due) {
+            lock_guard<mutex> lock(conn.pending_mutex);
+            conn.pending[id] = handler;
+        }
+
+        // Queue the request; the first submitter to find the queue idle
+        // sends it, along with whatever others queue meanwhile
+        bool leader;
+        {
+            lock_guard<mutex> lock(conn.queue_mutex);
+            if (conn.binary) {
+                encode_request(conn.outbox, id, request);
+            } else {
+                conn.outbox += to_string(id);
+                conn.outbox += '|';
+                conn.outbox += text_request(request);
+                conn.outbox += '\n';
+            }
+            conn.queued.push_back(id);
+            leader = !conn.flushing;
+            conn.flushing = true;
+        }
+        if (leader && async) {
+            {
+                lock_guard<mutex> lock(writer_mutex);
+                to_flush.push_back(&conn);
+            }
+            writer_wakeup.notify_one();
+        } else if (leader) {
+            flush(conn);
+        }
+
+        if (!reply_due) {
+            handler(true, Reply());
+        }
+        return true;
+    }
+    return false;
+}
+
+// Writes the queues async submitters left and sends the requests that
+// found no open connection, opening one
+void Joker::run_writer() {
+    unique_lock<mutex> lock(writer_mutex);
+    while (true) {
+        writer_wakeup.wait(lock, [this] { return writer_stopping || !to_flush.empty() || !deferred.empty(); });
+        if (writer_stopping) {
+            return;
+        }
+        vector<Connection*> flushes;
+        flushes.swap(to_flush);
+        vector<Deferred> requests;
+        requests.swap(deferred);
+        lock.unlock();
+
+        for (Connection* conn : flushes) {
+            flush(*conn);
+        }
+        for (Deferred& entry : requests) {
+            entry.request.client_id = entry.client_id;
+            if (!dispatch(entry.id, entry.request, entry.handler, false)) {
+                entry.handler(false, Reply());
+            }
+        }
+        lock.lock();
+    }
+}
+
+void Joker::cancel(uint32_t id) {
+    {
+        lock_guard<mutex> lock(writer_mutex);
+        for (auto it = deferred.begin(); it != deferred.end(); ++it) {
+            if (it->id == id) {
+                deferred.erase(it);
+                return;
+            }
+        }
+    }
+    for (auto& conn : pool) {
+        lock_guard<mutex> lock(conn->pending_mutex);
+        if (conn->pending.erase(id) > 0) {
+            return;
+        }
+    }
+}
+
+bool Joker::post(const vector<Request>& requests) {
+    if (requests.empty()) {
+        return true;
+    }
+
+    uint32_t first = next_connection++;
+    for (size_t attempt = 0; attempt < pool.size(); attempt++) {
+        Connection& conn = *pool[(first + attempt) % pool.size()];
+        if (!conn.connected && !open(conn)) {
+            continue;
+        }
+
+        bool leader;
+        {
+            lock_guard<mutex> lock(conn.queue_mutex);
+            for (const Request& request : requests) {
+                uint32_t id = next_id++;
+                if (conn.binary) {
+                    encode_request(conn.outbox, id, request);
+                } else {
+                    conn.outbox += to_string(id);
+                    conn.outbox += '|';
+                    conn.outbox += text_request(request);
+                    conn.outbox += '\n';
+                }
+                conn.queued.push_back(id);
+            }
+            leader = !conn.flushing;
+            conn.flushing = true;
+        }
+        if (leader) {
+            flush(conn);
+        }
+        return true;
+    }
+    return false;
+}
+
+// Sends everything queued on conn, with binary requests coalesced into
+// BATCH messages. Requests queued while a round is being written go out in
+// the next one, so under load one write carries many lifelines.
+void Joker::flush(Connection& conn) {
+    static Counter* writes = metrics().counter("game_host_joker_writes_total", "Writes to joker_service connections");
+    static Counter* requests = metrics().counter("game_host_joker_requests_total", "Requests written to joker_service");
+
+    if (batch_window.count() > 0) {
+        // Give concurrent lifelines a moment to join this write
+        this_thread::sleep_for(batch_window);
+    }
+
+    lock_guard<mutex> write_lock(conn.write_mutex);
+    string queued;
+    string batches;
+    vector<uint32_t> ids;
+    while (true) {
+        {
+            lock_guard<mutex> lock(conn.queue_mutex);
+            if (conn.queued.empty()) {
+                conn.flushing = false;
+                return;
+            }
+            queued.swap(conn.outbox);
+            ids.swap(conn.queued);
+        }
+
+        const string* message = &queued;
+        if (conn.binary && ids.size() > 1) {
+            JokerWire::encode_batches(batches, JokerWire::Type::BATCH, queued);
+            message = &batches;
+        }
+
+        bool sent = false;
+        if (conn.connected) {
+            size_t offset = 0;
+            while (offset < message->size()) {
+                ssize_t n = send(conn.sock, message->data() + offset, message->size() - offset, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    break;
+                }
+                offset += n;
+            }
+            sent = offset == message->size();
+            if (!sent) {
+                // Wake the reader so it fails everything pending here
+                shutdown(conn.sock, SHUT_RDWR);
+            }
+        }
+
+        if (sent) {
+            writes->add();
+            requests->add(ids.size());
+        } else {
+            fail_requests(conn, ids);
+        }
+        queued.clear();
+        batches.clear();
+        ids.clear();
+    }
+}
+
+// Fails the given requests unless the reader already answered or failed them
+void Joker::fail_requests(Connection& conn, const vector<uint32_t>& ids) {
+    for (uint32_t id : ids) {
+        ReplyHandler handler;
+        {
+            lock_guard<mutex> lock(conn.pending_mutex);
+            auto it = conn.pending.find(id);
+            if (it == conn.pending.end()) {
+                continue;
+            }
+            handler = move(it->second);
+            conn.pending.erase(it);
+        }
+        handler(false, Reply());
+    }
+}
+
+future<string> Joker::submit(const Request& request) {
+    uint32_t id;
+    return submit(request, id);
+}
+
+future<string> Joker::submit(const Request& request, uint32_t& id) {
+    auto result = make_shared<promise<string>>();
+    future<string> response = result->get_future();
+    id = submit_request(request, [result](bool ok, const string& text) {
+        result->set_value(ok ? text : "");
+    }, false);
+    return response;
+}
+
+// Sends a request and waits for its reply; returns fallback on failure.
+// Lifeline requests only read, so one lost with its connection (a
+// joker_service restart cutting off game hosts) is sent once more, which
+// opens a connection to the new instance.
+string Joker::call(const Request& request, const string& fallback) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        uint32_t id;
+        future<string> response = submit(request, id);
+        if (response.wait_for(RESPONSE_TIMEOUT) != future_status::ready) {
+            // A late reply finds nothing to complete
+            cancel(id);
+            return fallback;
+        }
+        string text = response.get();
+        if (!text.empty()) {
+            return text;
+        }
+    }
+    return fallback;
+}
+
+// Splits "ACTION-[clientId:]DATA" and checks the action
+static bool parse_response(string_view response, string_view expected_action, string_view clientId, string_view& data) {
     size_t delimiter_pos = response.find('-');
-    
-    if (delimiter_pos == string::npos) {
-        return "Ask the Audience (S), 50:50 (Y)"; // Default jokers if invalid format
+    if (delimiter_pos == string_view::npos || response.substr(0, delimiter_pos) != expected_action) {
+        return false;
     }
-    
-    string action = response.substr(0, delimiter_pos);
-    string data = response.substr(delimiter_pos + 1);
-    
-    if (action != "AVAILABLE_JOKERS") {
-        return "Ask the Audience (S), 50:50 (Y)"; // Default jokers if unexpected response
+
+    data = response.substr(delimiter_pos + 1);
+
+    // If response includes client ID, extract just the results part
+    if (!clientId.empty() && data.size() > clientId.size() && data.compare(0, clientId.size(), clientId) == 0 &&
+        data[clientId.size()] == ':') {
+        data.remove_prefix(clientId.size() + 1);
     }
-    
-    // If response includes client ID, extract just the jokers part
-    size_t colon_pos = data.find(':');
-    if (colon_pos != string::npos) {
-        data = data.substr(colon_pos + 1);
+    return true;
+}
+
+// Turns a reply in either wire format into the text handed to callbacks.
+// Binary lifeline results are formatted straight from their numbers.
+bool Joker::render_reply(JokerAction action, string_view clientId, const Reply& reply, string& text) {
+    if (reply.header != nullptr) {
+        const JokerWire::Header& header = *reply.header;
+        switch (action) {
+        case JokerAction::AUDIENCE:
+            if (header.type != JokerWire::Type::AUDIENCE_RESULT || reply.text.size() != 4) {
+                return false;
+            }
+            text = format_audience_percentages(reinterpret_cast<const uint8_t*>(reply.text.data()));
+            return true;
+        case JokerAction::FIFTY_FIFTY:
+            if (header.type != JokerWire::Type::FIFTY_FIFTY_RESULT || reply.text.size() != 2) {
+                return false;
+            }
+            text = "50:50 Result: Remaining options: ";
+            text += reply.text[0];
+            text += ',';
+            text += reply.text[1];
+            text += '\n';
+            return true;
+        case JokerAction::GET_JOKERS:
+            if (header.type != JokerWire::Type::AVAILABLE_JOKERS || reply.text.empty()) {
+                return false;
+            }
+            text = reply.text;
+            return true;
+        case JokerAction::REGISTER:
+            text = "REGISTERED";
+            return header.type == JokerWire::Type::REGISTERED;
+        default:
+            return false;
+        }
+    }
+
+    string_view data;
+    switch (action) {
+    case JokerAction::AUDIENCE:
+        text = format_audience_result(string(reply.text));
+        return true;
+    case JokerAction::FIFTY_FIFTY:
+        text = format_fifty_fifty_result(string(reply.text));
+        return true;
+    case JokerAction::GET_JOKERS:
+        if (!parse_response(reply.text, "AVAILABLE_JOKERS", clientId, data) || data.empty()) {
+            return false;
+        }
+        text = data;
+        return true;
+    case JokerAction::REGISTER:
+        text = "REGISTERED";
+        return reply.text.find("REGISTERED-") != string_view::npos;
+    default:
+        return false;
     }
-    
-    return data; // Return the available jokers from the joker service
 }
 
-string Joker::request_audience_help(int question_index, const string& clientId) {
+string Joker::get_available_jokers(const string& clientId) {
+    Request request;
+    request.action = JokerAction::GET_JOKERS;
+    request.client_id = clientId;
+
+    // Default jokers if no or unexpected response
+    return call(request, DEFAULT_JOKERS);
+}
+
+shared_ptr<const string> Joker::cached_jokers() {
     if (!is_connected) {
-        if (!connect()) {
-            return "ERROR: Not connected to joker server";
-        }
-    }
-    
-    // Format the request according to the protocol, including client ID if provided
-    string request;
-    if (clientId.empty()) {
-        request = "AUDIENCE-" + to_string(question_index);
-    } else {
-        request = "AUDIENCE-" + clientId + ":" + to_string(question_index);
-    }
-    
-    // Send the request
-    send(sock, request.c_str(), request.length(), 0);
-    
-    // Receive the response
-    char buffer[1024] = {0};
-    int bytes_read = read(sock, buffer, sizeof(buffer));
-    
-    if (bytes_read <= 0) {
-        is_connected = false;
-        return "ERROR: Failed to receive response from joker server";
+        return nullptr;
+    }
+
+    // A reconnect makes the list stale; games keep getting the old one while
+    // a single refresh is in flight, so START never waits on the service
+    uint64_t current = generation;
+    shared_ptr<const string> jokers;
+    {
+        lock_guard<mutex> lock(jokers_mutex);
+        jokers = jokers_cache;
+        if (jokers_generation == current || jokers_refreshing) {
+            return jokers;
+        }
+        jokers_refreshing = true;
+    }
+
+    Request request;
+    request.action = JokerAction::GET_JOKERS;
+    submit_async(request, [this, current](bool ok, const string& text) {
+        lock_guard<mutex> lock(jokers_mutex);
+        if (ok && !text.empty()) {
+            jokers_cache = make_shared<const string>(text);
+            jokers_generation = current;
+        }
+        jokers_refreshing = false;
+    });
+    return jokers;
+}
+
+string Joker::audience_request(int question_id, string_view clientId) {
+    string request = "AUDIENCE-";
+    if (!clientId.empty()) {
+        request.append(clientId);
+        request += ':';
     }
-    
-    // Parse the response
-    string response(buffer);
+    return request + to_string(question_id);
+}
+
+string Joker::fifty_fifty_request(int question_id, char correct_answer, string_view clientId) {
+    string request = "FIFTY_FIFTY-";
+    if (!clientId.empty()) {
+        request.append(clientId);
+        request += ':';
+    }
+    return request + to_string(question_id) + "," + correct_answer;
+}
+
+// Text protocol line for a request, without the "<id>|" prefix
+string Joker::text_request(const Request& request) {
+    switch (request.action) {
+    case JokerAction::AUDIENCE:
+        return audience_request(request.question_id, request.client_id);
+    case JokerAction::FIFTY_FIFTY:
+        return fifty_fifty_request(request.question_id, request.correct_answer, request.client_id);
+    case JokerAction::GET_JOKERS:
+        if (request.client_id.empty()) {
+            return "GET_JOKERS-0";
+        }
+        return "GET_JOKERS-" + string(request.client_id) + ":0";
+    case JokerAction::REGISTER:
+        return "REGISTER-" + string(request.client_id);
+    case JokerAction::DISCONNECT:
+        return "DISCONNECT-" + string(request.client_id);
+    case JokerAction::ANSWER_STATS:
+        return "ANSWER_STATS-" + to_string(request.question_id) + "," + to_string(request.answers[0]) + "," +
+               to_string(request.answers[1]) + "," + to_string(request.answers[2]) + "," + to_string(request.answers[3]);
+    default:
+        return "";
+    }
+}
+
+// Binary protocol message for a request
+void Joker::encode_request(string& out, uint32_t id, const Request& request) {
+    JokerWire::Header header;
+    switch (request.action) {
+    case JokerAction::AUDIENCE:     header.type = JokerWire::Type::AUDIENCE; break;
+    case JokerAction::FIFTY_FIFTY:  header.type = JokerWire::Type::FIFTY_FIFTY; break;
+    case JokerAction::GET_JOKERS:   header.type = JokerWire::Type::GET_JOKERS; break;
+    case JokerAction::REGISTER:     header.type = JokerWire::Type::REGISTER; break;
+    case JokerAction::DISCONNECT:   header.type = JokerWire::Type::DISCONNECT; break;
+    case JokerAction::ANSWER_STATS: header.type = JokerWire::Type::ANSWER_STATS; break;
+    default:                        header.type = JokerWire::Type::INVALID; break;
+    }
+    header.arg = static_cast<uint8_t>(request.correct_answer);
+    header.request_id = id;
+    header.question = static_cast<uint32_t>(request.question_id);
+    header.client = JokerWire::client_handle(request.client_id);
+
+    if (request.action != JokerAction::ANSWER_STATS) {
+        JokerWire::encode(out, header);
+        return;
+    }
+    char counts[4 * sizeof(uint32_t)];
+    for (int i = 0; i < 4; i++) {
+        for (int byte = 0; byte < 4; byte++) {
+            counts[4 * i + byte] = static_cast<char>(request.answers[i] >> (8 * byte));
+        }
+    }
+    JokerWire::encode(out, header, string_view(counts, sizeof(counts)));
+}
+
+// "AUDIENCE_RESULT-[clientId:]A:40%,B:25%,C:30%,D:5%" -> display text
+string Joker::format_audience_result(const string& response) {
     size_t delimiter_pos = response.find('-');
-    
-    if (delimiter_pos == string::npos) {
-        return "ERROR: Invalid response format";
-    }
-    
-    string action = response.substr(0, delimiter_pos);
-    string data = response.substr(delimiter_pos + 1);
-    
-    if (action != "AUDIENCE_RESULT") {
-        return "ERROR: Unexpected response type";
-    }
-    
-    // If response includes client ID, extract just the results part
-    size_t client_colon_pos = data.find(':');
-    if (client_colon_pos != string::npos) {
-        data = data.substr(client_colon_pos + 1);
+    if (delimiter_pos == string::npos || response.compare(0, delimiter_pos, "AUDIENCE_RESULT") != 0) {
+        return "ERROR: Failed to receive response from joker server\n";
+    }
+
+    // Results start at the first "A:"; anything before it is the client ID
+    size_t results_pos = response.find("A:", delimiter_pos + 1);
+    if (results_pos == string::npos) {
+        return "ERROR: Invalid response format\n";
     }
-    
-    // Format the audience results for display
+
     string formatted_result = "Ask the Audience Results:\n";
-    size_t pos = 0;
-    string token;
-    string delimiter = ",";
-    int option_index = 0;
-    char options[] = {'A', 'B', 'C', 'D'};
-    
-    while ((pos = data.find(delimiter)) != string::npos) {
-        token = data.substr(0, pos);
+    size_t pos = results_pos;
+    while (pos < response.size()) {
+        size_t comma_pos = response.find(',', pos);
+        if (comma_pos == string::npos) {
+            comma_pos = response.size();
+        }
+
+        string token = response.substr(pos, comma_pos - pos);
         size_t option_colon_pos = token.find(':');
         if (option_colon_pos != string::npos) {
-            string percentage = token.substr(option_colon_pos + 1);
-            formatted_result += options[option_index] + ": " + percentage + " ";
+            if (pos != results_pos) {
+                formatted_result += ", ";
+            }
+            formatted_result += token.substr(0, option_colon_pos) + ": " + token.substr(option_colon_pos + 1);
         }
-        data.erase(0, pos + delimiter.length());
-        option_index++;
+        pos = comma_pos + 1;
     }
-    
-    // Handle the last option
-    size_t option_colon_pos = data.find(':');
-    if (option_colon_pos != string::npos) {
-        string percentage = data.substr(option_colon_pos + 1);
-        formatted_result += options[option_index] + ": " + percentage;
-    }
-    
-    return formatted_result;
+
+    return formatted_result + "\n";
 }
 
-string Joker::request_fifty_fifty(int question_index, char correct_answer, const string& clientId) {
-    if (!is_connected) {
-        if (!connect()) {
-            return "ERROR: Not connected to joker server";
-        }
-    }
-    
-    // Format the request according to the protocol, including client ID if provided
-    string request;
-    if (clientId.empty()) {
-        request = "FIFTY_FIFTY-" + to_string(question_index) + "," + correct_answer;
-    } else {
-        request = "FIFTY_FIFTY-" + clientId + ":" + to_string(question_index) + "," + correct_answer;
-    }
-    
-    // Send the request
-    send(sock, request.c_str(), request.length(), 0);
-    
-    // Receive the response
-    char buffer[1024] = {0};
-    int bytes_read = read(sock, buffer, sizeof(buffer));
-    
-    if (bytes_read <= 0) {
-        is_connected = false;
-        return "ERROR: Failed to receive response from joker server";
-    }
-    
-    // Parse the response
-    string response(buffer);
+// "FIFTY_FIFTY_RESULT-[clientId:]A,C" -> display text
+string Joker::format_fifty_fifty_result(const string& response) {
     size_t delimiter_pos = response.find('-');
-    
-    if (delimiter_pos == string::npos) {
-        return "ERROR: Invalid response format";
-    }
-    
-    string action = response.substr(0, delimiter_pos);
-    string data = response.substr(delimiter_pos + 1);
-    
-    if (action != "FIFTY_FIFTY_RESULT") {
-        return "ERROR: Unexpected response type";
-    }
-    
-    // If response includes client ID, extract just the results part
-    size_t colon_pos = data.find(':');
-    if (colon_pos != string::npos) {
-        data = data.substr(colon_pos + 1);
+    if (delimiter_pos == string::npos || response.compare(0, delimiter_pos, "FIFTY_FIFTY_RESULT") != 0) {
+        return "ERROR: Failed to receive response from joker server\n";
     }
-    
-    // Format the 50:50 results for display
-    string formatted_result = "50:50 Result: Remaining options: ";
-    
-    // The data should be in the format "A,B" (two remaining options)
-    formatted_result += data;
-    
-    return formatted_result;
+
+    // The data ends with the two remaining options, e.g. "A,C"
+    size_t colon_pos = response.find_last_of(':');
+    size_t data_pos = colon_pos != string::npos && colon_pos > delimiter_pos ? colon_pos + 1 : delimiter_pos + 1;
+
+    return "50:50 Result: Remaining options: " + response.substr(data_pos) + "\n";
 }
 
-// Register a client with the joker server
-bool Joker::register_client(const string& clientId) {
-    if (!is_connected) {
-        if (!connect()) {
-            return false;
+// {40, 25, 30, 5} -> the same display text as format_audience_result
+string Joker::format_audience_percentages(const uint8_t percentages[4]) {
+    static const char header[] = "Ask the Audience Results:\n";
+    char result[64];
+    char* out = copy(header, header + sizeof(header) - 1, result);
+    for (int i = 0; i < 4; i++) {
+        if (i > 0) {
+            *out++ = ',';
+            *out++ = ' ';
+        }
+        *out++ = static_cast<char>('A' + i);
+        *out++ = ':';
+        *out++ = ' ';
+        unsigned percentage = percentages[i];
+        if (percentage >= 100) {
+            *out++ = static_cast<char>('0' + percentage / 100);
         }
+        if (percentage >= 10) {
+            *out++ = static_cast<char>('0' + percentage / 10 % 10);
+        }
+        *out++ = static_cast<char>('0' + percentage % 10);
+        *out++ = '%';
     }
-    
-    // Format the registration request
-    string request = "REGISTER-" + clientId;
-    
-    // Send the request
-    send(sock, request.c_str(), request.length(), 0);
-    
-    // Receive the response
-    char buffer[1024] = {0};
-    int bytes_read = read(sock, buffer, sizeof(buffer));
-    
-    if (bytes_read <= 0) {
-        is_connected = false;
-        return false;
+    *out++ = '\n';
+    return string(result, out - result);
+}
+
+const char Joker::LIFELINE_FAILED[] = NO_RESPONSE;
+
+Joker::Request Joker::lifeline_request(JokerAction action, int question_id, char correct_answer, string_view clientId) {
+    if (!clientId.empty()) {
+        saved_round_trips++;
     }
-    
+    Request request;
+    request.action = action;
+    request.client_id = clientId;
+    request.question_id = question_id;
+    request.correct_answer = correct_answer;
+    return request;
+}
+
+string Joker::request_audience_help(int question_id, const string& clientId) {
+    return call(lifeline_request(JokerAction::AUDIENCE, question_id, 0, clientId), NO_RESPONSE);
+}
+
+string Joker::request_fifty_fifty(int question_id, char correct_answer, const string& clientId) {
+    return call(lifeline_request(JokerAction::FIFTY_FIFTY, question_id, correct_answer, clientId), NO_RESPONSE);
+}
+
+// Register a client with the joker server
+bool Joker::register_client(const string& clientId) {
+    Request request;
+    request.action = JokerAction::REGISTER;
+    request.client_id = clientId;
+
     // Parse the response to confirm registration
-    string response(buffer);
-    if (response.find("REGISTERED-") != string::npos) {
-        cout << "Successfully registered client " << clientId << " with joker server" << endl;
-        return true;
+    if (call(request, "").empty()) {
+        return false;
     }
-    
-    return false;
+
+    LOG_DEBUG("Successfully registered client %s with joker server", clientId.c_str());
+    return true;
 }
 
 void Joker::close_connection() {
+    for (auto& conn : pool) {
+        {
+            lock_guard<mutex> lock(conn->write_mutex);
+            if (conn->connected) {
+                shutdown(conn->sock, SHUT_RDWR);
+            }
+        }
+        lock_guard<mutex> lock(conn->connect_mutex);
+        if (conn->reader.joinable()) {
+            conn->reader.join();
+        }
+    }
     if (is_connected) {
-        close(sock);
         is_connected = false;
-        cout << "Disconnected from joker server" << endl;
+        LOG_INFO("Disconnected from joker server");
     }
 }
@@ -0,0 +1,26 @@
+#include "payload_cache.h"
+
+using namespace std;
+
+PayloadCache::PayloadCache(shared_ptr<const QuestionBank> bank) : questions(move(bank)) {
+    static const char* const prefixes[QuestionBank::OPTIONS] = {"A) ", "B) ", "C) ", "D) "};
+
+    const QuestionBank& q = *questions;
+    offsets.reserve(q.size() + 1);
+    for (uint32_t id = 0; id < q.size(); id++) {
+        offsets.push_back(static_cast<uint32_t>(blob.size()));
+
+        string position = to_string(q.tier(id));
+        blob += "QUESTION:" + position + ":" + to_string(q.tier(id) + 1) + ". ";
+        blob += q.text(id);
+        blob += "\nOPTIONS:" + position + ":";
+        for (int j = 0; j < QuestionBank::OPTIONS; j++) {
+            blob += prefixes[j];
+            blob += q.option(id, j);
+            if (j < QuestionBank::OPTIONS - 1) blob += "|";
+        }
+        blob += "\n";
+    }
+    offsets.push_back(static_cast<uint32_t>(blob.size()));
+    blob.shrink_to_fit();
+}
@@ -0,0 +1,433 @@
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include "logger.h"
+#include "reactor.h"
+#include "server.h"
+
+using namespace std;
+
+#define MAX_EVENTS 256
+
+Reactor::Reactor(Server* server, int port, int server_fd, int ws_fd, int worker_count, bool reuse_port) {
+    this->server = server;
+    this->port = port;
+    this->server_fd = server_fd;
+    this->ws_fd = ws_fd;
+    this->reuse_port = reuse_port;
+
+    if (worker_count < 1) {
+        worker_count = 1;
+    }
+    for (int i = 0; i < worker_count; i++) {
+        auto worker = make_unique<Worker>();
+        worker->id = i;
+        workers.push_back(move(worker));
+    }
+}
+
+// Opens an extra listening socket on the same port. Only used with
+// SO_REUSEPORT, where the kernel spreads new connections across listeners.
+int Reactor::open_listener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("Socket failed");
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        perror("Reuseport listener failed");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void Reactor::run() {
+    if (listen(server_fd, SOMAXCONN) < 0) {
+        perror("Listen failed");
+        exit(EXIT_FAILURE);
+    }
+    if (fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL, 0) | O_NONBLOCK) < 0) {
+        perror("Nonblocking listen socket failed");
+        exit(EXIT_FAILURE);
+    }
+    if (ws_fd >= 0 && fcntl(ws_fd, F_SETFL, fcntl(ws_fd, F_GETFL, 0) | O_NONBLOCK) < 0) {
+        perror("Nonblocking WebSocket socket failed");
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned cpus = thread::hardware_concurrency();
+
+    for (auto& worker : workers) {
+        worker->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (worker->epfd < 0) {
+            perror("epoll_create1 failed");
+            exit(EXIT_FAILURE);
+        }
+
+        worker->listen_fd = server_fd;
+        if (reuse_port && worker->id > 0) {
+            int fd = open_listener(port);
+            if (fd >= 0) {
+                worker->listen_fd = fd;
+            }
+        }
+        if (worker->listen_fd == server_fd) {
+            shared_listeners++;
+        }
+        if (worker->id == 0 || worker->listen_fd != server_fd) {
+            Server::export_accept_queue(worker->listen_fd, reuse_port ? "listener=\"" + to_string(worker->id) + "\"" : "");
+        }
+
+        // Without SO_REUSEPORT every worker waits on the shared listen socket;
+        // EPOLLEXCLUSIVE wakes just one of them per incoming connection.
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        if (worker->listen_fd == server_fd && workers.size() > 1) {
+            ev.events |= EPOLLEXCLUSIVE;
+        }
+        ev.data.fd = worker->listen_fd;
+        if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, worker->listen_fd, &ev) < 0) {
+            perror("epoll_ctl listen failed");
+            exit(EXIT_FAILURE);
+        }
+
+        if (ws_fd >= 0) {
+            ev.events = EPOLLIN | (workers.size() > 1 ? static_cast<uint32_t>(EPOLLEXCLUSIVE) : 0u);
+            ev.data.fd = ws_fd;
+            if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, ws_fd, &ev) < 0) {
+                perror("epoll_ctl WebSocket listen failed");
+                exit(EXIT_FAILURE);
+            }
+            ws_listeners++;
+        }
+
+        // Every worker hears about stop()
+        ev.events = EPOLLIN;
+        ev.data.fd = server->stop_fd;
+        if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, server->stop_fd, &ev) < 0) {
+            perror("epoll_ctl stop failed");
+            exit(EXIT_FAILURE);
+        }
+
+        worker->resumes = make_shared<ResumeQueue>();
+        ev.events = EPOLLIN;
+        ev.data.fd = worker->resumes->fd();
+        if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, worker->resumes->fd(), &ev) < 0) {
+            perror("epoll_ctl resume queue failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    LOG_INFO("Reactor waiting for connections on port %d with %zu worker(s)%s...",
+             port, workers.size(), reuse_port ? " (SO_REUSEPORT)" : "");
+
+    for (auto& worker : workers) {
+        Worker* w = worker.get();
+        w->thread = thread(&Reactor::run_worker, this, ref(*w));
+
+        if (cpus > 0) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(w->id % cpus, &cpuset);
+            pthread_setaffinity_np(w->thread.native_handle(), sizeof(cpuset), &cpuset);
+        }
+    }
+
+    for (auto& worker : workers) {
+        worker->thread.join();
+        worker->resumes->close();
+        close(worker->epfd);
+    }
+}
+
+// Stops taking new connections: whatever is already in the accept queue is
+// taken on and the listener is closed, so the kernel sends new connections
+// to a restarted instance instead of queueing them here. The shared listen
+// socket is closed by the last worker that waits on it.
+void Reactor::stop_accepting(Worker& worker) {
+    accept_clients(worker, worker.listen_fd, false);
+    epoll_ctl(worker.epfd, EPOLL_CTL_DEL, worker.listen_fd, nullptr);
+    epoll_ctl(worker.epfd, EPOLL_CTL_DEL, server->stop_fd, nullptr);
+    if (worker.listen_fd != server_fd || --shared_listeners == 0) {
+        Server::close_listener(worker.listen_fd);
+    }
+    worker.listen_fd = -1;
+
+    if (ws_fd >= 0) {
+        accept_clients(worker, ws_fd, true);
+        epoll_ctl(worker.epfd, EPOLL_CTL_DEL, ws_fd, nullptr);
+        if (--ws_listeners == 0) {
+            Server::close_listener(ws_fd);
+        }
+    }
+}
+
+// Sends GOAWAY on the worker's multiplexed connections and closes those
+// without players
+void Reactor::notify_carriers(Worker& worker) {
+    vector<int> idle;
+    for (auto& entry : worker.sessions) {
+        Session& session = *entry.second;
+        if (session.multiplexed && !server->notify_stopping(session)) {
+            session.closing = true;
+            if (session.out.empty()) {
+                idle.push_back(entry.first);
+            }
+        }
+    }
+    for (int fd : idle) {
+        close_client(worker, fd);
+    }
+}
+
+void Reactor::run_worker(Worker& worker) {
+    struct epoll_event events[MAX_EVENTS];
+    bool draining = false;
+    ResumeQueue::current = worker.resumes;
+
+    while (true) {
+        if (draining && worker.sessions.empty()) {
+            return;
+        }
+        if (draining && server->past_drain_deadline()) {
+            LOG_WARN("Worker %d: drain timeout with %zu session(s) open, closing them", worker.id, worker.sessions.size());
+            vector<int> open;
+            for (auto& entry : worker.sessions) {
+                open.push_back(entry.first);
+            }
+            for (int fd : open) {
+                server->handle_disconnect(*worker.sessions[fd]);
+                close_client(worker, fd);
+            }
+            return;
+        }
+
+        // Sleeps until the next timer is due; while draining, wakes up now
+        // and then to check the deadline as well
+        int timeout = worker.timers.timeout();
+        if (draining && (timeout < 0 || timeout > 100)) {
+            timeout = 100;
+        }
+        int n = epoll_wait(worker.epfd, events, MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait failed");
+            return;
+        }
+        worker.timers.advance(TimerWheel::now(), [this, &worker](Timer& timer) { expired(worker, timer); });
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            uint32_t ev = events[i].events;
+
+            if (fd == worker.listen_fd) {
+                accept_clients(worker, worker.listen_fd, false);
+                continue;
+            }
+            if (fd == ws_fd && !draining) {
+                accept_clients(worker, ws_fd, true);
+                continue;
+            }
+            if (fd == worker.resumes->fd()) {
+                worker.resumes->run([this, &worker](Session& session) { resumed(worker, session); });
+                continue;
+            }
+            if (fd == server->stop_fd) {
+                if (!draining) {
+                    stop_accepting(worker);
+                    draining = true;
+                    LOG_DEBUG("Worker %d draining %zu session(s)", worker.id, worker.sessions.size());
+                    notify_carriers(worker);
+                }
+                continue;
+            }
+
+            auto it = worker.sessions.find(fd);
+            if (it == worker.sessions.end()) {
+                continue;
+            }
+            Session& session = *it->second;
+
+            if (ev & (EPOLLERR | EPOLLHUP)) {
+                server->handle_disconnect(session);
+                close_client(worker, fd);
+                continue;
+            }
+            if (ev & EPOLLOUT) {
+                if (!flush(session) || (session.closing && session.out.empty())) {
+                    close_client(worker, fd);
+                    continue;
+                }
+            }
+            if (ev & (EPOLLIN | EPOLLRDHUP)) {
+                read_client(worker, session);
+            }
+        }
+    }
+}
+
+void Reactor::accept_clients(Worker& worker, int listen_fd, bool websocket) {
+    while (true) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            // Out of descriptors or similar: keep serving existing sessions
+            server->accept_errors->add();
+            perror("Accept failed");
+            return;
+        }
+
+        server->connections_accepted->add();
+
+        auto session = make_shared<Session>();
+        session->socket = fd;
+        session->nonblocking = true;
+        session->epfd = worker.epfd;
+        session->timers = &worker.timers;
+        if (websocket) {
+            session->websocket = true;
+            session->in = FrameBuffer(WebSocket::MAX_HANDSHAKE);
+        }
+        server->touch(*session);
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (epoll_ctl(worker.epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("epoll_ctl add failed");
+            close(fd);
+            continue;
+        }
+
+        worker.sessions[fd] = move(session);
+        LOG_DEBUG("Connection established with client!");
+    }
+}
+
+void Reactor::read_client(Worker& worker, Session& session) {
+    int fd = session.socket;
+
+    while (true) {
+        int bytes_read = recv(fd, session.in.write_ptr(), session.in.writable(), 0);
+        if (bytes_read < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+        }
+        if (bytes_read <= 0) {
+            server->handle_disconnect(session);
+            close_client(worker, fd);
+            return;
+        }
+        session.in.commit(bytes_read);
+
+        if (!server->handle_input(session)) {
+            close_client(worker, fd);
+            return;
+        }
+
+        if (session.closing) {
+            if (session.out.empty()) {
+                close_client(worker, fd);
+            }
+            return;
+        }
+    }
+}
+
+// A lifeline finished on the session's connection, and the commands that
+// waited for it may have ended the game
+void Reactor::resumed(Worker& worker, Session& session) {
+    if (!session.closed && session.closing && session.out.empty()) {
+        close_client(worker, session.socket);
+    }
+}
+
+// A session's or player's timer ran out; the connection closes once the
+// reply telling it why has gone out
+void Reactor::expired(Worker& worker, Timer& timer) {
+    Session& session = *static_cast<Session*>(timer.owner);
+    Session& connection = session.carrier != nullptr ? *session.carrier : session;
+    if (!server->handle_timeout(session, timer)) {
+        connection.closing = true;
+    }
+    if (!connection.closed && connection.closing && connection.out.empty()) {
+        close_client(worker, connection.socket);
+    }
+}
+
+void Reactor::close_client(Worker& worker, int fd) {
+    auto it = worker.sessions.find(fd);
+    if (it != worker.sessions.end()) {
+        it->second->closed = true;
+        Server::cancel_timers(*it->second);
+        if (it->second->multiplexed) {
+            server->handle_disconnect(*it->second);
+        }
+        if (it->second->upgraded) {
+            server->websocket_connections--;
+        }
+        server->end_session(*it->second);
+        worker.sessions.erase(it);
+    }
+    epoll_ctl(worker.epfd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+}
+
+bool Reactor::flush(Session& session) {
+    while (!session.out.empty()) {
+        ssize_t sent = send(session.socket, session.out.data(), session.out.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return false;
+            }
+            break;
+        }
+        session.out.erase(0, sent);
+    }
+
+    bool want_write = !session.out.empty();
+    if (want_write != session.want_write) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP | (want_write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        ev.data.fd = session.socket;
+        epoll_ctl(session.epfd, EPOLL_CTL_MOD, session.socket, &ev);
+        session.want_write = want_write;
+    }
+    return true;
+}
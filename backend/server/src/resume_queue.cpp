@@ -0,0 +1,79 @@
+#include <iostream>
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "resume_queue.h"
+
+using namespace std;
+
+thread_local shared_ptr<ResumeQueue> ResumeQueue::current;
+
+ResumeQueue::ResumeQueue() {
+    if ((event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        perror("eventfd failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+ResumeQueue::~ResumeQueue() {
+    ::close(event_fd);
+}
+
+void ResumeQueue::suspend(coroutine_handle<> handle) {
+    lock_guard<mutex> lock(entries_mutex);
+    waiting.insert(handle.address());
+}
+
+void ResumeQueue::post(coroutine_handle<> handle, shared_ptr<Session> connection) {
+    bool wake;
+    {
+        lock_guard<mutex> lock(entries_mutex);
+        if (closed) {
+            return;
+        }
+        waiting.erase(handle.address());
+        wake = entries.empty();
+        entries.push_back({handle, move(connection)});
+    }
+    // One wakeup covers everything posted until the worker runs them
+    if (wake) {
+        uint64_t one = 1;
+        if (write(event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            perror("Resume notification failed");
+        }
+    }
+}
+
+void ResumeQueue::run(const function<void(Session&)>& resumed) {
+    uint64_t count;
+    if (read(event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        perror("Resume queue read failed");
+    }
+
+    vector<Entry> ready;
+    {
+        lock_guard<mutex> lock(entries_mutex);
+        ready.swap(entries);
+    }
+    for (Entry& entry : ready) {
+        entry.handle.resume();
+        resumed(*entry.connection);
+    }
+}
+
+void ResumeQueue::close() {
+    vector<Entry> ready;
+    unordered_set<void*> suspended;
+    {
+        lock_guard<mutex> lock(entries_mutex);
+        closed = true;
+        ready.swap(entries);
+        suspended.swap(waiting);
+    }
+    for (void* address : suspended) {
+        coroutine_handle<>::from_address(address).destroy();
+    }
+    for (Entry& entry : ready) {
+        entry.handle.destroy();
+    }
+}
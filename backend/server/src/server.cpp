@@ -5,20 +5,84 @@
 #include <cstring>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <thread>
 #include <map>
+#include <mutex>
 #include <string>
+#include <vector>
+#include "command.h"
 #include "joker.h"
-#include <sstream>
+#include "logger.h"
+#include "reactor.h"
+#include "resume_queue.h"
+#include "uring_reactor.h"
+#include "random.h"
+#include "snapshot_ptr.h"
+#include <algorithm>
+#include <charconv>
 
 using namespace std;
 
 // Global joker client
 Joker* jokerClient = nullptr;
 
-// Map to track websocket client IDs to their TCP socket connections
-map<string, int> clientSockets;
+// Open multiplexed adapter connections
+atomic<int> muxConnections{0};
+
+#define MAX_MUX_ID 96           // longest client ID a carrier routes
+#define MAX_MUX_PLAYERS 10000   // players one carrier may hold at once
+#define MAX_REPLY_BUFFERS 16    // iovecs in one reply, header included
+#define MAX_DEFERRED 4096       // commands a player may queue behind a lifeline
+#define LIFELINE_TIMEOUT_MS 2000 // as long as a blocking Joker call waits
+
+// Per-question answer counters, if enabled. Replaced on reload; the
+// caller keeps replaced ones alive, so a plain atomic pointer is enough.
+atomic<AnswerStats*> answerStats{nullptr};
+
+// Submits the request once the coroutine has suspended and resumes it on
+// this event loop's thread with the reply text, empty if the request
+// failed or the session's lifeline_timer ran out first (timed_out()).
+struct JokerReply {
+    Session& session;
+    const Joker::Request& request;
+    shared_ptr<Session> connection;
+    shared_ptr<LifelineWait> wait;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(coroutine_handle<> handle) {
+        shared_ptr<ResumeQueue> queue = ResumeQueue::current;
+        wait = make_shared<LifelineWait>();
+        wait->handle = handle;
+        session.lifeline = wait;
+        session.timers->arm(session.lifeline_timer, &session, LIFELINE_TIMEOUT_MS);
+        queue->suspend(handle);
+        // A handler left behind on a Joker thread must not keep the session
+        // alive: its timers belong to this loop
+        weak_ptr<Session> target = connection;
+        wait->request_id = jokerClient->submit_async(request, [wait = wait, queue, target](bool ok, const string& reply) {
+            shared_ptr<Session> connection = target.lock();
+            if (connection == nullptr || wait->claimed.exchange(true)) {
+                return;
+            }
+            wait->text = ok ? reply : string();
+            queue->post(wait->handle, move(connection));
+        });
+    }
+    string await_resume() {
+        session.lifeline_timer.cancel();
+        session.lifeline = nullptr;
+        return move(wait->text);
+    }
+    bool timed_out() const { return wait->timed_out; }
+    // Also runs when ResumeQueue::close() destroys the suspended coroutine
+    ~JokerReply() { session.lifeline_timer.cancel(); }
+};
 
 Server::Server(int port) {
     p = port;
@@ -28,6 +92,11 @@ Server::Server(int port) {
         exit(EXIT_FAILURE);
     }
 
+    // SO_REUSEPORT lets reactor workers open sibling listeners on this port
+    int opt = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
     address.sin_port = htons(p);
@@ -36,280 +105,1147 @@ Server::Server(int port) {
         perror("Bind failed");
         exit(EXIT_FAILURE);
     }
+
+    if ((stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        perror("eventfd failed");
+        exit(EXIT_FAILURE);
+    }
+
+    connections_accepted = metrics().counter("game_host_connections_accepted_total", "Client connections accepted");
+    accept_errors = metrics().counter("game_host_accept_errors_total", "accept() calls that failed");
+    metrics().gauge("game_host_sessions_active", "Registered players", [this] {
+        return static_cast<double>(sessions.size());
+    });
+    metrics().gauge("game_host_game_history_players", "Players whose recent games are remembered", [this] {
+        return static_cast<double>(history.size());
+    });
+    metrics().gauge("game_host_mux_connections", "Open multiplexed adapter connections", [] {
+        return static_cast<double>(muxConnections.load());
+    });
+    metrics().gauge("game_host_websocket_connections", "Open WebSocket connections from browsers", [this] {
+        return static_cast<double>(websocket_connections.load());
+    });
+}
+
+void Server::listen_websocket(int port) {
+    if ((ws_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        perror("WebSocket socket failed");
+        exit(EXIT_FAILURE);
+    }
+
+    int opt = 1;
+    setsockopt(ws_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(ws_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
+    struct sockaddr_in ws_address;
+    memset(&ws_address, 0, sizeof(ws_address));
+    ws_address.sin_family = AF_INET;
+    ws_address.sin_addr.s_addr = INADDR_ANY;
+    ws_address.sin_port = htons(port);
+
+    if (bind(ws_fd, (struct sockaddr*)&ws_address, sizeof(ws_address)) < 0 || listen(ws_fd, SOMAXCONN) < 0) {
+        perror("WebSocket listener failed");
+        exit(EXIT_FAILURE);
+    }
+    ws_port = port;
+    export_accept_queue(ws_fd, "listener=\"websocket\"");
+}
+
+int Server::accept_queue_length(int listen_fd) {
+    // On a listening socket tcpi_unacked is the current accept queue length
+    struct tcp_info info;
+    socklen_t length = sizeof(info);
+    if (getsockopt(listen_fd, IPPROTO_TCP, TCP_INFO, &info, &length) < 0) {
+        return 0;
+    }
+    return info.tcpi_unacked;
+}
+
+// Listeners with an accept queue gauge, by descriptor. Closing one under
+// the lock keeps a scrape from reading its descriptor after it is reused.
+static mutex listeners_mutex;
+static map<int, shared_ptr<int>> exported_listeners;
+
+void Server::export_accept_queue(int listen_fd, const string& labels) {
+    auto listener = make_shared<int>(listen_fd);
+    {
+        lock_guard<mutex> lock(listeners_mutex);
+        exported_listeners[listen_fd] = listener;
+    }
+    metrics().gauge("game_host_accept_queue_length", "Connections waiting to be accepted", [listener] {
+        lock_guard<mutex> lock(listeners_mutex);
+        return *listener < 0 ? 0.0 : static_cast<double>(accept_queue_length(*listener));
+    }, labels);
+}
+
+void Server::close_listener(int listen_fd) {
+    lock_guard<mutex> lock(listeners_mutex);
+    auto it = exported_listeners.find(listen_fd);
+    if (it != exported_listeners.end()) {
+        *it->second = -1;
+        exported_listeners.erase(it);
+    }
+    close(listen_fd);
+}
+
+// Latency of one command type, including any joker round trip it waits on
+static Histogram* command_latency(Action action) {
+    static Histogram* const* const table = [] {
+        static const char* const help = "Time to process one client command";
+        Histogram* other = metrics().histogram("game_host_command_duration_seconds", help, "command=\"OTHER\"");
+        Histogram** entries = new Histogram*[static_cast<int>(Action::COUNT)];
+        for (int i = 0; i < static_cast<int>(Action::COUNT); i++) {
+            entries[i] = other;
+        }
+        for (Action timed : {Action::START, Action::ANSWER, Action::JOKER, Action::REQUEST}) {
+            entries[static_cast<int>(timed)] = metrics().histogram(
+                "game_host_command_duration_seconds", help, string("command=\"") + action_name(timed) + "\"");
+        }
+        return entries;
+    }();
+    return table[static_cast<int>(action)];
 }
 
 void Server::setJokerClient(Joker* joker) {
     jokerClient = joker;
+    metrics().counter_callback("game_host_joker_registrations_saved_total",
+                               "Lifelines that registered their client without a separate REGISTER round trip",
+                               [joker] { return static_cast<double>(joker->registrations_saved()); });
+}
+
+void Server::setAnswerStats(AnswerStats* stats) {
+    answerStats.store(stats, memory_order_release);
+}
+
+void Server::setTimeouts(chrono::seconds idle, chrono::seconds registration, chrono::seconds answer) {
+    idle_timeout_ms = idle.count() > 0 ? chrono::duration_cast<chrono::milliseconds>(idle).count() : 0;
+    register_timeout_ms = registration.count() > 0 ? chrono::duration_cast<chrono::milliseconds>(registration).count() : 0;
+    answer_timeout_ms = answer.count() > 0 ? chrono::duration_cast<chrono::milliseconds>(answer).count() : 0;
+}
+
+void Server::stop(chrono::seconds drain_timeout) {
+    if (stopping.exchange(true)) {
+        return;
+    }
+    drain_deadline = (chrono::steady_clock::now() + drain_timeout).time_since_epoch().count();
+
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) < 0) {
+        perror("Stop notification failed");
+    }
+}
+
+// Thread mode: waits for open connections to finish their games. Past the
+// deadline, registered players are cut off; connections that never
+// registered are left to the process exit.
+void Server::wait_for_drain() {
+    if (active_connections > 0) {
+        LOG_INFO("Waiting for %d connection(s) to finish their games", active_connections.load());
+    }
+    while (active_connections > 0 && !past_drain_deadline()) {
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    if (active_connections == 0) {
+        LOG_INFO("All connections drained");
+        return;
+    }
+
+    LOG_WARN("Drain timeout with %d connection(s) open, closing them", active_connections.load());
+    sessions.for_each([](Session& session) {
+        shutdown(session.socket, SHUT_RDWR);
+    });
+    auto grace = chrono::steady_clock::now() + chrono::seconds(1);
+    while (active_connections > 0 && chrono::steady_clock::now() < grace) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
 }
 
 void Server::start() {
     // Connect to joker service
     if (jokerClient != nullptr) {
         if (!jokerClient->connect()) {
-            cout << "Warning: Failed to connect to joker service, lifelines will use fallback mode" << endl;
+            LOG_WARN("Failed to connect to joker service, lifelines will use fallback mode");
         }
     }
 
-    int addrlen = sizeof(address);
-    if (listen(server_fd, 3) < 0) {
+    if (listen(server_fd, SOMAXCONN) < 0) {
         perror("Listen failed");
         exit(EXIT_FAILURE);
     }
 
-    cout << "Waiting for a connection on port " << p << "...\n";
+    export_accept_queue(server_fd, "");
+
+    LOG_INFO("Waiting for a connection on port %d...", p);
+    if (ws_fd >= 0) {
+        LOG_INFO("Waiting for WebSocket connections on port %d...", ws_port);
+    }
+
+    // poll() skips the WebSocket entry while its fd is -1
+    struct pollfd fds[3] = {{server_fd, POLLIN, 0}, {stop_fd, POLLIN, 0}, {ws_fd, POLLIN, 0}};
     while (true) {
-        if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen)) < 0) {
-            perror("Accept failed");
-            exit(EXIT_FAILURE);
+        if (poll(fds, 3, -1) < 0) {
+            if (errno != EINTR) {
+                perror("poll failed");
+            }
+            continue;
         }
-        
-        cout << "Connection established with client!\n";
-
-        thread(&Server::handle_client, this, new_socket).detach(); 
-    }
-}
-
-// Helper function to parse commands coming from WebSocket adapter
-pair<string, string> parseCommand(const string& cmd) {
-    size_t colonPos = cmd.find(':');
-    if (colonPos == string::npos) {
-        return make_pair("UNKNOWN", "");
-    }
-    
-    string action = cmd.substr(0, colonPos);
-    string data = cmd.substr(colonPos + 1);
-    
-    // Further parse the data to separate client ID from actual data
-    size_t secondColonPos = data.find(':');
-    string clientId = data;
-    string payload = "";
-    
-    if (secondColonPos != string::npos) {
-        clientId = data.substr(0, secondColonPos);
-        payload = data.substr(secondColonPos + 1);
-    }
-    
-    return make_pair(action, clientId);
-}
-
-void Server::handle_client(int client_socket) {
-    string questions[5] = {
-        "1. When was Python created?",
-        "2. When was C++ released?",
-        "3. What is HTML?",
-        "4. What is TCP?",
-        "5. What is Client-Server?"
-    };
-    
-    string options[5][4] = {
-        {"A) 1991", "B) 2000", "C) 1989", "D) 2010"},
-        {"A) 1985", "B) 1990", "C) 2000", "D) 2010"},
-        {"A) Programming Language", "B) Web Markup Language", "C) Web Browser", "D) Database"},
-        {"A) Connection-Based", "B) Connectionless", "C) Fast", "D) Packaged"},
-        {"A) Data sharing on same computer", "B) Server-client relationship", "C) Network protocol", "D) Internet service provider"}
-    };
-    
-    string correct_answers[5] = {"A", "A", "B", "A", "B"};
-    string reward_messages[6] = {
-        "Loading the Lynch...",
-        "The important thing is to join",
-        "Two is greater than one",
-        "It wasn't easy getting here",
-        "You know your stuff!",
-        "You're amazing!"
-    };
-    
-    // First, check if this is a registration command
-    char cmd_buffer[1024] = {0};
-    int bytes_read = recv(client_socket, cmd_buffer, sizeof(cmd_buffer) - 1, 0);
-    
-    if (bytes_read <= 0) {
-        cout << "Client disconnected during registration" << endl;
-        close(client_socket);
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_connection(server_fd, false);
+        }
+        if (fds[2].revents & POLLIN) {
+            accept_connection(ws_fd, true);
+        }
+    }
+
+    // Connections the kernel already accepted would be reset when the
+    // listener closes; take them on too. A restarted instance bound with
+    // SO_REUSEPORT gets everything after this.
+    for (int listen_fd : {server_fd, ws_fd}) {
+        if (listen_fd < 0) {
+            continue;
+        }
+        fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL, 0) | O_NONBLOCK);
+        while ((new_socket = accept(listen_fd, nullptr, nullptr)) >= 0) {
+            connections_accepted->add();
+            active_connections++;
+            thread(&Server::handle_client, this, new_socket, listen_fd == ws_fd).detach();
+        }
+        close_listener(listen_fd);
+    }
+    LOG_INFO("Stopped accepting connections on port %d", p);
+
+    wait_for_drain();
+}
+
+// Thread mode: one thread per accepted connection
+void Server::accept_connection(int listen_fd, bool websocket) {
+    int addrlen = sizeof(address);
+    if ((new_socket = accept(listen_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen)) < 0) {
+        if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN) {
+            return;
+        }
+        // Out of descriptors or memory: keep serving the games in
+        // progress and retry shortly instead of spinning
+        accept_errors->add();
+        perror("Accept failed");
+        this_thread::sleep_for(chrono::milliseconds(100));
         return;
     }
-    
-    string cmd(cmd_buffer);
-    cout << "Received command: " << cmd << endl;
-    
-    // Parse the command to extract action and client ID
-    auto [action, clientId] = parseCommand(cmd);
-    
-    if (action == "CLIENT_ID") {
-        cout << "Registering client with WebSocket ID: " << clientId << endl;
-        clientSockets[clientId] = client_socket;
-        
-        // Send welcome message back to the client
-        string welcome_msg = "Welcome to the game server. You are now connected as " + clientId + "\n";
-        send(client_socket, welcome_msg.c_str(), welcome_msg.length(), 0);
-    }
-    
-    bool joker_used[2] = {false, false}; // [0] = Ask the Audience, [1] = 50:50
-    int score = 0;
-    bool game_over = false;
-    int current_question = 0;
-    string websocketClientId = clientId; // Store client ID for future communications
-    
-    // Main command processing loop
-    while (true) {
-        memset(cmd_buffer, 0, sizeof(cmd_buffer));
-        bytes_read = recv(client_socket, cmd_buffer, sizeof(cmd_buffer) - 1, 0);
-        
+    connections_accepted->add();
+
+    LOG_DEBUG("Connection established with client%s!", websocket ? " over WebSocket" : "");
+
+    active_connections++;
+    thread(&Server::handle_client, this, new_socket, websocket).detach();
+}
+
+void Server::start_reactor(int workers, bool reuse_port) {
+    // Connect to joker service
+    if (jokerClient != nullptr) {
+        if (!jokerClient->connect()) {
+            LOG_WARN("Failed to connect to joker service, lifelines will use fallback mode");
+        }
+    }
+
+    Reactor reactor(this, p, server_fd, ws_fd, workers, reuse_port);
+    reactor.run();
+}
+
+void Server::start_uring(int workers, bool reuse_port) {
+    string error;
+    if (!UringReactor::supported(error)) {
+        LOG_WARN("io_uring unavailable (%s), using the epoll reactor", error.c_str());
+        start_reactor(workers, reuse_port);
+        return;
+    }
+
+    // Connect to joker service
+    if (jokerClient != nullptr) {
+        if (!jokerClient->connect()) {
+            LOG_WARN("Failed to connect to joker service, lifelines will use fallback mode");
+        }
+    }
+
+    UringReactor reactor(this, p, server_fd, ws_fd, workers, reuse_port);
+    reactor.run();
+}
+
+// Question bank for new games with its pre-rendered reply fragments.
+// Replaced on reload; sessions keep the snapshot they were dealt from.
+SnapshotPtr<const PayloadCache> payloadCache;
+
+#define LADDER_SIZE QuestionBank::TIERS
+
+static const char* const reward_messages[LADDER_SIZE + 1] = {
+    "Loading the Lynch...",
+    "The important thing is to join",
+    "Two is greater than one",
+    "It wasn't easy getting here",
+    "You know your stuff!",
+    "You're amazing!"
+};
+
+// End-of-game replies, built once so answering allocates nothing
+static const vector<string> wrong_answer_replies = [] {
+    vector<string> replies;
+    for (const char* reward : reward_messages) {
+        replies.push_back(string("Wrong answer! ") + reward + "\n");
+    }
+    return replies;
+}();
+static const string win_reply = string("Congratulations! You've won the game! ") + reward_messages[LADDER_SIZE] + "\n";
+
+void Server::setQuestionBank(shared_ptr<const QuestionBank> bank) {
+    payloadCache.store(make_shared<const PayloadCache>(move(bank)));
+}
+
+// Picks the questions for a new game, one per difficulty tier. The draw is
+// driven by a generator seeded with seed alone, so logging the seed is
+// enough to replay a deal. Given the player's recent games, a question
+// from one of them is swapped for the next fresh one in its tier; this
+// takes O(1) steps for any bank with more than a handful of questions per
+// tier, and keeps the original pick in a tier with none fresh.
+void Server::deal_questions(Session& session, uint64_t seed, const GameHistory::Recent* recent) {
+    session.payloads = payloadCache.load();
+    session.bank = session.payloads->bank();
+    session.seed = seed;
+
+    FastRandom random(seed);
+    int games = recent != nullptr ? min(recent->games, GameHistory::RECENT_GAMES) : 0;
+
+    for (int tier = 0; tier < LADDER_SIZE; tier++) {
+        QuestionBank::IdRange questions = session.bank->tier_questions(tier);
+        uint32_t pick = random.below(static_cast<uint32_t>(questions.size()));
+
+        for (size_t step = 0; step < questions.size() && step <= GameHistory::RECENT_GAMES; step++) {
+            uint32_t id = questions[(pick + step) % questions.size()];
+            bool seen = false;
+            for (int game = 0; game < games; game++) {
+                seen = seen || recent->ladders[game][tier] == id;
+            }
+            if (!seen || step == GameHistory::RECENT_GAMES) {
+                pick = (pick + step) % questions.size();
+                break;
+            }
+        }
+        session.ladder[tier] = questions[pick];
+    }
+}
+
+// START[:<seed>] deals a fresh ladder and resets the game. An explicit seed
+// replays that deal exactly, ignoring the player's history; either way the
+// deal joins the history, which outlives the connection.
+void Server::start_game(Session& session, string_view payload) {
+    uint64_t seed = 0;
+    bool replay = !payload.empty() &&
+                  from_chars(payload.data(), payload.data() + payload.size(), seed).ec == errc();
+    if (!replay) {
+        seed = thread_random().next();
+    }
+
+    if (replay) {
+        deal_questions(session, seed, nullptr);
+    } else {
+        GameHistory::Recent recent = history.find(session.clientId);
+        deal_questions(session, seed, &recent);
+    }
+    history.record(session.clientId, session.ladder);
+
+    session.score = 0;
+    session.current_question = 0;
+    session.game_over = false;
+    memset(session.joker_used, 0, sizeof(session.joker_used));
+    start_countdown(session);
+
+    LOG_DEBUG("Starting new game for client: %s (seed %llu)", session.clientId.c_str(), (unsigned long long)seed);
+}
+
+void Server::send_message(Session& session, string_view msg) {
+    if (session.carrier != nullptr || session.upgraded) {
+        struct iovec buffer = {const_cast<char*>(msg.data()), msg.size()};
+        send_buffers(session, &buffer, 1);
+        return;
+    }
+    send_raw(session, msg);
+}
+
+void Server::send_raw(Session& session, string_view bytes) {
+    if (session.uring) {
+        // io_uring mode: sent with everything else the worker queued
+        // before it next enters the kernel
+        session.out += bytes;
+        UringReactor::queue_send(session);
+        return;
+    }
+    if (!session.nonblocking) {
+        send(session.socket, bytes.data(), bytes.size(), MSG_NOSIGNAL);
+        return;
+    }
+
+    // Reactor mode: queue behind anything still pending and flush what fits
+    session.out += bytes;
+    Reactor::flush(session);
+}
+
+static size_t total_length(const struct iovec* buffers, int count) {
+    size_t length = 0;
+    for (int i = 0; i < count; i++) {
+        length += buffers[i].iov_len;
+    }
+    return length;
+}
+
+// Gathers several buffers into one writev so cached payloads go out without
+// being copied into a message string first
+void Server::send_buffers(Session& session, const struct iovec* buffers, int count) {
+    if (session.carrier != nullptr) {
+        // A multiplexed player's reply goes out on the carrier behind a
+        // "MSG:<clientId>:<length>" header
+        char header[MAX_MUX_ID + 32];
+        int header_length = snprintf(header, sizeof(header), "MSG:%s:%zu\n", session.clientId.c_str(),
+                                     total_length(buffers, count));
+
+        struct iovec tagged[MAX_REPLY_BUFFERS];
+        tagged[0] = {header, static_cast<size_t>(header_length)};
+        int tagged_count = 1;
+        for (int i = 0; i < count && tagged_count < MAX_REPLY_BUFFERS; i++) {
+            tagged[tagged_count++] = buffers[i];
+        }
+        send_buffers(*session.carrier, tagged, tagged_count);
+        return;
+    }
+
+    // A WebSocket reply is one text message, its header written in front
+    // of the same buffers
+    struct iovec framed[MAX_REPLY_BUFFERS];
+    uint8_t frame_header[WebSocket::MAX_HEADER];
+    if (session.upgraded) {
+        size_t length = total_length(buffers, count);
+        framed[0] = {frame_header, WebSocket::encode_header(frame_header, WebSocket::Opcode::TEXT, length)};
+        int framed_count = 1;
+        for (int i = 0; i < count && framed_count < MAX_REPLY_BUFFERS; i++) {
+            framed[framed_count++] = buffers[i];
+        }
+        buffers = framed;
+        count = framed_count;
+    }
+
+    if (session.uring) {
+        // Gathered straight into the output the next send takes
+        for (int i = 0; i < count; i++) {
+            session.out.append(static_cast<const char*>(buffers[i].iov_base), buffers[i].iov_len);
+        }
+        UringReactor::queue_send(session);
+        return;
+    }
+
+    size_t skip = 0;
+    if (!session.nonblocking || session.out.empty()) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = const_cast<struct iovec*>(buffers);
+        msg.msg_iovlen = count;
+
+        ssize_t sent = sendmsg(session.socket, &msg, MSG_NOSIGNAL);
+        skip = sent > 0 ? sent : 0;
+    }
+
+    // Whatever was not written: thread mode finishes it with blocking sends,
+    // reactor mode queues it behind the socket
+    string rest;
+    for (int i = 0; i < count; i++) {
+        size_t length = buffers[i].iov_len;
+        if (skip >= length) {
+            skip -= length;
+            continue;
+        }
+        rest.append(static_cast<const char*>(buffers[i].iov_base) + skip, length - skip);
+        skip = 0;
+    }
+    if (!rest.empty()) {
+        send_raw(session, rest);
+    }
+}
+
+void Server::handle_client(int client_socket, bool websocket) {
+    // The connection's timeouts (its players' too, on a carrier); declared
+    // first so it outlives every Session armed on it
+    TimerWheel timers;
+    auto owner = make_shared<Session>();
+    Session& session = *owner;
+    session.socket = client_socket;
+    session.timers = &timers;
+    if (websocket) {
+        session.websocket = true;
+        session.in = FrameBuffer(WebSocket::MAX_HANDSHAKE);
+    }
+    touch(session);
+
+    bool connected = true;
+    while (connected) {
+        // Waits for the next read or timer. A carrier also watches for
+        // stop() so it can send GOAWAY while its adapter is idle.
+        bool watch_stop = session.multiplexed && !session.goaway_sent;
+        struct pollfd fds[2] = {{client_socket, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+        int ready = poll(fds, watch_stop ? 2 : 1, timers.timeout());
+
+        timers.advance(TimerWheel::now(), [this, &connected](Timer& timer) {
+            if (connected && !handle_timeout(*static_cast<Session*>(timer.owner), timer)) {
+                connected = false;
+            }
+        });
+        if (!connected || ready <= 0) {
+            continue;
+        }
+        if (watch_stop && (fds[1].revents & POLLIN) && !(fds[0].revents & POLLIN)) {
+            if (!notify_stopping(session)) {
+                handle_disconnect(session);
+                break;
+            }
+            continue;
+        }
+
+        int bytes_read = recv(client_socket, session.in.write_ptr(), session.in.writable(), 0);
+
         if (bytes_read <= 0) {
-            cout << "Client " << websocketClientId << " disconnected" << endl;
-            clientSockets.erase(websocketClientId);
+            handle_disconnect(session);
             break;
         }
-        
-        cmd = string(cmd_buffer);
-        cout << "Received command from " << websocketClientId << ": " << cmd << endl;
-        
-        auto [cmdAction, cmdClientId] = parseCommand(cmd);
-        
-        // Check if this is the same client or if we need to update our client ID
-        if (!cmdClientId.empty()) {
-            websocketClientId = cmdClientId;
+        session.in.commit(bytes_read);
+
+        if (session.websocket) {
+            connected = handle_websocket(session);
+        } else {
+            // One read may carry several pipelined commands, or only part of one
+            string_view cmd;
+            while (connected && session.in.next_frame(cmd)) {
+                connected = handle_frame(session, cmd);
+            }
+
+            if (connected && session.in.overflowed()) {
+                LOG_WARN("Command from %s exceeds buffer size, dropping client", session.clientId.c_str());
+                handle_disconnect(session);
+                break;
+            }
         }
-        
-        // Process different command types
-        if (cmdAction == "START") {
-            cout << "Starting new game for client: " << websocketClientId << endl;
-            
-            // Get available jokers from joker service
-            string available_jokers = "JOKERS:";
-            if (jokerClient != nullptr && jokerClient->is_connected) {
-                // Request available jokers from joker service
-                available_jokers += jokerClient->get_available_jokers();
-            } else {
-                // Use default jokers if joker service is not available
-                available_jokers += "Ask the Audience (S), 50:50 (Y)";
+        if (connected) {
+            touch(session);
+        }
+    }
+
+    // Game over, DISCONNECT or a dropped socket: the session is finished
+    if (session.multiplexed) {
+        handle_disconnect(session);
+    }
+    if (session.upgraded) {
+        websocket_connections--;
+    }
+    end_session(session);
+    cancel_timers(session);
+    close(client_socket);
+    active_connections--;
+}
+
+bool Server::handle_input(Session& session) {
+    if (session.websocket) {
+        if (!session.closing && !handle_websocket(session)) {
+            session.closing = true;
+        }
+    } else {
+        string_view cmd;
+        while (!session.closing && session.in.next_frame(cmd)) {
+            if (!handle_frame(session, cmd)) {
+                session.closing = true;
             }
-            
-            // Create a single message with all question data
-            stringstream all_data;
-            all_data << "ALL_QUESTIONS_DATA\n";
-            
-            // Add all questions and options
-            for (int i = 0; i < 5; i++) {
-                all_data << "QUESTION:" << i << ":" << questions[i] << "\n";
-                all_data << "OPTIONS:" << i << ":";
-                for (int j = 0; j < 4; j++) {
-                    all_data << options[i][j];
-                    if (j < 3) all_data << "|";
-                }
-                all_data << "\n";
+        }
+    }
+
+    if (!session.closing && session.in.overflowed()) {
+        LOG_WARN("Command from %s exceeds buffer size, dropping client", session.clientId.c_str());
+        handle_disconnect(session);
+        return false;
+    }
+    if (!session.closing) {
+        touch(session);
+    }
+    return true;
+}
+
+void Server::handle_disconnect(Session& session) {
+    if (session.multiplexed) {
+        // The adapter connection went away with every player on it
+        LOG_DEBUG("Multiplexed connection closed with %zu player(s)", session.players.size());
+        for (auto& entry : session.players) {
+            entry.second->closed = true;
+            handle_disconnect(*entry.second);
+        }
+        session.players.clear();
+        session.multiplexed = false;
+        muxConnections--;
+        return;
+    }
+    if (!session.registered) {
+        LOG_DEBUG("Client disconnected during registration");
+        return;
+    }
+    LOG_DEBUG("Client %s disconnected", session.clientId.c_str());
+    end_session(session);
+}
+
+void Server::end_session(Session& session) {
+    sessions.erase(session.registeredId, &session);
+    if (!session.joker_registered || jokerClient == nullptr) {
+        return;
+    }
+    session.joker_registered = false;
+
+    Joker::Request request;
+    request.action = JokerAction::DISCONNECT;
+    request.client_id = session.clientId;
+    jokerClient->submit_async(request, [](bool, const string&) {});
+}
+
+void Server::touch(Session& session) {
+    if (session.timers == nullptr || session.multiplexed) {
+        return;
+    }
+    if (!session.registered) {
+        // Counted from the connection, however slowly its bytes trickle in
+        if (!session.idle_timer.armed() && register_timeout_ms > 0) {
+            session.timers->arm(session.idle_timer, &session, register_timeout_ms);
+        }
+        return;
+    }
+    if (idle_timeout_ms > 0) {
+        session.timers->arm(session.idle_timer, &session, idle_timeout_ms);
+    } else {
+        session.idle_timer.cancel();
+    }
+}
+
+void Server::start_countdown(Session& session) {
+    if (session.timers == nullptr || answer_timeout_ms == 0 ||
+        session.game_over || session.current_question >= LADDER_SIZE) {
+        session.answer_timer.cancel();
+        return;
+    }
+    session.timers->arm(session.answer_timer, &session, answer_timeout_ms);
+}
+
+bool Server::handle_timeout(Session& session, Timer& timer) {
+    static Counter* registration_timeouts = metrics().counter(
+        "game_host_timeouts_total", "Sessions ended by a server-side timeout", "reason=\"registration\"");
+    static Counter* idle_timeouts = metrics().counter(
+        "game_host_timeouts_total", "Sessions ended by a server-side timeout", "reason=\"idle\"");
+    static Counter* answer_timeouts = metrics().counter(
+        "game_host_timeouts_total", "Sessions ended by a server-side timeout", "reason=\"answer\"");
+    static Counter* lifeline_timeouts = metrics().counter(
+        "game_host_timeouts_total", "Sessions ended by a server-side timeout", "reason=\"lifeline\"");
+
+    Session* carrier = session.carrier;
+    Session& connection = carrier != nullptr ? *carrier : session;
+
+    // joker_service did not answer a lifeline: its reply is dropped and the
+    // coroutine resumes with the fallback, even on a closing connection,
+    // so it does not wait forever
+    if (&timer == &session.lifeline_timer) {
+        shared_ptr<LifelineWait> wait = session.lifeline;
+        if (wait != nullptr && !wait->claimed.exchange(true)) {
+            lifeline_timeouts->add();
+            LOG_WARN("Lifeline for client %s timed out", session.clientId.c_str());
+            jokerClient->cancel(wait->request_id);
+            wait->timed_out = true;
+            ResumeQueue::current->post(wait->handle, connection.shared_from_this());
+        }
+        return true;
+    }
+
+    if (connection.closing) {
+        return false;
+    }
+
+    if (&timer == &session.answer_timer) {
+        answer_timeouts->add();
+        LOG_DEBUG("Client %s ran out of time on question %d", session.clientId.c_str(), session.current_question + 1);
+        session.game_over = true;
+        send_message(session, "Time's up! " + wrong_answer_replies[session.score]);
+    } else if (!session.registered) {
+        registration_timeouts->add();
+        LOG_DEBUG("Client did not register in time");
+    } else {
+        idle_timeouts->add();
+        LOG_DEBUG("Client %s idle for too long", session.clientId.c_str());
+        send_message(session, "Session closed after being idle for too long.\n");
+    }
+
+    end_session(session);
+    cancel_timers(session);
+    if (carrier == nullptr) {
+        if (session.upgraded) {
+            close_websocket(session, WebSocket::CLOSE_NORMAL);
+        }
+        return false;
+    }
+
+    // Only this player's game ends; the adapter hears it is gone
+    send_message(*carrier, "CLOSED:" + session.clientId + "\n");
+    session.closed = true;
+    carrier->players.erase(carrier->players.find(session.clientId));
+    return notify_stopping(*carrier);
+}
+
+void Server::cancel_timers(Session& session) {
+    session.idle_timer.cancel();
+    session.answer_timer.cancel();
+    for (auto& entry : session.players) {
+        cancel_timers(*entry.second);
+    }
+}
+
+bool Server::handle_websocket(Session& session) {
+    static Counter* upgrades = metrics().counter("game_host_websocket_upgrades_total", "WebSocket handshakes accepted");
+    static Counter* rejected = metrics().counter("game_host_websocket_rejected_total", "WebSocket handshakes rejected");
+
+    if (!session.upgraded) {
+        string_view key;
+        int consumed = WebSocket::parse_upgrade(session.in.peek(), key);
+        if (consumed == 0 && session.in.pending() < WebSocket::MAX_HANDSHAKE) {
+            return true;
+        }
+        if (consumed <= 0) {
+            rejected->add();
+            LOG_DEBUG("Rejected a WebSocket handshake");
+            send_raw(session, WebSocket::BAD_REQUEST);
+            return false;
+        }
+        send_raw(session, WebSocket::upgrade_response(key));
+        session.in.consume(consumed);
+        session.upgraded = true;
+        websocket_connections++;
+        upgrades->add();
+    }
+
+    WebSocket::Frame frame;
+    int consumed;
+    while ((consumed = WebSocket::decode(session.in.front(), session.in.pending(), frame)) > 0) {
+        bool open = handle_websocket_frame(session, frame);
+        session.in.consume(consumed);
+        if (!open) {
+            return false;
+        }
+    }
+    if (consumed < 0) {
+        LOG_WARN("WebSocket protocol error from %s, closing", session.clientId.c_str());
+        close_websocket(session, WebSocket::CLOSE_PROTOCOL_ERROR);
+        return false;
+    }
+    return true;
+}
+
+bool Server::handle_websocket_frame(Session& session, const WebSocket::Frame& frame) {
+    using WebSocket::Opcode;
+
+    // Browsers mask everything they send
+    if (!frame.masked) {
+        close_websocket(session, WebSocket::CLOSE_PROTOCOL_ERROR);
+        return false;
+    }
+
+    switch (frame.opcode) {
+    case Opcode::PING: {
+        string pong;
+        WebSocket::encode(pong, Opcode::PONG, frame.payload);
+        send_raw(session, pong);
+        return true;
+    }
+    case Opcode::PONG:
+        return true;
+    case Opcode::CLOSE:
+        // The browser left, as a DISCONNECT from the adapter would say
+        handle_disconnect(session);
+        close_websocket(session, WebSocket::CLOSE_NORMAL);
+        return false;
+    case Opcode::BINARY:
+        close_websocket(session, WebSocket::CLOSE_UNSUPPORTED);
+        return false;
+    default:
+        break;
+    }
+
+    // A TEXT frame starts a message, CONTINUATION frames extend it
+    if ((frame.opcode == Opcode::TEXT) == session.fragmented) {
+        close_websocket(session, WebSocket::CLOSE_PROTOCOL_ERROR);
+        return false;
+    }
+    string_view text = frame.payload;
+    if (!frame.fin || session.fragmented) {
+        if (session.message.size() + text.size() > WebSocket::MAX_PAYLOAD) {
+            close_websocket(session, WebSocket::CLOSE_TOO_BIG);
+            return false;
+        }
+        session.message.append(text);
+        session.fragmented = !frame.fin;
+        if (session.fragmented) {
+            return true;
+        }
+        text = session.message;
+    }
+
+    // One message may hold several command lines
+    bool open = true;
+    while (open && !text.empty()) {
+        size_t newline = text.find('\n');
+        string_view line = text.substr(0, newline);
+        text.remove_prefix(newline == string_view::npos ? text.size() : newline + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            open = handle_frame(session, line);
+        }
+    }
+    session.message.clear();
+
+    if (!open) {
+        close_websocket(session, WebSocket::CLOSE_NORMAL);
+    }
+    return open;
+}
+
+void Server::close_websocket(Session& session, uint16_t code) {
+    string close_frame;
+    WebSocket::encode_close(close_frame, code);
+    send_raw(session, close_frame);
+}
+
+bool Server::handle_frame(Session& session, string_view frame) {
+    Command command;
+    parse_command(frame, command);
+
+    if (session.multiplexed) {
+        return handle_mux_frame(session, frame, command);
+    }
+    if (!session.registered && command.action == Action::MUX) {
+        session.registered = true;
+        session.multiplexed = true;
+        muxConnections++;
+        // Its players time out instead, one by one
+        session.idle_timer.cancel();
+        LOG_INFO("Multiplexed connection from %.*s", (int)command.client_id.size(), command.client_id.data());
+        send_message(session, "MUX_READY\n");
+        return notify_stopping(session);
+    }
+    return handle_command(session, frame, command);
+}
+
+// Routes a carrier's frame to the player it names. A player whose game is
+// over (or who sent DISCONNECT) is dropped from the carrier, which stays
+// open for the others.
+bool Server::handle_mux_frame(Session& carrier, string_view frame, const Command& command) {
+    if (command.client_id.empty() || command.client_id.size() > MAX_MUX_ID) {
+        LOG_WARN("Multiplexed frame without a usable client ID: %.*s", (int)frame.size(), frame.data());
+        return true;
+    }
+
+    auto it = carrier.players.find(command.client_id);
+    if (it == carrier.players.end()) {
+        if (carrier.players.size() >= MAX_MUX_PLAYERS) {
+            // One adapter connection must not hold unbounded sessions; the
+            // player is told why and closed like a finished game
+            static Counter* rejected = metrics().counter("game_host_mux_players_rejected_total",
+                                                         "New players refused by a full multiplexed connection");
+            rejected->add();
+            LOG_WARN("Multiplexed connection full (%d players), rejecting %.*s", MAX_MUX_PLAYERS,
+                     (int)command.client_id.size(), command.client_id.data());
+            static const string error = "ERROR: Too many players on this connection\n";
+            string id(command.client_id);
+            send_message(carrier, "MSG:" + id + ":" + to_string(error.size()) + "\n" + error + "CLOSED:" + id + "\n");
+            return notify_stopping(carrier);
+        }
+        auto player = make_shared<Session>();
+        player->socket = carrier.socket;
+        player->carrier = &carrier;
+        player->timers = carrier.timers;
+        player->clientId = string(command.client_id);
+        it = carrier.players.emplace(player->clientId, move(player)).first;
+    }
+
+    Session& player = *it->second;
+    if (!handle_command(player, frame, command)) {
+        if (player.game_over) {
+            string closed = "CLOSED:" + player.clientId + "\n";
+            send_message(carrier, closed);
+        }
+        end_session(player);
+        player.closed = true;
+        cancel_timers(player);
+        carrier.players.erase(it);
+    } else {
+        touch(player);
+    }
+    return notify_stopping(carrier);
+}
+
+bool Server::notify_stopping(Session& session) {
+    if (!session.multiplexed || !stopping) {
+        return true;
+    }
+    if (!session.goaway_sent) {
+        session.goaway_sent = true;
+        send_message(session, "GOAWAY\n");
+    }
+    return !session.players.empty();
+}
+
+// Runs one command through the game state machine. Returns false once the
+// connection should be closed (game over or DISCONNECT).
+bool Server::handle_command(Session& session, string_view cmd, const Command& command) {
+    if (session.lifeline_pending) {
+        // Runs once the lifeline's reply is out, so replies stay in order
+        if (session.deferred.size() + cmd.size() >= MAX_DEFERRED) {
+            LOG_WARN("Client %s queued too many commands behind a lifeline, dropping it", session.clientId.c_str());
+            handle_disconnect(session);
+            return false;
+        }
+        session.deferred.append(cmd);
+        session.deferred += '\n';
+        return true;
+    }
+
+    // First, check if this is a registration command
+    if (!session.registered) {
+        session.registered = true;
+        LOG_TRACE("Received command: %.*s", (int)cmd.size(), cmd.data());
+
+        // Store client ID for future communications (a multiplexed player
+        // already has it, and its carrier keys on that string)
+        if (session.clientId != command.client_id) {
+            session.clientId = command.client_id;
+        }
+        deal_questions(session, thread_random().next(), nullptr);
+
+        if (command.action == Action::CLIENT_ID) {
+            LOG_DEBUG("Registering client with WebSocket ID: %s", session.clientId.c_str());
+            session.registeredId = session.clientId;
+            sessions.insert(session.registeredId, session.shared_from_this());
+
+            // Send welcome message back to the client
+            string welcome_msg = "Welcome to the game server. You are now connected as " + session.clientId + "\n";
+            send_message(session, welcome_msg);
+        }
+        return true;
+    }
+
+    LOG_TRACE("Received command from %s: %.*s", session.clientId.c_str(), (int)cmd.size(), cmd.data());
+    Histogram::Timer timer(command_latency(command.action));
+
+    // Check if this is the same client or if we need to update our client ID
+    if (!command.client_id.empty() && command.client_id != session.clientId) {
+        session.clientId = command.client_id;
+    }
+
+    int& current_question = session.current_question;
+
+    // Process different command types
+    switch (command.action) {
+    case Action::START: {
+        // Optional replay seed: "START:clientId:seed"
+        start_game(session, command.payload);
+
+        // Joker list is fetched once per joker service connection, not per game
+        shared_ptr<const string> jokers = jokerClient != nullptr ? jokerClient->cached_jokers() : nullptr;
+        static const string default_jokers = "Ask the Audience (S), 50:50 (Y)";
+        const string& available_jokers = jokers != nullptr ? *jokers : default_jokers;
+
+        // All question data goes out as one message built from cached fragments
+        static const char header[] = "ALL_QUESTIONS_DATA\n";
+        static const char jokers_prefix[] = "JOKERS:";
+        struct iovec buffers[LADDER_SIZE + 4];
+        int count = 0;
+
+        buffers[count++] = {const_cast<char*>(header), sizeof(header) - 1};
+        for (int i = 0; i < LADDER_SIZE; i++) {
+            string_view question = session.payloads->question(session.ladder[i]);
+            buffers[count++] = {const_cast<char*>(question.data()), question.size()};
+        }
+        buffers[count++] = {const_cast<char*>(jokers_prefix), sizeof(jokers_prefix) - 1};
+        buffers[count++] = {const_cast<char*>(available_jokers.data()), available_jokers.size()};
+        buffers[count++] = {const_cast<char*>("\n"), 1};
+
+        send_buffers(session, buffers, count);
+        break;
+    }
+    case Action::ANSWER:
+        // The answer is the payload's first letter (A, B, C, D)
+        if (!command.payload.empty()) {
+            string_view answer = command.payload.substr(0, 1);
+
+            if (current_question >= LADDER_SIZE) {
+                send_message(session, "Invalid answer. Please enter A, B, C, or D.\n");
             }
-            
-            // Add joker information
-            all_data << available_jokers << "\n";
-            
-            string data_str = all_data.str();
-            // Send all data in one TCP message and append a newline to ensure proper parsing
-            send(client_socket, data_str.c_str(), data_str.length(), 0);
-        }
-        else if (cmdAction == "ANSWER") {
-            // Extract the answer from the payload
-            size_t lastColonPos = cmd.find_last_of(':');
-            if (lastColonPos != string::npos && lastColonPos < cmd.length() - 1) {
-                string answer = cmd.substr(lastColonPos + 1);
-                answer = answer.substr(0, 1); // Get just the first letter (A, B, C, D)
-                
-                if (answer == "A" || answer == "B" || answer == "C" || answer == "D") {
-                    if (answer[0] == correct_answers[current_question][0]) {
-                        score = current_question + 1;
-                        string correct_msg = "Correct answer! \n";
-                        send(client_socket, correct_msg.c_str(), correct_msg.length(), 0);
-                        
-                        // Move to the next question
-                        current_question++;
-                        
-                        // If all questions answered correctly, display win message
-                        if (current_question >= 5) {
-                            string win_msg = "Congratulations! You've won the game! " + reward_messages[5] + "\n";
-                            send(client_socket, win_msg.c_str(), win_msg.length(), 0);
-                            game_over = true;
-                        }
+            else if (answer == "A" || answer == "B" || answer == "C" || answer == "D") {
+                AnswerStats* stats = answerStats.load(memory_order_acquire);
+                if (stats != nullptr && stats->counts(session.bank.get())) {
+                    stats->record(session.ladder[current_question], answer[0] - 'A');
+                }
+                if (answer[0] == session.bank->correct_answer(session.ladder[current_question])) {
+                    session.score = current_question + 1;
+                    send_message(session, "Correct answer! \n");
+
+                    // Move to the next question
+                    current_question++;
+
+                    // If all questions answered correctly, display win message
+                    if (current_question >= LADDER_SIZE) {
+                        send_message(session, win_reply);
+                        session.game_over = true;
                     } else {
-                        game_over = true;
-                        string wrong_msg = "Wrong answer! " + reward_messages[score] + "\n";
-                        send(client_socket, wrong_msg.c_str(), wrong_msg.length(), 0);
+                        start_countdown(session);
                     }
                 } else {
-                    string invalid_msg = "Invalid answer. Please enter A, B, C, or D.\n";
-                    send(client_socket, invalid_msg.c_str(), invalid_msg.length(), 0);
+                    session.game_over = true;
+                    send_message(session, wrong_answer_replies[session.score]);
                 }
+            } else {
+                send_message(session, "Invalid answer. Please enter A, B, C, or D.\n");
             }
         }
-        else if (cmdAction == "JOKER") {
-            // Extract joker type from the payload
-            size_t lastColonPos = cmd.find_last_of(':');
-            if (lastColonPos != string::npos && lastColonPos < cmd.length() - 1) {
-                string jokerType = cmd.substr(lastColonPos + 1);
-                
-                if (jokerType == "audience" && !joker_used[0]) {
-                    // Handle "Ask the Audience" joker
-                    string joker_response = process_audience_joker(current_question, websocketClientId);
-                    send(client_socket, joker_response.c_str(), joker_response.length(), 0);
-                    joker_used[0] = true;
-                } 
-                else if ((jokerType == "50-50" || jokerType == "Y") && !joker_used[1]) {
-                    // Handle "50:50" joker
-                    string joker_response = process_fifty_fifty_joker(current_question, correct_answers[current_question], websocketClientId);
-                    send(client_socket, joker_response.c_str(), joker_response.length(), 0);
-                    joker_used[1] = true;
-                }
-                else if (jokerType == "skip" && !joker_used[2]) {
-                    // Handle "skip" joker (if implemented)
-                    string joker_response = "Skip joker used. Moving to next question.\n";
-                    send(client_socket, joker_response.c_str(), joker_response.length(), 0);
-                    joker_used[2] = true;
-                    
-                    // Move to the next question
-                    current_question++;
-                }
-                else {
-                    string invalid_msg = "Invalid joker or joker already used.\n";
-                    send(client_socket, invalid_msg.c_str(), invalid_msg.length(), 0);
+        break;
+
+    case Action::JOKER:
+        // The payload names the joker
+        if (!command.payload.empty()) {
+            string_view jokerType = command.payload;
+            // Event loops must not wait for joker_service; without it the
+            // fallback answers at once anyway
+            bool lifelines_async = ResumeQueue::current != nullptr && jokerClient != nullptr && jokerClient->is_connected;
+
+            if (current_question >= LADDER_SIZE) {
+                send_message(session, "Invalid joker or joker already used.\n");
+            }
+            else if (jokerType == "audience" && !session.joker_used[0]) {
+                // Handle "Ask the Audience" joker
+                if (lifelines_async) {
+                    timer.cancel();
+                    run_lifeline(session.shared_from_this(), JokerAction::AUDIENCE, session.ladder[current_question], 0);
+                } else {
+                    send_message(session, process_audience_joker(session.ladder[current_question], session.clientId));
                 }
+                session.joker_used[0] = true;
+                session.joker_registered = !session.clientId.empty();
             }
-        }
-        else if (cmdAction == "REQUEST") {
-            // Client is requesting the current question again
-            if (current_question < 5 && !game_over) {
-                string question_msg = "QUESTION:" + to_string(current_question) + ":" + questions[current_question] + "\n";
-                question_msg += "OPTIONS:" + to_string(current_question) + ":";
-                
-                for (int j = 0; j < 4; j++) {
-                    question_msg += options[current_question][j];
-                    if (j < 3) question_msg += "|";
+            else if ((jokerType == "50-50" || jokerType == "Y") && !session.joker_used[1]) {
+                // Handle "50:50" joker
+                if (lifelines_async) {
+                    timer.cancel();
+                    run_lifeline(session.shared_from_this(), JokerAction::FIFTY_FIFTY, session.ladder[current_question],
+                                 session.bank->correct_answer(session.ladder[current_question]));
+                } else {
+                    send_message(session, process_fifty_fifty_joker(session.ladder[current_question], string(1, session.bank->correct_answer(session.ladder[current_question])), session.clientId));
                 }
-                question_msg += "\n";
-                
-                send(client_socket, question_msg.c_str(), question_msg.length(), 0);
+                session.joker_used[1] = true;
+                session.joker_registered = !session.clientId.empty();
+            }
+            else if (jokerType == "skip" && !session.joker_used[2]) {
+                // Handle "skip" joker (if implemented)
+                send_message(session, "Skip joker used. Moving to next question.\n");
+                session.joker_used[2] = true;
+
+                // Move to the next question
+                current_question++;
+                start_countdown(session);
+            }
+            else {
+                send_message(session, "Invalid joker or joker already used.\n");
             }
         }
-        else if (cmdAction == "DISCONNECT") {
-            cout << "Client " << websocketClientId << " requested disconnection" << endl;
-            clientSockets.erase(websocketClientId);
-            break;
+        break;
+
+    case Action::REQUEST:
+        // Client is requesting the current question again
+        if (current_question < LADDER_SIZE && !session.game_over) {
+            string_view question = session.payloads->question(session.ladder[current_question]);
+            struct iovec buffer = {const_cast<char*>(question.data()), question.size()};
+            send_buffers(session, &buffer, 1);
         }
-        
-        // Exit the loop if game is over
-        if (game_over) {
-            break;
+        break;
+
+    case Action::DISCONNECT:
+        LOG_DEBUG("Client %s requested disconnection", session.clientId.c_str());
+        end_session(session);
+        return false;
+
+    default:
+        break;
+    }
+
+    // Close the connection once the game is over
+    if (session.game_over) {
+        session.answer_timer.cancel();
+    }
+    return !session.game_over;
+}
+
+DetachedTask Server::run_lifeline(shared_ptr<Session> owner, JokerAction action, int question_id, char correct_answer) {
+    // Timed to the reply, as the blocking lifeline is
+    Histogram::Timer latency(command_latency(Action::JOKER));
+    Session& session = *owner;
+    Session& connection = session.carrier != nullptr ? *session.carrier : session;
+    session.lifeline_pending = true;
+
+    // The request points into this copy, which lives as long as the frame
+    string clientId = session.clientId;
+    Joker::Request request = jokerClient->lifeline_request(action, question_id, correct_answer, clientId);
+
+    // Sent once more if it fails, like the blocking call: the retry opens a
+    // connection to a restarted joker_service. One that timed out is not.
+    string reply;
+    bool timed_out = false;
+    for (int attempt = 0; attempt < 2 && reply.empty() && !timed_out; attempt++) {
+        JokerReply wait{session, request, connection.shared_from_this(), nullptr};
+        reply = co_await wait;
+        timed_out = wait.timed_out();
+        if (session.closed || connection.closing) {
+            latency.cancel();
+            co_return;
+        }
+    }
+
+    send_message(session, reply.empty() ? Joker::LIFELINE_FAILED : reply);
+    session.lifeline_pending = false;
+    run_deferred(session);
+}
+
+// Runs the commands a player sent while its lifeline was out, as its
+// connection would have. One may start another lifeline, which defers the
+// rest again.
+void Server::run_deferred(Session& session) {
+    Session& connection = session.carrier != nullptr ? *session.carrier : session;
+    string deferred;
+    deferred.swap(session.deferred);
+
+    string_view frames = deferred;
+    while (!frames.empty() && !connection.closing) {
+        size_t newline = frames.find('\n');
+        string_view frame = frames.substr(0, newline);
+        frames.remove_prefix(newline + 1);
+
+        if (!handle_frame(connection, frame)) {
+            if (connection.upgraded) {
+                close_websocket(connection, WebSocket::CLOSE_NORMAL);
+            }
+            connection.closing = true;
         }
     }
-    
-    close(client_socket);
 }
 
-string Server::process_audience_joker(int question_index, const string& clientId) {
+string Server::process_audience_joker(int question_id, const string& clientId) {
     if (jokerClient != nullptr && jokerClient->is_connected) {
-        // Register client if not already done
-        jokerClient->register_client(clientId);
-        
-        // Use the new version that passes client ID
-        return jokerClient->request_audience_help(question_index, clientId);
+        // The request carries the client ID, which registers it on the joker side
+        return jokerClient->request_audience_help(question_id, clientId);
     } else {
         // Fallback if joker client is not available
         string percentages[4] = {"40%", "25%", "30%", "5%"};
@@ -322,13 +1258,10 @@ string Server::process_audience_joker(int question_index, const string& clientId
     }
 }
 
-string Server::process_fifty_fifty_joker(int question_index, string correct_answer, const string& clientId) {
+string Server::process_fifty_fifty_joker(int question_id, string correct_answer, const string& clientId) {
     if (jokerClient != nullptr && jokerClient->is_connected) {
-        // Register client if not already done
-        jokerClient->register_client(clientId);
-        
-        // Use the new version that passes client ID
-        return jokerClient->request_fifty_fifty(question_index, correct_answer[0], clientId);
+        // The request carries the client ID, which registers it on the joker side
+        return jokerClient->request_fifty_fifty(question_id, correct_answer[0], clientId);
     } else {
         // Fallback if joker client is not available
         char options[4] = {'A', 'B', 'C', 'D'};
@@ -340,7 +1273,7 @@ string Server::process_fifty_fifty_joker(int question_index, string correct_answ
         // Add one more random incorrect option
         int random_option;
         do {
-            random_option = rand() % 4;
+            random_option = thread_random().below(4);
         } while (options[random_option] == correct_answer[0]);
         
         remaining_options += options[random_option];
@@ -0,0 +1,53 @@
+#include "session_registry.h"
+
+using namespace std;
+
+SessionRegistry::Shard& SessionRegistry::shard_for(const string& clientId) {
+    return shards[hash<string>()(clientId) % SHARDS];
+}
+
+void SessionRegistry::insert(const string& clientId, shared_ptr<Session> session) {
+    Shard& shard = shard_for(clientId);
+    lock_guard<mutex> lock(shard.lock);
+    shard.sessions[clientId] = move(session);
+}
+
+shared_ptr<Session> SessionRegistry::find(const string& clientId) {
+    Shard& shard = shard_for(clientId);
+    lock_guard<mutex> lock(shard.lock);
+    auto it = shard.sessions.find(clientId);
+    return it == shard.sessions.end() ? nullptr : it->second;
+}
+
+bool SessionRegistry::erase(const string& clientId, const Session* session) {
+    Shard& shard = shard_for(clientId);
+    shared_ptr<Session> removed;  // released after the lock is dropped
+    {
+        lock_guard<mutex> lock(shard.lock);
+        auto it = shard.sessions.find(clientId);
+        if (it == shard.sessions.end() || it->second.get() != session) {
+            return false;
+        }
+        removed = move(it->second);
+        shard.sessions.erase(it);
+    }
+    return true;
+}
+
+void SessionRegistry::for_each(const function<void(Session&)>& visit) {
+    for (Shard& shard : shards) {
+        lock_guard<mutex> lock(shard.lock);
+        for (auto& entry : shard.sessions) {
+            visit(*entry.second);
+        }
+    }
+}
+
+size_t SessionRegistry::size() {
+    size_t total = 0;
+    for (Shard& shard : shards) {
+        lock_guard<mutex> lock(shard.lock);
+        total += shard.sessions.size();
+    }
+    return total;
+}
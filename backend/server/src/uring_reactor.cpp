@@ -0,0 +1,528 @@
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "logger.h"
+#include "metrics.h"
+#include "reactor.h"
+#include "server.h"
+#include "uring.h"
+#include "uring_reactor.h"
+
+using namespace std;
+
+#define URING_ENTRIES 256       // SQEs per worker ring
+#define URING_BUFFERS 512       // provided receive buffers per worker
+#define URING_BUFFER_SIZE 4096
+
+// What a completion belongs to, with the socket (IoUring::tag)
+enum : uint32_t {
+    OP_ACCEPT = 1,
+    OP_ACCEPT_WEBSOCKET,
+    OP_ACCEPT_RETRY,
+    OP_RECV,
+    OP_SEND,
+    OP_STOP,
+    OP_CANCEL,
+    OP_TICK,
+    OP_RESUME,
+    OP_TIMER,
+};
+
+// While draining, how often the loop wakes up to check the deadline; also
+// the pause before re-arming an accept that failed (out of descriptors)
+static const __kernel_timespec TICK = {0, 100 * 1000 * 1000};
+
+thread_local UringReactor::Worker* UringReactor::current = nullptr;
+
+UringReactor::UringReactor(Server* server, int port, int server_fd, int ws_fd, int worker_count, bool reuse_port) {
+    this->server = server;
+    this->port = port;
+    this->server_fd = server_fd;
+    this->ws_fd = ws_fd;
+    this->reuse_port = reuse_port;
+
+    if (worker_count < 1) {
+        worker_count = 1;
+    }
+    for (int i = 0; i < worker_count; i++) {
+        auto worker = make_unique<Worker>();
+        worker->id = i;
+        workers.push_back(move(worker));
+    }
+}
+
+bool UringReactor::supported(string& error) {
+    // A ring belongs to the thread that set it up, so this one is only a
+    // probe; every worker sets up its own
+    IoUring ring;
+    BufferRing buffers;
+    return ring.init(8, error) && buffers.init(ring, 0, 8, 64, error);
+}
+
+void UringReactor::run() {
+    if (listen(server_fd, SOMAXCONN) < 0) {
+        perror("Listen failed");
+        exit(EXIT_FAILURE);
+    }
+    // Only the accept4() calls that empty the queue on stop use these
+    // directly; the rings accept asynchronously either way
+    if (fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL, 0) | O_NONBLOCK) < 0) {
+        perror("Nonblocking listen socket failed");
+        exit(EXIT_FAILURE);
+    }
+    if (ws_fd >= 0 && fcntl(ws_fd, F_SETFL, fcntl(ws_fd, F_GETFL, 0) | O_NONBLOCK) < 0) {
+        perror("Nonblocking WebSocket socket failed");
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned cpus = thread::hardware_concurrency();
+
+    for (auto& worker : workers) {
+        worker->listen_fd = server_fd;
+        if (reuse_port && worker->id > 0) {
+            int fd = Reactor::open_listener(port);
+            if (fd >= 0) {
+                worker->listen_fd = fd;
+            }
+        }
+        if (worker->listen_fd == server_fd) {
+            shared_listeners++;
+        }
+        if (worker->id == 0 || worker->listen_fd != server_fd) {
+            Server::export_accept_queue(worker->listen_fd, reuse_port ? "listener=\"" + to_string(worker->id) + "\"" : "");
+        }
+        if (ws_fd >= 0) {
+            ws_listeners++;
+        }
+    }
+
+    LOG_INFO("io_uring reactor waiting for connections on port %d with %zu worker(s)%s...",
+             port, workers.size(), reuse_port ? " (SO_REUSEPORT)" : "");
+
+    for (auto& worker : workers) {
+        Worker* w = worker.get();
+        w->thread = thread(&UringReactor::run_worker, this, ref(*w));
+
+        if (cpus > 0) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(w->id % cpus, &cpuset);
+            pthread_setaffinity_np(w->thread.native_handle(), sizeof(cpuset), &cpuset);
+        }
+    }
+
+    for (auto& worker : workers) {
+        worker->thread.join();
+        if (worker->resumes != nullptr) {
+            worker->resumes->close();
+        }
+    }
+}
+
+void UringReactor::run_worker(Worker& worker) {
+    static Counter* enters = metrics().counter("game_host_io_uring_enters_total",
+                                               "io_uring_enter calls made by the io_uring workers");
+    static Counter* completions = metrics().counter("game_host_io_uring_completions_total",
+                                                    "Completions handled by the io_uring workers");
+
+    IoUring ring;
+    BufferRing buffers;
+    string error;
+    if (!ring.init(URING_ENTRIES, error) || !buffers.init(ring, 0, URING_BUFFERS, URING_BUFFER_SIZE, error)) {
+        LOG_ERROR("Worker %d: %s", worker.id, error.c_str());
+        exit(EXIT_FAILURE);
+    }
+    worker.ring = &ring;
+    worker.buffers = &buffers;
+    worker.resumes = make_shared<ResumeQueue>();
+    current = &worker;
+    ResumeQueue::current = worker.resumes;
+
+    ring.prep_accept_multishot(worker.listen_fd, IoUring::tag(OP_ACCEPT, worker.listen_fd));
+    worker.listeners++;
+    if (ws_fd >= 0) {
+        ring.prep_accept_multishot(ws_fd, IoUring::tag(OP_ACCEPT_WEBSOCKET, ws_fd));
+        worker.listeners++;
+    }
+    // Every worker hears about stop(): the eventfd stays readable
+    ring.prep_poll(server->stop_fd, POLLIN, IoUring::tag(OP_STOP, 0));
+    ring.prep_poll(worker.resumes->fd(), POLLIN, IoUring::tag(OP_RESUME, 0));
+
+    bool cut_off = false;
+    uint64_t reported = 0;
+    // The wait for the session timers: one timeout in flight, due at
+    // timer_due, plus another whenever a timer is armed to expire sooner
+    __kernel_timespec timer_wait = {0, 0};
+    uint64_t timer_due = 0;
+    while (true) {
+        flush(worker);
+
+        int timeout = worker.timers.timeout();
+        if (timeout >= 0) {
+            uint64_t now = TimerWheel::now();
+            uint64_t due = now + timeout;
+            if (timer_due <= now || due < timer_due) {
+                timer_wait.tv_sec = timeout / 1000;
+                timer_wait.tv_nsec = static_cast<long long>(timeout % 1000) * 1000 * 1000;
+                ring.prep_timeout(&timer_wait, IoUring::tag(OP_TIMER, 0));
+                timer_due = due;
+            }
+        }
+
+        if (worker.draining && worker.listeners == 0 && worker.sessions.empty() && worker.closed.empty()) {
+            return;
+        }
+        if (worker.draining && !cut_off && server->past_drain_deadline()) {
+            LOG_WARN("Worker %d: drain timeout with %zu session(s) open, closing them", worker.id, worker.sessions.size());
+            vector<int> open;
+            for (auto& entry : worker.sessions) {
+                open.push_back(entry.first);
+            }
+            for (int fd : open) {
+                server->handle_disconnect(*worker.sessions[fd]);
+                close_client(worker, fd);
+            }
+            cut_off = true;
+            continue;
+        }
+
+        int result = ring.submit_and_wait(1);
+        if (result < 0 && result != -EBUSY && result != -EAGAIN) {
+            errno = -result;
+            perror("io_uring_enter failed");
+            return;
+        }
+        enters->add(ring.enters - reported);
+        reported = ring.enters;
+
+        uint64_t handled = 0;
+        while (io_uring_cqe* entry = ring.peek()) {
+            io_uring_cqe cqe = *entry;
+            ring.advance();
+            handle_completion(worker, cqe.user_data, cqe.res, cqe.flags);
+            handled++;
+        }
+        completions->add(handled);
+        worker.timers.advance(TimerWheel::now(), [this, &worker](Timer& timer) { expired(worker, timer); });
+    }
+}
+
+void UringReactor::handle_completion(Worker& worker, uint64_t user_data, int result, uint32_t flags) {
+    uint32_t op = IoUring::tag_op(user_data);
+    int fd = IoUring::tag_fd(user_data);
+
+    switch (op) {
+    case OP_ACCEPT:
+    case OP_ACCEPT_WEBSOCKET:
+        if (result >= 0) {
+            server->connections_accepted->add();
+            add_client(worker, result, op == OP_ACCEPT_WEBSOCKET);
+        } else if (result != -ECANCELED) {
+            // Out of descriptors or similar: keep serving existing sessions
+            server->accept_errors->add();
+            LOG_WARN("Accept failed: %s", strerror(-result));
+        }
+        if (flags & IORING_CQE_F_MORE) {
+            return;
+        }
+        if (worker.draining) {
+            stop_accepting(worker, fd);
+        } else if (result < 0) {
+            worker.ring->prep_timeout(&TICK, IoUring::tag(OP_ACCEPT_RETRY, fd));
+        } else {
+            worker.ring->prep_accept_multishot(fd, user_data);
+        }
+        return;
+
+    case OP_ACCEPT_RETRY:
+        if (worker.draining) {
+            stop_accepting(worker, fd);
+        } else {
+            worker.ring->prep_accept_multishot(fd, IoUring::tag(fd == ws_fd ? OP_ACCEPT_WEBSOCKET : OP_ACCEPT, fd));
+        }
+        return;
+
+    case OP_STOP:
+        if (!worker.draining) {
+            worker.draining = true;
+            LOG_DEBUG("Worker %d draining %zu session(s)", worker.id, worker.sessions.size());
+            // The accepts end with -ECANCELED, then the listeners are closed
+            worker.ring->prep_cancel(IoUring::tag(OP_ACCEPT, worker.listen_fd), IoUring::tag(OP_CANCEL, 0));
+            if (ws_fd >= 0) {
+                worker.ring->prep_cancel(IoUring::tag(OP_ACCEPT_WEBSOCKET, ws_fd), IoUring::tag(OP_CANCEL, 0));
+            }
+            worker.ring->prep_timeout(&TICK, IoUring::tag(OP_TICK, 0));
+            notify_carriers(worker);
+        }
+        return;
+
+    case OP_RESUME:
+        worker.resumes->run([this, &worker](Session& session) { resumed(worker, session); });
+        worker.ring->prep_poll(worker.resumes->fd(), POLLIN, IoUring::tag(OP_RESUME, 0));
+        return;
+
+    case OP_TIMER:
+        // The loop runs whatever timers are due after every batch
+        return;
+
+    case OP_TICK:
+        // Nothing to do but look at the deadline again
+        worker.ring->prep_timeout(&TICK, IoUring::tag(OP_TICK, 0));
+        return;
+
+    case OP_RECV:
+    case OP_SEND: {
+        auto it = worker.sessions.find(fd);
+        if (it != worker.sessions.end()) {
+            if (op == OP_RECV) {
+                read_client(worker, *it->second, result, flags);
+            } else {
+                sent(worker, *it->second, result);
+            }
+            return;
+        }
+
+        // The session is gone; the socket closes with its last request
+        it = worker.closed.find(fd);
+        if (it == worker.closed.end()) {
+            return;
+        }
+        if (flags & IORING_CQE_F_BUFFER) {
+            worker.buffers->recycle(static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT));
+        }
+        if (op == OP_SEND || !(flags & IORING_CQE_F_MORE)) {
+            release(worker, *it->second);
+        }
+        return;
+    }
+
+    default:
+        return;
+    }
+}
+
+// Takes on whatever is left in a listener's accept queue once its accept
+// was cancelled, then closes it; the shared sockets are closed by the last
+// worker that accepted on them
+void UringReactor::stop_accepting(Worker& worker, int listen_fd) {
+    bool websocket = listen_fd == ws_fd;
+    int fd;
+    while ((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        server->connections_accepted->add();
+        add_client(worker, fd, websocket);
+    }
+
+    if (websocket) {
+        if (--ws_listeners == 0) {
+            Server::close_listener(ws_fd);
+        }
+    } else if (listen_fd != server_fd || --shared_listeners == 0) {
+        Server::close_listener(listen_fd);
+    }
+    worker.listeners--;
+}
+
+// Sends GOAWAY on the worker's multiplexed connections and closes those
+// without players
+void UringReactor::notify_carriers(Worker& worker) {
+    vector<int> idle;
+    for (auto& entry : worker.sessions) {
+        Session& session = *entry.second;
+        if (session.multiplexed && !server->notify_stopping(session)) {
+            session.closing = true;
+            if (session.out.empty() && session.sending.empty()) {
+                idle.push_back(entry.first);
+            }
+        }
+    }
+    for (int fd : idle) {
+        close_client(worker, fd);
+    }
+}
+
+void UringReactor::add_client(Worker& worker, int fd, bool websocket) {
+    auto session = make_shared<Session>();
+    session->socket = fd;
+    session->nonblocking = true;
+    session->uring = true;
+    session->timers = &worker.timers;
+    if (websocket) {
+        session->websocket = true;
+        session->in = FrameBuffer(WebSocket::MAX_HANDSHAKE);
+    }
+    server->touch(*session);
+
+    worker.ring->prep_recv_multishot(fd, worker.buffers->id(), IoUring::tag(OP_RECV, fd));
+    session->uring_ops = 1;
+
+    worker.sessions[fd] = move(session);
+    LOG_DEBUG("Connection established with client!");
+}
+
+void UringReactor::read_client(Worker& worker, Session& session, int result, uint32_t flags) {
+    int fd = session.socket;
+    bool more = flags & IORING_CQE_F_MORE;
+    if (!more) {
+        session.uring_ops--;
+    }
+
+    if (result == -ENOBUFS) {
+        // Every buffer was taken; they are back once this batch is handled
+        worker.ring->prep_recv_multishot(fd, worker.buffers->id(), IoUring::tag(OP_RECV, fd));
+        session.uring_ops++;
+        return;
+    }
+    if (result <= 0) {
+        server->handle_disconnect(session);
+        close_client(worker, fd);
+        return;
+    }
+
+    // The buffer goes back to the kernel right after its bytes are copied
+    // into the session's, which keep any partial command
+    uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+    const char* data = worker.buffers->buffer(bid);
+    size_t left = result;
+    bool open = true;
+    while (open && left > 0 && !session.closing) {
+        size_t n = min(left, session.in.writable());
+        if (n == 0) {
+            LOG_WARN("Command from %s exceeds buffer size, dropping client", session.clientId.c_str());
+            server->handle_disconnect(session);
+            open = false;
+            break;
+        }
+        memcpy(session.in.write_ptr(), data, n);
+        session.in.commit(n);
+        data += n;
+        left -= n;
+        open = server->handle_input(session);
+    }
+    worker.buffers->recycle(bid);
+
+    if (!open || (session.closing && session.out.empty() && session.sending.empty())) {
+        close_client(worker, fd);
+        return;
+    }
+    if (!more && !session.closing) {
+        worker.ring->prep_recv_multishot(fd, worker.buffers->id(), IoUring::tag(OP_RECV, fd));
+        session.uring_ops++;
+    }
+}
+
+void UringReactor::sent(Worker& worker, Session& session, int result) {
+    int fd = session.socket;
+    session.uring_ops--;
+
+    if (result < 0) {
+        server->handle_disconnect(session);
+        close_client(worker, fd);
+        return;
+    }
+    if (static_cast<size_t>(result) < session.sending.size()) {
+        // Short send: the rest goes first, anything newer waits in out
+        session.sending.erase(0, result);
+        worker.ring->prep_send(fd, session.sending.data(), session.sending.size(), IoUring::tag(OP_SEND, fd));
+        session.uring_ops++;
+        return;
+    }
+
+    session.sending.clear();
+    if (!session.out.empty()) {
+        queue_send(session);
+    } else if (session.closing) {
+        close_client(worker, fd);
+    }
+}
+
+void UringReactor::queue_send(Session& session) {
+    if (!session.send_queued) {
+        session.send_queued = true;
+        current->dirty.push_back(session.socket);
+    }
+}
+
+// Turns the output queued since the last submission into sends, at most one
+// in flight per socket
+void UringReactor::flush(Worker& worker) {
+    for (int fd : worker.dirty) {
+        auto it = worker.sessions.find(fd);
+        if (it == worker.sessions.end()) {
+            continue;
+        }
+        Session& session = *it->second;
+        session.send_queued = false;
+        if (!session.sending.empty() || session.out.empty()) {
+            continue;
+        }
+        session.sending.swap(session.out);
+        worker.ring->prep_send(fd, session.sending.data(), session.sending.size(), IoUring::tag(OP_SEND, fd));
+        session.uring_ops++;
+    }
+    worker.dirty.clear();
+}
+
+// A lifeline finished on the session's connection, and the commands that
+// waited for it may have ended the game
+void UringReactor::resumed(Worker& worker, Session& session) {
+    if (!session.closed && session.closing && session.out.empty() && session.sending.empty()) {
+        close_client(worker, session.socket);
+    }
+}
+
+// A session's or player's timer ran out; the connection closes once the
+// reply telling it why has gone out
+void UringReactor::expired(Worker& worker, Timer& timer) {
+    Session& session = *static_cast<Session*>(timer.owner);
+    Session& connection = session.carrier != nullptr ? *session.carrier : session;
+    if (!server->handle_timeout(session, timer)) {
+        connection.closing = true;
+    }
+    if (!connection.closed && connection.closing && connection.out.empty() && connection.sending.empty()) {
+        close_client(worker, connection.socket);
+    }
+}
+
+// Ends a session. Its socket stays open while requests on it are in flight,
+// so the descriptor cannot be reused under them; shutting it down makes
+// them complete.
+void UringReactor::close_client(Worker& worker, int fd) {
+    auto it = worker.sessions.find(fd);
+    if (it == worker.sessions.end()) {
+        return;
+    }
+    shared_ptr<Session> session = move(it->second);
+    worker.sessions.erase(it);
+    session->closed = true;
+    Server::cancel_timers(*session);
+
+    if (session->multiplexed) {
+        server->handle_disconnect(*session);
+    }
+    if (session->upgraded) {
+        server->websocket_connections--;
+    }
+    server->end_session(*session);
+
+    if (session->uring_ops == 0) {
+        close(fd);
+        return;
+    }
+    shutdown(fd, SHUT_RDWR);
+    worker.closed[fd] = move(session);
+}
+
+void UringReactor::release(Worker& worker, Session& session) {
+    if (--session.uring_ops > 0) {
+        return;
+    }
+    int fd = session.socket;
+    close(fd);
+    worker.closed.erase(fd);
+}
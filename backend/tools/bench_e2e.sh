@@ -0,0 +1,51 @@
+#!/bin/bash
+# End-to-end benchmark: starts joker_service and game_host, runs loadgen
+# scenarios against them and saves each result next to the previous run.
+#
+# Usage: tools/bench_e2e.sh BIN_DIR [RESULTS_DIR] [-- extra game_host options]
+#   BIN_DIR      directory holding game_host, joker_service and loadgen
+#   RESULTS_DIR  where <scenario>.txt results are kept (default bench-results);
+#                an existing file is used as the baseline for that scenario
+# DURATION overrides the measured seconds per scenario (default 10).
+set -e
+
+BIN=${1:?usage: bench_e2e.sh BIN_DIR [RESULTS_DIR] [-- game_host options]}
+RESULTS=${2:-bench-results}
+shift $(( $# >= 2 ? 2 : 1 ))
+[ "$1" = "--" ] && shift
+
+BACKEND=$(cd "$(dirname "$0")/.." && pwd)
+QUESTIONS="$BACKEND/data/questions.txt"
+mkdir -p "$RESULTS"
+
+# name|loadgen options
+SCENARIOS=(
+    "steady|--players=200 --think=50 --lifeline-rate=0.2"
+    "lifelines|--players=200 --think=50 --lifeline-rate=1"
+    "burst|--players=1000 --think=5 --ramp=200"
+)
+
+"$BIN/joker_service" --questions="$QUESTIONS" > /dev/null &
+JOKER=$!
+sleep 0.3
+"$BIN/game_host" --questions="$QUESTIONS" "$@" > /dev/null &
+HOST=$!
+# game_host first, so joker_service's port is not left in TIME_WAIT
+trap 'kill $HOST 2>/dev/null; sleep 0.2; kill $JOKER 2>/dev/null' EXIT
+sleep 0.5
+
+for scenario in "${SCENARIOS[@]}"; do
+    name=${scenario%%|*}
+    options=${scenario#*|}
+    echo "== $name: $options"
+
+    baseline=()
+    if [ -f "$RESULTS/$name.txt" ]; then
+        cp "$RESULTS/$name.txt" "$RESULTS/$name.previous.txt"
+        baseline=(--baseline="$RESULTS/$name.previous.txt")
+    fi
+    # shellcheck disable=SC2086
+    "$BIN/loadgen" $options --duration=${DURATION:-10} --questions="$QUESTIONS" --seed=1 \
+        --save="$RESULTS/$name.txt" "${baseline[@]}"
+    echo
+done
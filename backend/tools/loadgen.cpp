@@ -0,0 +1,919 @@
+// Load generator for game_host. Simulates concurrent players speaking the
+// adapter's TCP protocol (CLIENT_ID, START, JOKER, ANSWER) and reports
+// throughput, latency percentiles and error rates.
+//
+// Usage: loadgen [options]
+//   --host=ADDR          game_host address (default 127.0.0.1)
+//   --port=N             game_host port (default 4337)
+//   --players=N          concurrent players (default 100)
+//   --threads=N          event loop threads (default 1)
+//   --duration=S         measured seconds (default 10)
+//   --warmup=S           seconds before measuring starts (default 1)
+//   --ramp=MS            spread the first connects over MS (default 1000)
+//   --think=MS           mean think time between commands (default 50)
+//   --think-dist=D       fixed, uniform (0..2*mean) or exp (default exp)
+//   --lifeline-rate=P    chance of using a lifeline on a question (default 0.2)
+//   --questions=PATH     bank to look up correct answers; without it players
+//                        answer at random
+//   --accuracy=P         chance of answering correctly with a bank (default 0.8)
+//   --timeout=MS         response timeout (default 5000)
+//   --seed=N             seed for think times and choices
+//   --save=FILE          write the results as "key value" lines
+//   --baseline=FILE      compare the results against a file written by --save
+//   --mux=N              carry each thread's players over N multiplexed
+//                        connections (MUX) instead of one connection per game
+//   --ws=PORT            connect players over WebSocket to game_host's
+//                        --ws-port instead, as browsers without the adapter do
+//
+// Each game is one connection: register, START, then one command per
+// question until the game is lost or won, after which the player
+// reconnects. With --mux a game is the same sequence of commands on a
+// shared connection, and replies arrive as "MSG:<clientId>:<length>" frames.
+// With --ws each game is a WebSocket connection whose text messages carry
+// the same lines; its connect latency includes the upgrade. Latency is
+// measured from sending a command to receiving the last line of its
+// response.
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "frame_buffer.h"
+#include "metrics.h"
+#include "question_bank.h"
+#include "random.h"
+#include "websocket.h"
+
+using namespace std;
+
+#define LADDER_SIZE QuestionBank::TIERS
+#define MAX_EVENTS 256
+#define CARRIER_TAG (1ull << 63)    // epoll data of a multiplexed connection
+
+struct Options {
+    string host = "127.0.0.1";
+    int port = 4337;
+    int players = 100;
+    int threads = 1;
+    double duration = 10;
+    double warmup = 1;
+    int ramp_ms = 1000;
+    double think_ms = 50;
+    string think_dist = "exp";
+    double lifeline_rate = 0.2;
+    string questions;
+    double accuracy = 0.8;
+    int timeout_ms = 5000;
+    uint64_t seed = 0;
+    string save;
+    string baseline;
+    int mux = 0;
+    int ws_port = 0;
+};
+
+// Request kinds, each with its own latency histogram
+enum Kind { CONNECT, REGISTER, START, JOKER, ANSWER, KINDS };
+static const char* const kind_names[KINDS] = {"connect", "register", "start", "joker", "answer"};
+
+enum ErrorKind { CONNECT_FAILED, TIMEOUT, CLOSED, PROTOCOL, ERROR_KINDS };
+static const char* const error_names[ERROR_KINDS] = {"connect", "timeout", "closed", "protocol"};
+
+// Shared by all worker threads; histograms and atomics are lock-free
+struct Stats {
+    Histogram latency[KINDS];
+    Histogram all;
+    atomic<uint64_t> errors[ERROR_KINDS] = {};
+    atomic<uint64_t> games_won{0};
+    atomic<uint64_t> games_lost{0};
+    atomic<bool> measuring{false};
+    atomic<bool> running{true};
+};
+
+static uint64_t now_ns() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class LoadWorker {
+    // What a player is waiting for
+    enum Waiting { IDLE, CONNECTING, UPGRADING, WELCOME, QUESTIONS, AUDIENCE, FIFTY_FIFTY, ANSWERED };
+
+    struct Player {
+        int fd = -1;
+        string id;
+        uint32_t games = 0;
+        Waiting waiting = IDLE;
+        Kind kind = CONNECT;
+        uint64_t sent_at = 0;
+        uint64_t timer_seq = 0;
+        bool started = false;
+        int question = 0;
+        bool lifeline_used[2] = {false, false};
+        char correct[LADDER_SIZE] = {0};
+        FrameBuffer in{8192};
+    };
+
+    // A multiplexed connection and the commands it could not write yet
+    struct Carrier {
+        int fd = -1;
+        FrameBuffer in{65536};
+        string out;
+    };
+
+    struct Timer {
+        uint64_t when;
+        size_t player;
+        uint64_t seq;
+        bool operator>(const Timer& other) const { return when > other.when; }
+    };
+
+    const Options& options;
+    Stats& stats;
+    const unordered_map<string_view, char>& answers;
+    struct sockaddr_in address;
+    FastRandom random;
+    int epfd;
+    vector<Player> players;
+    vector<Carrier> carriers;
+    priority_queue<Timer, vector<Timer>, greater<Timer>> timers;
+
+    uint64_t think_time();
+    bool chance(double p) { return random.below(1000000) < p * 1000000; }
+    void schedule(size_t index, uint64_t when);
+    void begin_game(size_t index);
+    void end_game(size_t index, bool won);
+    void fail(size_t index, ErrorKind error);
+    void on_connected(size_t index);
+    void act(size_t index);
+    void send_request(size_t index, Kind kind, Waiting waiting, const string& line);
+    void complete(size_t index);
+    void read_player(size_t index);
+    void read_websocket(size_t index);
+    void on_line(size_t index, string_view line);
+    bool open_carrier(Carrier& carrier, const string& name);
+    void write_carrier(Carrier& carrier, string_view data);
+    void read_carrier(size_t index);
+    void on_message(string_view client_id, string_view body);
+
+public:
+    LoadWorker(const Options& options, Stats& stats, const unordered_map<string_view, char>& answers,
+               int thread_index, int player_count);
+    ~LoadWorker();
+    void run();
+};
+
+LoadWorker::LoadWorker(const Options& options, Stats& stats, const unordered_map<string_view, char>& answers,
+                       int thread_index, int player_count)
+    : options(options), stats(stats), answers(answers), random(options.seed + thread_index), players(player_count) {
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.ws_port > 0 ? options.ws_port : options.port);
+    inet_pton(AF_INET, options.host.c_str(), &address.sin_addr);
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("epoll_create1 failed");
+        exit(EXIT_FAILURE);
+    }
+
+    carriers.resize(options.mux);
+    for (int i = 0; i < options.mux; i++) {
+        if (!open_carrier(carriers[i], "loadgen-" + to_string(thread_index) + "-" + to_string(i))) {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Stagger the first connects so the listen queue is not flooded at once
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < players.size(); i++) {
+        players[i].id = "lg" + to_string(thread_index) + "-" + to_string(i);
+        schedule(i, start + uint64_t(options.ramp_ms) * 1000000 * i / players.size());
+    }
+}
+
+LoadWorker::~LoadWorker() {
+    for (Player& p : players) {
+        if (p.fd >= 0 && carriers.empty()) {
+            close(p.fd);
+        }
+    }
+    for (Carrier& c : carriers) {
+        if (c.fd >= 0) {
+            close(c.fd);
+        }
+    }
+    close(epfd);
+}
+
+// Connects and waits for the MUX handshake to be accepted
+bool LoadWorker::open_carrier(Carrier& carrier, const string& name) {
+    carrier.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (carrier.fd < 0 || connect(carrier.fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        perror("Multiplexed connection failed");
+        return false;
+    }
+    int opt = 1;
+    setsockopt(carrier.fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    struct timeval timeout = {2, 0};
+    setsockopt(carrier.fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    string hello = "MUX:" + name + "\n";
+    send(carrier.fd, hello.data(), hello.size(), MSG_NOSIGNAL);
+    string_view line;
+    while (!carrier.in.next_frame(line)) {
+        ssize_t n = recv(carrier.fd, carrier.in.write_ptr(), carrier.in.writable(), 0);
+        if (n <= 0) {
+            cerr << "game_host did not accept MUX" << endl;
+            return false;
+        }
+        carrier.in.commit(n);
+    }
+    if (line != "MUX_READY") {
+        cerr << "Unexpected MUX reply: " << line << endl;
+        return false;
+    }
+
+    fcntl(carrier.fd, F_SETFL, fcntl(carrier.fd, F_GETFL, 0) | O_NONBLOCK);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = CARRIER_TAG | static_cast<uint64_t>(&carrier - carriers.data());
+    epoll_ctl(epfd, EPOLL_CTL_ADD, carrier.fd, &ev);
+    return true;
+}
+
+// Commands from many players share the socket, so whatever does not fit
+// now is queued whole behind the rest instead of failing the player
+void LoadWorker::write_carrier(Carrier& carrier, string_view data) {
+    if (carrier.out.empty()) {
+        ssize_t sent = send(carrier.fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent == static_cast<ssize_t>(data.size())) {
+            return;
+        }
+        data.remove_prefix(sent > 0 ? sent : 0);
+    }
+    carrier.out.append(data);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.u64 = CARRIER_TAG | static_cast<uint64_t>(&carrier - carriers.data());
+    epoll_ctl(epfd, EPOLL_CTL_MOD, carrier.fd, &ev);
+}
+
+uint64_t LoadWorker::think_time() {
+    double mean = options.think_ms * 1e6;
+    double uniform = (random.next() >> 11) * (1.0 / 9007199254740992.0);
+    if (options.think_dist == "fixed") {
+        return static_cast<uint64_t>(mean);
+    }
+    if (options.think_dist == "uniform") {
+        return static_cast<uint64_t>(2 * mean * uniform);
+    }
+    return static_cast<uint64_t>(-mean * log(1.0 - uniform));
+}
+
+// Replaces the player's pending timer; older heap entries become stale
+void LoadWorker::schedule(size_t index, uint64_t when) {
+    timers.push(Timer{when, index, ++players[index].timer_seq});
+}
+
+void LoadWorker::begin_game(size_t index) {
+    Player& p = players[index];
+    p.games++;
+    p.started = false;
+    p.question = 0;
+    p.lifeline_used[0] = p.lifeline_used[1] = false;
+    p.in = FrameBuffer(8192);
+
+    if (!carriers.empty()) {
+        // No connect: registration goes straight onto the player's carrier
+        p.fd = carriers[index % carriers.size()].fd;
+        send_request(index, REGISTER, WELCOME, "CLIENT_ID:" + p.id + "-" + to_string(p.games));
+        return;
+    }
+
+    p.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (p.fd < 0) {
+        fail(index, CONNECT_FAILED);
+        return;
+    }
+    int opt = 1;
+    setsockopt(p.fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    p.kind = CONNECT;
+    p.sent_at = now_ns();
+    p.waiting = CONNECTING;
+    if (connect(p.fd, (struct sockaddr*)&address, sizeof(address)) < 0 && errno != EINPROGRESS) {
+        fail(index, CONNECT_FAILED);
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT | EPOLLIN;
+    ev.data.u64 = index;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, p.fd, &ev);
+    schedule(index, p.sent_at + uint64_t(options.timeout_ms) * 1000000);
+}
+
+void LoadWorker::end_game(size_t index, bool won) {
+    Player& p = players[index];
+    if (stats.measuring) {
+        (won ? stats.games_won : stats.games_lost)++;
+    }
+    if (carriers.empty()) {
+        close(p.fd);
+    }
+    p.fd = -1;
+    p.waiting = IDLE;
+    schedule(index, now_ns() + think_time());
+}
+
+void LoadWorker::fail(size_t index, ErrorKind error) {
+    Player& p = players[index];
+    if (stats.measuring) {
+        stats.errors[error]++;
+    }
+    if (p.fd >= 0 && !carriers.empty()) {
+        // The server may still hold the game; drop it like the adapter would
+        write_carrier(carriers[index % carriers.size()], "DISCONNECT:" + p.id + "-" + to_string(p.games) + "\n");
+        p.fd = -1;
+    } else if (p.fd >= 0) {
+        close(p.fd);
+        p.fd = -1;
+    }
+    p.waiting = IDLE;
+    schedule(index, now_ns() + think_time());
+}
+
+void LoadWorker::on_connected(size_t index) {
+    Player& p = players[index];
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(p.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+    if (error != 0) {
+        fail(index, CONNECT_FAILED);
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = index;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, p.fd, &ev);
+
+    if (options.ws_port > 0) {
+        // Still connecting until the upgrade is answered
+        static const char upgrade[] =
+            "GET / HTTP/1.1\r\nHost: game_host\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+        if (send(p.fd, upgrade, sizeof(upgrade) - 1, MSG_NOSIGNAL) != sizeof(upgrade) - 1) {
+            fail(index, CLOSED);
+            return;
+        }
+        p.waiting = UPGRADING;
+        return;
+    }
+    complete(index);
+
+    // Registration follows the connect immediately, as the adapter does
+    send_request(index, REGISTER, WELCOME, "CLIENT_ID:" + p.id + "-" + to_string(p.games));
+}
+
+void LoadWorker::send_request(size_t index, Kind kind, Waiting waiting, const string& line) {
+    Player& p = players[index];
+    string frame;
+    if (options.ws_port > 0) {
+        WebSocket::encode_masked(frame, WebSocket::Opcode::TEXT, line, static_cast<uint32_t>(random.next()));
+    } else {
+        frame = line + "\n";
+    }
+    p.kind = kind;
+    p.waiting = waiting;
+    p.sent_at = now_ns();
+
+    if (!carriers.empty()) {
+        write_carrier(carriers[index % carriers.size()], frame);
+        schedule(index, p.sent_at + uint64_t(options.timeout_ms) * 1000000);
+        return;
+    }
+
+    // Commands are tiny; a short write means the connection is unusable
+    if (send(p.fd, frame.data(), frame.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(frame.size())) {
+        fail(index, CLOSED);
+        return;
+    }
+    schedule(index, p.sent_at + uint64_t(options.timeout_ms) * 1000000);
+}
+
+void LoadWorker::complete(size_t index) {
+    Player& p = players[index];
+    if (stats.measuring) {
+        uint64_t elapsed = now_ns() - p.sent_at;
+        stats.latency[p.kind].record(elapsed);
+        stats.all.record(elapsed);
+    }
+    p.waiting = IDLE;
+    schedule(index, now_ns() + think_time());
+}
+
+// Issues the player's next command after its think time
+void LoadWorker::act(size_t index) {
+    Player& p = players[index];
+    string id = p.id + "-" + to_string(p.games);
+
+    if (p.fd < 0) {
+        begin_game(index);
+        return;
+    }
+    if (!p.started) {
+        send_request(index, START, QUESTIONS, "START:" + id);
+        return;
+    }
+
+    if (chance(options.lifeline_rate) && !(p.lifeline_used[0] && p.lifeline_used[1])) {
+        int lifeline = p.lifeline_used[0] ? 1 : p.lifeline_used[1] ? 0 : random.below(2);
+        p.lifeline_used[lifeline] = true;
+        if (lifeline == 0) {
+            send_request(index, JOKER, AUDIENCE, "JOKER:" + id + ":audience");
+        } else {
+            send_request(index, JOKER, FIFTY_FIFTY, "JOKER:" + id + ":50-50");
+        }
+        return;
+    }
+
+    char answer = 'A' + random.below(4);
+    char correct = p.correct[p.question];
+    if (correct != 0) {
+        if (chance(options.accuracy)) {
+            answer = correct;
+        } else if (answer == correct) {
+            answer = 'A' + (correct - 'A' + 1 + random.below(3)) % 4;
+        }
+    }
+    send_request(index, ANSWER, ANSWERED, "ANSWER:" + id + ":" + answer);
+}
+
+static bool starts_with(string_view s, string_view prefix) {
+    return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+void LoadWorker::on_line(size_t index, string_view line) {
+    Player& p = players[index];
+
+    switch (p.waiting) {
+    case WELCOME:
+        if (starts_with(line, "Welcome")) {
+            complete(index);
+            return;
+        }
+        break;
+
+    case QUESTIONS:
+        if (starts_with(line, "QUESTION:")) {
+            // "QUESTION:<tier>:<n>. text"
+            int tier = line.size() > 9 ? line[9] - '0' : -1;
+            size_t dot = line.find(". ");
+            if (tier >= 0 && tier < LADDER_SIZE && dot != string_view::npos) {
+                auto it = answers.find(line.substr(dot + 2));
+                p.correct[tier] = it != answers.end() ? it->second : 0;
+            }
+            return;
+        }
+        if (starts_with(line, "JOKERS:")) {
+            p.started = true;
+            complete(index);
+            return;
+        }
+        if (starts_with(line, "ALL_QUESTIONS_DATA") || starts_with(line, "OPTIONS:")) {
+            return;
+        }
+        break;
+
+    case AUDIENCE:
+        if (starts_with(line, "Ask the Audience")) {
+            return;
+        }
+        if (starts_with(line, "A: ")) {
+            complete(index);
+            return;
+        }
+        break;
+
+    case FIFTY_FIFTY:
+        if (starts_with(line, "50:50")) {
+            complete(index);
+            return;
+        }
+        break;
+
+    case ANSWERED:
+        if (starts_with(line, "Correct answer!")) {
+            // The last question's reply continues with "Congratulations!"
+            if (++p.question < LADDER_SIZE) {
+                complete(index);
+            }
+            return;
+        }
+        if (starts_with(line, "Congratulations!")) {
+            complete(index);
+            end_game(index, true);
+            return;
+        }
+        if (starts_with(line, "Wrong answer!")) {
+            complete(index);
+            end_game(index, false);
+            return;
+        }
+        break;
+
+    default:
+        break;
+    }
+    fail(index, PROTOCOL);
+}
+
+void LoadWorker::read_player(size_t index) {
+    Player& p = players[index];
+    while (p.fd >= 0) {
+        ssize_t n = recv(p.fd, p.in.write_ptr(), p.in.writable(), 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n <= 0) {
+            fail(index, CLOSED);
+            return;
+        }
+        p.in.commit(n);
+        if (options.ws_port > 0) {
+            read_websocket(index);
+            continue;
+        }
+
+        string_view line;
+        int fd = p.fd;
+        while (p.fd == fd && p.in.next_frame(line)) {
+            on_line(index, line);
+        }
+        if (p.fd == fd && p.in.overflowed()) {
+            fail(index, PROTOCOL);
+        }
+    }
+}
+
+// The upgrade reply, then text messages whose lines are handled as a TCP
+// player's would be
+void LoadWorker::read_websocket(size_t index) {
+    Player& p = players[index];
+    int fd = p.fd;
+
+    if (p.waiting == UPGRADING) {
+        string_view reply = p.in.peek();
+        size_t end = reply.find("\r\n\r\n");
+        if (end == string_view::npos) {
+            return;
+        }
+        static const string accept = "Sec-WebSocket-Accept: " + WebSocket::accept_key("dGhlIHNhbXBsZSBub25jZQ==");
+        if (!starts_with(reply, "HTTP/1.1 101") || reply.substr(0, end).find(accept) == string_view::npos) {
+            fail(index, PROTOCOL);
+            return;
+        }
+        p.in.consume(end + 4);
+        complete(index);
+        send_request(index, REGISTER, WELCOME, "CLIENT_ID:" + p.id + "-" + to_string(p.games));
+    }
+
+    WebSocket::Frame frame;
+    int consumed;
+    while (p.fd == fd && (consumed = WebSocket::decode(p.in.front(), p.in.pending(), frame)) > 0) {
+        string_view body = frame.payload;
+        p.in.consume(consumed);
+        if (frame.opcode == WebSocket::Opcode::CLOSE) {
+            fail(index, CLOSED);
+            return;
+        }
+        while (p.fd == fd && !body.empty()) {
+            size_t newline = body.find('\n');
+            on_line(index, body.substr(0, newline));
+            body.remove_prefix(newline == string_view::npos ? body.size() : newline + 1);
+        }
+    }
+    if (p.fd == fd && consumed < 0) {
+        fail(index, PROTOCOL);
+    }
+}
+
+// Splits a carrier's stream into MSG frames and control lines
+void LoadWorker::read_carrier(size_t index) {
+    Carrier& carrier = carriers[index];
+    while (!carrier.out.empty()) {
+        ssize_t sent = send(carrier.fd, carrier.out.data(), carrier.out.size(), MSG_NOSIGNAL);
+        if (sent <= 0) {
+            break;
+        }
+        carrier.out.erase(0, sent);
+        if (carrier.out.empty()) {
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.u64 = CARRIER_TAG | index;
+            epoll_ctl(epfd, EPOLL_CTL_MOD, carrier.fd, &ev);
+        }
+    }
+
+    while (true) {
+        ssize_t n = recv(carrier.fd, carrier.in.write_ptr(), carrier.in.writable(), 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n <= 0) {
+            cerr << "Multiplexed connection closed by game_host" << endl;
+            exit(EXIT_FAILURE);
+        }
+        carrier.in.commit(n);
+
+        while (true) {
+            string_view pending = carrier.in.peek();
+            size_t newline = pending.find('\n');
+            if (newline == string_view::npos) {
+                break;
+            }
+            string_view header = pending.substr(0, newline);
+            if (!starts_with(header, "MSG:")) {
+                // CLOSED and GOAWAY need no action here
+                carrier.in.consume(newline + 1);
+                continue;
+            }
+
+            size_t colon = header.rfind(':');
+            size_t length = 0;
+            from_chars(header.data() + colon + 1, header.data() + header.size(), length);
+            if (pending.size() < newline + 1 + length) {
+                break;
+            }
+            on_message(header.substr(4, colon - 4), pending.substr(newline + 1, length));
+            carrier.in.consume(newline + 1 + length);
+        }
+        if (carrier.in.overflowed()) {
+            cerr << "Oversized frame on multiplexed connection" << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// Hands a reply to the player it is for, unless it belongs to a game the
+// player already gave up on; client IDs are "lg<thread>-<player>-<game>"
+void LoadWorker::on_message(string_view client_id, string_view body) {
+    size_t first = client_id.find('-');
+    size_t second = client_id.find('-', first + 1);
+    size_t index = 0;
+    uint32_t game = 0;
+    if (first == string_view::npos || second == string_view::npos ||
+        from_chars(client_id.data() + first + 1, client_id.data() + second, index).ec != errc() ||
+        from_chars(client_id.data() + second + 1, client_id.data() + client_id.size(), game).ec != errc() ||
+        index >= players.size()) {
+        return;
+    }
+
+    Player& p = players[index];
+    string_view line;
+    while (p.fd >= 0 && p.games == game && !body.empty()) {
+        size_t newline = body.find('\n');
+        line = body.substr(0, newline);
+        body.remove_prefix(newline == string_view::npos ? body.size() : newline + 1);
+        on_line(index, line);
+    }
+}
+
+void LoadWorker::run() {
+    struct epoll_event events[MAX_EVENTS];
+
+    while (stats.running) {
+        uint64_t now = now_ns();
+        while (!timers.empty() && timers.top().when <= now) {
+            Timer timer = timers.top();
+            timers.pop();
+            Player& p = players[timer.player];
+            if (timer.seq != p.timer_seq) {
+                continue;
+            }
+            if (p.waiting == IDLE) {
+                act(timer.player);
+            } else {
+                fail(timer.player, TIMEOUT);
+            }
+        }
+
+        int timeout = 100;
+        if (!timers.empty()) {
+            uint64_t wait = timers.top().when > now ? (timers.top().when - now + 999999) / 1000000 : 0;
+            timeout = wait < 100 ? static_cast<int>(wait) : 100;
+        }
+
+        int ready = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+        for (int i = 0; i < ready; i++) {
+            if (events[i].data.u64 & CARRIER_TAG) {
+                read_carrier(events[i].data.u64 & ~CARRIER_TAG);
+                continue;
+            }
+            size_t index = events[i].data.u64;
+            Player& p = players[index];
+            if (p.fd < 0) {
+                continue;
+            }
+            if (p.waiting == CONNECTING) {
+                on_connected(index);
+            } else {
+                read_player(index);
+            }
+        }
+    }
+}
+
+// "key value" lines written by --save
+static map<string, double> read_results(const string& path) {
+    map<string, double> results;
+    ifstream file(path);
+    string key;
+    double value;
+    while (file >> key >> value) {
+        results[key] = value;
+    }
+    return results;
+}
+
+static bool parse_option(const char* arg, const char* name, string& value) {
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+        return false;
+    }
+    value = arg + length + 1;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    options.seed = chrono::steady_clock::now().time_since_epoch().count();
+
+    for (int i = 1; i < argc; i++) {
+        string value;
+        if (parse_option(argv[i], "--host", value)) options.host = value;
+        else if (parse_option(argv[i], "--port", value)) options.port = stoi(value);
+        else if (parse_option(argv[i], "--players", value)) options.players = stoi(value);
+        else if (parse_option(argv[i], "--threads", value)) options.threads = stoi(value);
+        else if (parse_option(argv[i], "--duration", value)) options.duration = stod(value);
+        else if (parse_option(argv[i], "--warmup", value)) options.warmup = stod(value);
+        else if (parse_option(argv[i], "--ramp", value)) options.ramp_ms = stoi(value);
+        else if (parse_option(argv[i], "--think", value)) options.think_ms = stod(value);
+        else if (parse_option(argv[i], "--think-dist", value)) options.think_dist = value;
+        else if (parse_option(argv[i], "--lifeline-rate", value)) options.lifeline_rate = stod(value);
+        else if (parse_option(argv[i], "--questions", value)) options.questions = value;
+        else if (parse_option(argv[i], "--accuracy", value)) options.accuracy = stod(value);
+        else if (parse_option(argv[i], "--timeout", value)) options.timeout_ms = stoi(value);
+        else if (parse_option(argv[i], "--seed", value)) options.seed = stoull(value);
+        else if (parse_option(argv[i], "--save", value)) options.save = value;
+        else if (parse_option(argv[i], "--baseline", value)) options.baseline = value;
+        else if (parse_option(argv[i], "--mux", value)) options.mux = stoi(value);
+        else if (parse_option(argv[i], "--ws", value)) options.ws_port = stoi(value);
+        else {
+            cerr << "Unknown option: " << argv[i] << " (see the header of tools/loadgen.cpp)" << endl;
+            return 1;
+        }
+    }
+    if (options.players < 1 || options.threads < 1 ||
+        (options.think_dist != "fixed" && options.think_dist != "uniform" && options.think_dist != "exp")) {
+        cerr << "Need --players >= 1, --threads >= 1 and --think-dist of fixed, uniform or exp" << endl;
+        return 1;
+    }
+    if (options.mux > 0 && options.ws_port > 0) {
+        cerr << "--mux and --ws cannot be combined" << endl;
+        return 1;
+    }
+    if (options.threads > options.players) {
+        options.threads = options.players;
+    }
+
+    // Correct answers by question text, so players can answer to --accuracy
+    shared_ptr<const QuestionBank> bank;
+    unordered_map<string_view, char> answers;
+    if (!options.questions.empty()) {
+        string error;
+        bank = QuestionBank::load(options.questions, error);
+        if (bank == nullptr) {
+            cerr << "Failed to load question bank: " << error << endl;
+            return 1;
+        }
+        for (uint32_t id = 0; id < bank->size(); id++) {
+            answers.emplace(bank->text(id), bank->correct_answer(id));
+        }
+    }
+
+    Stats stats;
+    vector<thread> threads;
+    for (int t = 0; t < options.threads; t++) {
+        int count = options.players / options.threads + (t < options.players % options.threads ? 1 : 0);
+        threads.emplace_back([&options, &stats, &answers, t, count] {
+            LoadWorker worker(options, stats, answers, t, count);
+            worker.run();
+        });
+    }
+
+    this_thread::sleep_for(chrono::duration<double>(options.warmup));
+    stats.measuring = true;
+    uint64_t start = now_ns();
+    this_thread::sleep_for(chrono::duration<double>(options.duration));
+    stats.measuring = false;
+    double elapsed = (now_ns() - start) / 1e9;
+    stats.running = false;
+    for (thread& t : threads) {
+        t.join();
+    }
+
+    // Report
+    map<string, double> results;
+    vector<uint64_t> buckets;
+    uint64_t requests = 0, sum_ns = 0;
+    stats.all.snapshot(buckets, requests, sum_ns);
+    uint64_t errors = 0;
+    for (auto& count : stats.errors) {
+        errors += count;
+    }
+    uint64_t games = stats.games_won + stats.games_lost;
+
+    results["requests_per_second"] = requests / elapsed;
+    results["games_per_second"] = games / elapsed;
+    results["error_rate"] = requests + errors > 0 ? double(errors) / (requests + errors) : 0;
+
+    printf("players %d, threads %d, think %s %.0fms, lifeline rate %.2f, measured %.1fs\n",
+           options.players, options.threads, options.think_dist.c_str(), options.think_ms,
+           options.lifeline_rate, elapsed);
+    printf("requests %llu (%.1f/s), games %llu (%.1f/s, %llu won)\n",
+           (unsigned long long)requests, requests / elapsed, (unsigned long long)games, games / elapsed,
+           (unsigned long long)stats.games_won.load());
+    printf("errors %llu (%.3f%%):", (unsigned long long)errors, 100 * results["error_rate"]);
+    for (int e = 0; e < ERROR_KINDS; e++) {
+        printf(" %s %llu", error_names[e], (unsigned long long)stats.errors[e].load());
+    }
+    printf("\n\n%-10s %10s %10s %10s %10s %10s\n", "latency", "count", "p50 ms", "p99 ms", "p999 ms", "max ms");
+
+    auto row = [&](const string& name, const Histogram& h) {
+        uint64_t count, sum;
+        h.snapshot(buckets, count, sum);
+        double p50 = h.percentile(0.5) / 1e6, p99 = h.percentile(0.99) / 1e6;
+        double p999 = h.percentile(0.999) / 1e6, max = h.percentile(1.0) / 1e6;
+        printf("%-10s %10llu %10.3f %10.3f %10.3f %10.3f\n", name.c_str(), (unsigned long long)count,
+               p50, p99, p999, max);
+        results[name + "_p50_ms"] = p50;
+        results[name + "_p99_ms"] = p99;
+        results[name + "_p999_ms"] = p999;
+    };
+    for (int k = 0; k < KINDS; k++) {
+        row(kind_names[k], stats.latency[k]);
+    }
+    row("all", stats.all);
+
+    if (!options.baseline.empty()) {
+        map<string, double> baseline = read_results(options.baseline);
+        printf("\n%-24s %12s %12s %9s\n", "vs baseline", "baseline", "now", "change");
+        for (auto& [key, value] : results) {
+            auto it = baseline.find(key);
+            if (it == baseline.end()) {
+                continue;
+            }
+            double change = it->second != 0 ? 100 * (value - it->second) / it->second : 0;
+            printf("%-24s %12.3f %12.3f %+8.1f%%\n", key.c_str(), it->second, value, change);
+        }
+    }
+
+    if (!options.save.empty()) {
+        ofstream file(options.save);
+        for (auto& [key, value] : results) {
+            file << key << " " << value << "\n";
+        }
+        if (!file) {
+            cerr << "Failed to write " << options.save << endl;
+            return 1;
+        }
+    }
+    return errors > 0 && requests == 0 ? 1 : 0;
+}
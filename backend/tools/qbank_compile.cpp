@@ -0,0 +1,320 @@
+// Offline compiler for the binary question bank loaded by game_host and
+// joker_service.
+//
+// Usage: qbank_compile INPUT OUTPUT.qbk
+//
+// INPUT is picked by extension:
+//   .csv   header row, then tier,category,question,a,b,c,d,correct
+//          (RFC 4180 quoting: "..." fields, "" for a literal quote)
+//   .json  [{"tier": 0, "category": "...", "question": "...",
+//            "options": ["...", "...", "...", "..."], "answer": "A"}, ...]
+//   other  the pipe separated text format of backend/data/questions.txt
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "question_bank.h"
+
+using namespace std;
+
+static bool ends_with(const string& s, const string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Splits CSV text into rows of fields
+static bool parse_csv_rows(const string& text, vector<vector<string>>& rows, string& error) {
+    vector<string> row;
+    string field;
+    bool quoted = false;
+    int line = 1;
+
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < text.size() && text[i + 1] == '"') {
+                field += '"';
+                i++;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                if (c == '\n') line++;
+                field += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            row.push_back(move(field));
+            field.clear();
+        } else if (c == '\n' || c == '\r') {
+            if (c == '\r' && i + 1 < text.size() && text[i + 1] == '\n') i++;
+            row.push_back(move(field));
+            field.clear();
+            if (!(row.size() == 1 && row[0].empty())) rows.push_back(move(row));
+            row.clear();
+            line++;
+        } else {
+            field += c;
+        }
+    }
+    if (quoted) {
+        error = "unterminated quote at line " + to_string(line);
+        return false;
+    }
+    if (!field.empty() || !row.empty()) {
+        row.push_back(move(field));
+        rows.push_back(move(row));
+    }
+    return true;
+}
+
+static bool parse_csv(const string& text, vector<QuestionBank::Source>& out, string& error) {
+    vector<vector<string>> rows;
+    if (!parse_csv_rows(text, rows, error)) {
+        return false;
+    }
+
+    // The first row is the header
+    for (size_t r = 1; r < rows.size(); r++) {
+        const vector<string>& f = rows[r];
+        if (f.size() != 8 || f[0].size() != 1 || f[7].size() != 1) {
+            error = "row " + to_string(r + 1) + ": expected tier,category,question,a,b,c,d,correct";
+            return false;
+        }
+        QuestionBank::Source q;
+        q.tier = f[0][0] - '0';
+        q.category = f[1];
+        q.text = f[2];
+        for (int i = 0; i < QuestionBank::OPTIONS; i++) {
+            q.options[i] = f[3 + i];
+        }
+        q.correct = f[7][0];
+        out.push_back(move(q));
+    }
+    return true;
+}
+
+// Minimal JSON reader covering the question file shape: arrays, objects,
+// strings, integers, true/false/null.
+class JsonReader {
+private:
+    const string& s;
+    size_t pos = 0;
+
+public:
+    string error;
+
+    explicit JsonReader(const string& text) : s(text) {}
+
+    void skip_space() {
+        while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\n' || s[pos] == '\r')) pos++;
+    }
+
+    bool consume(char c) {
+        skip_space();
+        if (pos < s.size() && s[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    bool expect(char c) {
+        if (consume(c)) return true;
+        error = string("expected '") + c + "' at offset " + to_string(pos);
+        return false;
+    }
+
+    bool read_string(string& out) {
+        if (!expect('"')) return false;
+        out.clear();
+        while (pos < s.size() && s[pos] != '"') {
+            char c = s[pos++];
+            if (c == '\\' && pos < s.size()) {
+                char e = s[pos++];
+                switch (e) {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'r': out += '\r'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'u': {
+                        if (pos + 4 > s.size()) { error = "bad \\u escape"; return false; }
+                        unsigned code = stoul(s.substr(pos, 4), nullptr, 16);
+                        pos += 4;
+                        // Encode the BMP code point as UTF-8
+                        if (code < 0x80) {
+                            out += char(code);
+                        } else if (code < 0x800) {
+                            out += char(0xC0 | (code >> 6));
+                            out += char(0x80 | (code & 0x3F));
+                        } else {
+                            out += char(0xE0 | (code >> 12));
+                            out += char(0x80 | ((code >> 6) & 0x3F));
+                            out += char(0x80 | (code & 0x3F));
+                        }
+                        break;
+                    }
+                    default: out += e;
+                }
+            } else {
+                out += c;
+            }
+        }
+        return expect('"');
+    }
+
+    bool read_int(int& out) {
+        skip_space();
+        size_t start = pos;
+        if (pos < s.size() && s[pos] == '-') pos++;
+        while (pos < s.size() && isdigit(static_cast<unsigned char>(s[pos]))) pos++;
+        if (start == pos) {
+            error = "expected a number at offset " + to_string(pos);
+            return false;
+        }
+        out = stoi(s.substr(start, pos - start));
+        return true;
+    }
+
+    // Skips any value; used for unknown keys
+    bool skip_value() {
+        skip_space();
+        if (pos >= s.size()) { error = "unexpected end of input"; return false; }
+        char c = s[pos];
+        string ignored;
+        if (c == '"') return read_string(ignored);
+        if (c == '[' || c == '{') {
+            char close = c == '[' ? ']' : '}';
+            pos++;
+            if (consume(close)) return true;
+            do {
+                if (close == '}' && (!read_string(ignored) || !expect(':'))) return false;
+                if (!skip_value()) return false;
+            } while (consume(','));
+            return expect(close);
+        }
+        while (pos < s.size() && s[pos] != ',' && s[pos] != '}' && s[pos] != ']') pos++;
+        return true;
+    }
+
+    bool at_end() {
+        skip_space();
+        return pos == s.size();
+    }
+};
+
+static bool parse_json(const string& text, vector<QuestionBank::Source>& out, string& error) {
+    JsonReader json(text);
+    if (!json.expect('[')) {
+        error = json.error;
+        return false;
+    }
+
+    if (!json.consume(']')) {
+        do {
+            QuestionBank::Source q;
+            int options = 0;
+            q.category = "general";
+            if (!json.expect('{')) break;
+            if (!json.consume('}')) {
+                do {
+                    string key, value;
+                    if (!json.read_string(key) || !json.expect(':')) break;
+                    if (key == "tier") {
+                        if (!json.read_int(q.tier)) break;
+                    } else if (key == "category") {
+                        if (!json.read_string(q.category)) break;
+                    } else if (key == "question") {
+                        if (!json.read_string(q.text)) break;
+                    } else if (key == "answer") {
+                        if (!json.read_string(value)) break;
+                        q.correct = value.size() == 1 ? value[0] : '?';
+                    } else if (key == "options") {
+                        if (!json.expect('[')) break;
+                        do {
+                            if (!json.read_string(value)) break;
+                            if (options < QuestionBank::OPTIONS) q.options[options] = value;
+                            options++;
+                        } while (json.consume(','));
+                        if (!json.error.empty() || !json.expect(']')) break;
+                    } else if (!json.skip_value()) {
+                        break;
+                    }
+                } while (json.consume(','));
+                if (!json.error.empty() || !json.expect('}')) break;
+            }
+            if (options != QuestionBank::OPTIONS) {
+                error = "question " + to_string(out.size() + 1) + " must have exactly 4 options";
+                return false;
+            }
+            out.push_back(move(q));
+        } while (json.consume(','));
+
+        if (json.error.empty()) json.expect(']');
+    }
+
+    if (json.error.empty() && !json.at_end()) {
+        json.error = "trailing data after the question array";
+    }
+    if (!json.error.empty()) {
+        error = json.error;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " INPUT(.txt|.csv|.json) OUTPUT.qbk" << endl;
+        return 1;
+    }
+    string input = argv[1];
+    string output = argv[2];
+
+    ifstream file(input, ios::binary);
+    if (!file) {
+        cerr << "Cannot open " << input << endl;
+        return 1;
+    }
+    stringstream contents;
+    contents << file.rdbuf();
+    string text = contents.str();
+
+    vector<QuestionBank::Source> questions;
+    string error;
+    bool ok;
+    if (ends_with(input, ".csv")) {
+        ok = parse_csv(text, questions, error);
+    } else if (ends_with(input, ".json")) {
+        ok = parse_json(text, questions, error);
+    } else {
+        ok = QuestionBank::parse_text(text, input, questions, error);
+    }
+
+    string image;
+    if (!ok || !QuestionBank::compile(questions, image, error)) {
+        cerr << input << ": " << error << endl;
+        return 1;
+    }
+
+    // Write next to the target and rename, so a running service never maps
+    // a half-written file
+    string temp = output + ".tmp";
+    {
+        ofstream out(temp, ios::binary | ios::trunc);
+        out.write(image.data(), image.size());
+        if (!out) {
+            cerr << "Cannot write " << temp << endl;
+            return 1;
+        }
+    }
+    if (rename(temp.c_str(), output.c_str()) != 0) {
+        perror("rename");
+        return 1;
+    }
+
+    cout << "Compiled " << questions.size() << " questions (" << image.size() << " bytes) into " << output << endl;
+    return 0;
+}
@@ -16,13 +16,77 @@ const GAME_SERVER_HOST = '127.0.0.1';
 const GAME_SERVER_PORT = 4337;
 
 // Client connections mapping
-const clients = new Map(); // Maps socketId to TCP connection
+const clients = new Map(); // Maps socketId to its game server connection (TCP socket or MuxPlayer)
 
-// Handle Socket.IO connections from web clients
-io.on('connection', (socket) => {
-  console.log('WebSocket client connected:', socket.id);
-  
-  // Create individual TCP connection for each client
+// Players are carried over this many shared connections ("MUX" mode); 0
+// opens one TCP connection per player instead. A game server that does not
+// answer the MUX handshake is talked to one connection per player.
+const MUX_CONNECTIONS = parseInt(process.env.GAME_SERVER_MUX_CONNECTIONS || '4', 10);
+const MUX_HANDSHAKE_TIMEOUT_MS = 2000;
+
+// Forward a reply from the game server to the frontend
+function forwardToClient(socket, data) {
+  try {
+    const message = data.toString().trim();
+    console.log(`[${socket.id}] Received from game server: ${message}`);
+    
+    // Parse different message types
+    if (message.includes('ALL_QUESTIONS_DATA')) {
+      // Send the entire questions data to frontend
+      socket.emit('gameData', message);
+    }
+    else if (message.includes('QUESTION:')) {
+      // Send question
+      socket.emit('gameData', message);
+    }
+    else if (message.includes('JOKERS:')) {
+      // Send jokers info
+      socket.emit('gameData', message);
+    }
+    else if (message.includes('Welcome to the game server')) {
+      // Send welcome message as normal message
+      socket.emit('message', message);
+    }
+    else if (message.includes('Ask the Audience Results')) {
+      // Special handling for audience joker results
+      socket.emit('joker_result', message);
+    }
+    else if (message.includes('50:50 Result')) {
+      // Special handling for 50:50 joker results
+      socket.emit('joker_result', message);
+    }
+    else if (message.includes('Skip joker used')) {
+      // Special handling for skip joker results
+      socket.emit('joker_result', message);
+    }
+    else if (message.includes('Correct answer')) {
+      // Send correct answer notification
+      socket.emit('correct', message);
+    }
+    else if (message.includes('Wrong answer')) {
+      // Send wrong answer notification
+      socket.emit('wrong', message);
+    }
+    else if (message.includes('Congratulations')) {
+      // Send win notification
+      socket.emit('win', message);
+    }
+    else if (message.includes('ERROR:')) {
+      // Send error messages as alerts
+      socket.emit('alert', message);
+    }
+    else {
+      // Default: general message
+      socket.emit('message', message);
+    }
+  } catch (error) {
+    console.error(`[${socket.id}] Error processing data from server:`, error);
+    socket.emit('alert', 'Error processing data from game server');
+  }
+}
+
+// One TCP connection to the game server for this client
+function attachDirect(socket, queued = []) {
   const tcpClient = new net.Socket();
   
   // Connect to game server
@@ -31,71 +95,14 @@ io.on('connection', (socket) => {
     
     // Send socket ID to game server on connection
     tcpClient.write(`CLIENT_ID:${socket.id}\n`);
+    queued.forEach((line) => tcpClient.write(line));
   });
   
   // Store the TCP client for this socket
   clients.set(socket.id, tcpClient);
   
   // Forward all data from game server to frontend
-  tcpClient.on('data', (data) => {
-    try {
-      const message = data.toString().trim();
-      console.log(`[${socket.id}] Received from game server: ${message}`);
-      
-      // Parse different message types
-      if (message.includes('ALL_QUESTIONS_DATA')) {
-        // Send the entire questions data to frontend
-        socket.emit('gameData', message);
-      }
-      else if (message.includes('QUESTION:')) {
-        // Send question
-        socket.emit('gameData', message);
-      }
-      else if (message.includes('JOKERS:')) {
-        // Send jokers info
-        socket.emit('gameData', message);
-      }
-      else if (message.includes('Welcome to the game server')) {
-        // Send welcome message as normal message
-        socket.emit('message', message);
-      }
-      else if (message.includes('Ask the Audience Results')) {
-        // Special handling for audience joker results
-        socket.emit('joker_result', message);
-      }
-      else if (message.includes('50:50 Result')) {
-        // Special handling for 50:50 joker results
-        socket.emit('joker_result', message);
-      }
-      else if (message.includes('Skip joker used')) {
-        // Special handling for skip joker results
-        socket.emit('joker_result', message);
-      }
-      else if (message.includes('Correct answer')) {
-        // Send correct answer notification
-        socket.emit('correct', message);
-      }
-      else if (message.includes('Wrong answer')) {
-        // Send wrong answer notification
-        socket.emit('wrong', message);
-      }
-      else if (message.includes('Congratulations')) {
-        // Send win notification
-        socket.emit('win', message);
-      }
-      else if (message.includes('ERROR:')) {
-        // Send error messages as alerts
-        socket.emit('alert', message);
-      }
-      else {
-        // Default: general message
-        socket.emit('message', message);
-      }
-    } catch (error) {
-      console.error(`[${socket.id}] Error processing data from server:`, error);
-      socket.emit('alert', 'Error processing data from game server');
-    }
-  });
+  tcpClient.on('data', (data) => forwardToClient(socket, data));
   
   // Handle connection errors
   tcpClient.on('error', (err) => {
@@ -108,6 +115,173 @@ io.on('connection', (socket) => {
     console.log(`[${socket.id}] TCP connection closed`);
     socket.emit('alert', 'Game server connection closed. Please reload the page to reconnect.');
   });
+}
+
+// A shared connection carrying many players. Every line sent already names
+// its client ID; replies come back as "MSG:<clientId>:<length>\n" followed
+// by that many bytes. "CLOSED:<clientId>" ends one player's game (as a
+// closed connection does in direct mode) and "GOAWAY" means the server is
+// shutting down: players already here finish, new ones go elsewhere.
+class MuxConnection {
+  constructor(name) {
+    this.name = name;
+    this.players = new Map(); // client ID -> Socket.IO socket
+    this.queued = [];         // [clientId, line] written before MUX_READY
+    this.ready = false;
+    this.closed = false;
+    this.buffer = Buffer.alloc(0);
+
+    this.tcp = new net.Socket();
+    this.tcp.connect(GAME_SERVER_PORT, GAME_SERVER_HOST, () => {
+      this.tcp.write(`MUX:${name}\n`);
+    });
+    this.handshakeTimer = setTimeout(() => this.fallBack(), MUX_HANDSHAKE_TIMEOUT_MS);
+
+    this.tcp.on('data', (data) => this.receive(data));
+    this.tcp.on('error', (err) => {
+      console.error(`[${this.name}] Multiplexed connection error:`, err);
+    });
+    this.tcp.on('close', () => this.onClose());
+  }
+
+  add(socket) {
+    this.players.set(socket.id, socket);
+    this.write(socket.id, `CLIENT_ID:${socket.id}\n`);
+  }
+
+  write(clientId, line) {
+    if (this.ready) {
+      this.tcp.write(line);
+    } else {
+      this.queued.push([clientId, line]);
+    }
+  }
+
+  receive(data) {
+    this.buffer = this.buffer.length > 0 ? Buffer.concat([this.buffer, data]) : data;
+    while (true) {
+      const newline = this.buffer.indexOf(10);
+      if (newline < 0) {
+        return;
+      }
+      const header = this.buffer.toString('utf8', 0, newline);
+
+      if (header.startsWith('MSG:')) {
+        const colon = header.lastIndexOf(':');
+        const clientId = header.slice(4, colon);
+        const end = newline + 1 + parseInt(header.slice(colon + 1), 10);
+        if (this.buffer.length < end) {
+          return;
+        }
+        const socket = this.players.get(clientId);
+        if (socket) {
+          forwardToClient(socket, this.buffer.subarray(newline + 1, end));
+        }
+        this.buffer = this.buffer.subarray(end);
+        continue;
+      }
+
+      this.buffer = this.buffer.subarray(newline + 1);
+      if (header === 'MUX_READY') {
+        clearTimeout(this.handshakeTimer);
+        this.ready = true;
+        console.log(`[${this.name}] Multiplexed connection to game server ready`);
+        this.queued.forEach(([, line]) => this.tcp.write(line));
+        this.queued = [];
+      } else if (header === 'GOAWAY') {
+        console.log(`[${this.name}] Game server is draining, new players go to a new connection`);
+        retireMuxConnection(this);
+      } else if (header.startsWith('CLOSED:')) {
+        const clientId = header.slice(7);
+        const socket = this.players.get(clientId);
+        this.players.delete(clientId);
+        if (socket) {
+          socket.emit('alert', 'Game server connection closed. Please reload the page to reconnect.');
+        }
+      }
+    }
+  }
+
+  // The game server did not take the MUX handshake: it predates
+  // multiplexing, so this and every later player get a connection of their own
+  fallBack() {
+    if (this.ready || this.closed) {
+      return;
+    }
+    console.log(`[${this.name}] Game server does not multiplex, using one connection per player`);
+    muxEnabled = false;
+    retireMuxConnection(this);
+    for (const [clientId, socket] of this.players) {
+      const lines = this.queued.filter(([id, line]) => id === clientId && !line.startsWith('CLIENT_ID:'));
+      attachDirect(socket, lines.map(([, line]) => line));
+    }
+    this.players.clear();
+    this.tcp.destroy();
+  }
+
+  onClose() {
+    clearTimeout(this.handshakeTimer);
+    this.closed = true;
+    retireMuxConnection(this);
+    console.log(`[${this.name}] Multiplexed connection closed with ${this.players.size} player(s)`);
+    for (const socket of this.players.values()) {
+      socket.emit('alert', 'Game server connection closed. Please reload the page to reconnect.');
+    }
+    this.players.clear();
+  }
+}
+
+// A client's handle on a multiplexed connection, used like its TCP socket
+class MuxPlayer {
+  constructor(connection, clientId) {
+    this.connection = connection;
+    this.clientId = clientId;
+  }
+
+  get destroyed() {
+    return this.connection.closed || !this.connection.players.has(this.clientId);
+  }
+
+  write(line) {
+    this.connection.write(this.clientId, line);
+  }
+
+  end() {
+    this.connection.players.delete(this.clientId);
+  }
+}
+
+let muxEnabled = MUX_CONNECTIONS > 0;
+let muxSequence = 0;
+const muxConnections = []; // connections taking new players
+
+function retireMuxConnection(connection) {
+  const index = muxConnections.indexOf(connection);
+  if (index >= 0) {
+    muxConnections.splice(index, 1);
+  }
+}
+
+// The least loaded shared connection, opening more up to MUX_CONNECTIONS
+function muxConnectionForNewPlayer() {
+  while (muxConnections.length < MUX_CONNECTIONS) {
+    muxConnections.push(new MuxConnection(`adapter-${process.pid}-${muxSequence++}`));
+  }
+  return muxConnections.reduce((best, connection) =>
+    connection.players.size < best.players.size ? connection : best);
+}
+
+// Handle Socket.IO connections from web clients
+io.on('connection', (socket) => {
+  console.log('WebSocket client connected:', socket.id);
+  
+  if (muxEnabled) {
+    const connection = muxConnectionForNewPlayer();
+    connection.add(socket);
+    clients.set(socket.id, new MuxPlayer(connection, socket.id));
+  } else {
+    attachDirect(socket);
+  }
   
   // Forward startGame command from frontend to backend
   socket.on('startGame', () => {
@@ -218,6 +392,9 @@ process.on('SIGINT', () => {
   console.log('Shutting down WebSocket adapter...');
   
   // Close all TCP connections
+  for (const connection of muxConnections) {
+    connection.tcp.end();
+  }
   for (const [socketId, connection] of clients.entries()) {
     try {
       connection.end();
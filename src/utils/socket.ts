@@ -2,7 +2,120 @@ import { io, Socket } from 'socket.io-client';
 
 let socket: Socket | null = null;
 
+// Set to game_host's WebSocket listener (e.g. ws://localhost:4339, see its
+// --ws-port option) to play without the Socket.IO adapter in between
+const GAME_HOST_WS_URL = process.env.NEXT_PUBLIC_GAME_HOST_WS_URL;
+
+type Handler = (...args: any[]) => void;
+
+// Event the adapter emits for a game server reply (forwardToClient in
+// src/adapter/adapter.js)
+const eventForMessage = (message: string): string => {
+  if (message.includes('ALL_QUESTIONS_DATA') || message.includes('QUESTION:') || message.includes('JOKERS:')) {
+    return 'gameData';
+  }
+  if (message.includes('Ask the Audience Results') || message.includes('50:50 Result') ||
+      message.includes('Skip joker used')) {
+    return 'joker_result';
+  }
+  if (message.includes('Correct answer')) {
+    return 'correct';
+  }
+  if (message.includes('Wrong answer')) {
+    return 'wrong';
+  }
+  if (message.includes('Congratulations')) {
+    return 'win';
+  }
+  if (message.includes('ERROR:')) {
+    return 'alert';
+  }
+  return 'message';
+};
+
+// The part of the Socket.IO client the game uses, over a plain WebSocket to
+// game_host. Events are turned into the command lines the adapter would
+// send, and replies into the events it would emit.
+class GameHostSocket {
+  id = `web-${Math.random().toString(36).slice(2)}${Date.now().toString(36)}`;
+  connected = false;
+
+  private ws: WebSocket | null = null;
+  private handlers = new Map<string, Handler[]>();
+
+  constructor(private url: string) {
+    this.connect();
+  }
+
+  on(event: string, handler: Handler) {
+    this.handlers.set(event, [...(this.handlers.get(event) || []), handler]);
+    return this;
+  }
+
+  private dispatch(event: string, ...args: any[]) {
+    (this.handlers.get(event) || []).forEach((handler) => handler(...args));
+  }
+
+  private send(line: string) {
+    if (this.ws && this.ws.readyState === WebSocket.OPEN) {
+      this.ws.send(line);
+    }
+  }
+
+  emit(event: string, ...args: any[]) {
+    switch (event) {
+      case 'startGame': this.send(`START:${this.id}`); break;
+      case 'answer': this.send(`ANSWER:${this.id}:${args[0]}`); break;
+      case 'joker': this.send(`JOKER:${this.id}:${args[0]}`); break;
+      case 'requestQuestion': this.send(`REQUEST:${this.id}`); break;
+      case 'goToQuestion': this.send(`GOTO:${this.id}:${args[0]}`); break;
+    }
+    return this;
+  }
+
+  connect() {
+    if (this.ws) {
+      return this;
+    }
+    const ws = new WebSocket(this.url);
+    this.ws = ws;
+    ws.onopen = () => {
+      ws.send(`CLIENT_ID:${this.id}`);
+      this.connected = true;
+      this.dispatch('connect');
+    };
+    ws.onmessage = (event) => {
+      const message = String(event.data).trim();
+      this.dispatch(eventForMessage(message), message);
+    };
+    ws.onerror = () => this.dispatch('error');
+    ws.onclose = () => {
+      // game_host closes the connection when a game ends, as it closes the
+      // adapter's TCP connection
+      const wasConnected = this.connected;
+      this.ws = null;
+      this.connected = false;
+      if (wasConnected) {
+        this.dispatch('alert', 'Game server connection closed. Please reload the page to reconnect.');
+        this.dispatch('disconnect');
+      }
+    };
+    return this;
+  }
+
+  disconnect() {
+    if (this.ws) {
+      this.send(`DISCONNECT:${this.id}`);
+      this.ws.close(1000);
+    }
+    return this;
+  }
+}
+
 export const initializeSocket = (): Socket => {
+  if (!socket && GAME_HOST_WS_URL) {
+    socket = new GameHostSocket(GAME_HOST_WS_URL) as unknown as Socket;
+  }
   if (!socket) {
     // Connect directly to the adapter on port 3001
     socket = io('http://localhost:3001', {